@@ -26,6 +26,8 @@ typedef struct _GCRootSet GCRootSet;
 
 typedef struct _Callframe Callframe;
 
+typedef struct _SpecializationCache SpecializationCache;
+
 typedef enum {
   INSTR_INVALID = -1,
   INSTR_ALLOC_OBJECT,
@@ -63,6 +65,10 @@ typedef enum {
   // object is allocated, some fields are defined, object is closed, and refslots are created for its fields
   // this is a very common pattern due to scopes
   INSTR_ALLOC_STATIC_OBJECT,
+  // obj[key] where the key is known to be an int, specialized for arrays
+  INSTR_ACCESS_ARRAY_INDEX,
+  // a common sequence of instrs run by one combined handler, see fuse_instructions
+  INSTR_FUSED,
 
   INSTR_LAST
 } InstrType;
@@ -174,7 +180,9 @@ typedef struct {
   union {
     Slot slot;
     Refslot refslot;
-    Value value;
+    // in instrs, points into the constant pool (see vm/constants.h)
+    // for calls set up at runtime, it can also point at a local
+    Value *value;
   };
 } Arg;
 
@@ -272,6 +280,10 @@ typedef struct {
   HashTable excl_table;
   // table position -> table position -> count
   HashTable incl_table;
+
+  // opcode sequence stats: counts of every pair and triple of instr types executed
+  InstrType last_instrs[2];
+  long long *pair_counts, *triple_counts;
 } VMProfileState;
 
 typedef struct {
@@ -302,10 +314,14 @@ typedef struct {
 
   int disabledness;
   bool missed_gc; // tried to run gc when it was disabled
+
+  SpecializationCache *specializations; // every function's, so the gc can clear out dead contexts
 } GCState;
 
 typedef struct {
-  bool profiling_enabled, jit_enabled;
+  bool profiling_enabled, jit_enabled, opcode_stats_enabled;
+  bool specialization_disabled; // closures keep their parsed function, so a heap snapshot can store it
+  bool prefetch_enabled; // parse required modules on worker threads ahead of time, see vm/prefetch.h
 } Settings;
 
 // shared between parent and child VMs
@@ -363,17 +379,30 @@ typedef struct {
   int offset, size;
 } InstrBlock;
 
+// instrs from offset (in bytes from the first instr) up to the next run's offset belong to range
+typedef struct {
+  int offset;
+  FileRange *range;
+} RangeRun;
+
 typedef struct {
   InstrBlock* blocks_ptr; int blocks_len;
-  FileRange **ranges_ptr; // indexed by "(char*)current instr - (char*) first instr", on the premise that Instr is at least void*
+  RangeRun *ranges_ptr; int ranges_len; // sorted by offset; consecutive instrs mostly share a range
   FileRange *function_range; // of the function itself
-  uint32_t ranges_base, function_range_id; // lets us give every range a unique 32-bit id
+  uint32_t ranges_base, function_range_id; // lets us give every run a unique 32-bit id
   // first instruction of first block to last instruction of last block
   // (linear because cache)
   Instr *instrs_ptr, *instrs_ptr_end;
 } FunctionBody;
 
-FileRange **instr_belongs_to_p(FunctionBody *body, Instr *instr);
+// the run of instrs with the same range that instr is in
+RangeRun *instr_range_run(FunctionBody *body, Instr *instr);
+
+static inline FileRange *instr_belongs_to(FunctionBody *body, Instr *instr) {
+  return instr_range_run(body, instr)->range;
+}
+
+typedef struct _FunctionAnalysis FunctionAnalysis;
 
 typedef struct {
   int arity; // first n slots are reserved for parameters
@@ -385,9 +414,25 @@ typedef struct {
   // this is used for breaking circular deps with recursion
   VMInstrFn opt_jit_fn, proposed_jit_fn;
   bool non_ssa, optimized, resolved;
+  bool phi_free; // phis were lowered to moves, so branches don't need to keep frame->block current
   int num_optimized;
+  FunctionAnalysis *analysis; // optimizer cache, see vm/analysis.h
+  SpecializationCache *specializations; // runtime-optimized versions, see find_specialization
+  char *lazy_text; // body not built yet, see parse_lazy_function
 } UserFunction;
 
+#define SPECIALIZATIONS_MAX 4
+
+struct _SpecializationCache {
+  int len;
+  // not gc roots: the gc sets an entry to NULL when its context is freed, so the cache doesn't keep
+  // contexts alive, and no other object can show up under the same address
+  Object *context_ptr[SPECIALIZATIONS_MAX];
+  UserFunction *fn_ptr[SPECIALIZATIONS_MAX];
+  UserFunction *generic; // shared by every context past the first few
+  SpecializationCache *next, **prev_p; // in gcstate.specializations
+};
+
 void free_function(UserFunction *uf);
 
 // refslots used to be "just past" the callframe, but that was stupid; now it's slots, then refslots
@@ -401,7 +446,7 @@ struct _Callframe {
   Instr *return_next_instr;
   // when returning *from* this frame, assign result value to this (in the *above* frame)
   WriteArg target;
-  int block, prev_block; // required for phi nodes
+  int block, prev_block; // required for phi nodes; not kept current in phi_free functions
   Object *last_stack_obj; // chain of stack allocated objects for freeing later
   Callframe *above;
 };
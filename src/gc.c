@@ -31,6 +31,16 @@ static void gc_mark(VMState *state) {
   }
 }
 
+// the specialization caches don't keep their contexts alive: forget the ones about to be freed
+static void gc_clear_specializations(VMState *state) {
+  for (SpecializationCache *cache = state->shared->gcstate.specializations; cache; cache = cache->next) {
+    for (int i = 0; i < cache->len; i++) {
+      Object *context = cache->context_ptr[i];
+      if (context && !(context->flags & (OBJ_GC_MARK|OBJ_IMMORTAL))) cache->context_ptr[i] = NULL;
+    }
+  }
+}
+
 // scan all allocated objects, freeing those without OBJ_GC_MARK flag
 static void gc_sweep(VMState *state) {
   Object **curp = &state->shared->gcstate.last_obj_allocated;
@@ -69,6 +79,7 @@ void gc_run(VMState *state) {
   // fprintf(stderr, "run gc\n");
   // int bytes_before = state->shared->gcstate.bytes_allocated;
   gc_mark(state);
+  gc_clear_specializations(state);
   gc_sweep(state);
   // int bytes_after = state->shared->gcstate.bytes_allocated;
   // fprintf(stderr, "done gc, %i -> %i (%f%% kept)\n", bytes_before, bytes_after, (bytes_after * 100.0) / bytes_before);
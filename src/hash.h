@@ -10,6 +10,9 @@
 
 FastKey prepare_key(const char *key_ptr, size_t key_len);
 
+// makes prepare_key safe to call from several threads at once, for as long as they may (see vm/prefetch.h)
+void intern_set_threaded(bool threaded);
+
 // pretend "ptr" is an already-interned char pointer
 // used for the profiler hack
 FastKey fixed_pointer_key(void *ptr);
@@ -11,6 +11,10 @@
 #include "vm/optimize.h"
 #include "vm/runtime.h"
 #include "vm/dump.h"
+#include "vm/aot.h"
+#include "vm/bytecode_cache.h"
+#include "vm/snapshot.h"
+#include "vm/prefetch.h"
 #include "vm/vm.h"
 #include "language.h"
 #include "util.h"
@@ -33,13 +37,26 @@ int main(int argc, char **argv) {
   
   int argc2 = 0;
   char **argv2 = NULL;
+  char *emit_c_file = NULL;
+  char *snapshot_file = NULL, *snapshot_out_file = NULL;
   for (int i = 0; i < argc; ++i) {
     if (i > 0 && strcmp(argv[i], "-v") == 0) {
       vmstate.shared->verbose = true;
     } else if (i > 0 && strcmp(argv[i], "-pg") == 0) {
       vmstate.shared->settings.profiling_enabled = true;
+    } else if (i > 0 && strcmp(argv[i], "-ps") == 0) {
+      vmstate.shared->settings.opcode_stats_enabled = true;
     } else if (i > 0 && strcmp(argv[i], "-j") == 0) {
       vmstate.shared->settings.jit_enabled = true;
+    } else if (i > 0 && strcmp(argv[i], "--prefetch") == 0) {
+      vmstate.shared->settings.prefetch_enabled = true;
+    } else if (i > 0 && i < argc - 1 && strcmp(argv[i], "--emit-c") == 0) {
+      emit_c_file = argv[++i];
+    } else if (i > 0 && i < argc - 1 && strcmp(argv[i], "--snapshot") == 0) {
+      snapshot_file = argv[++i];
+    } else if (i > 0 && i < argc - 1 && strcmp(argv[i], "--snapshot-out") == 0) {
+      snapshot_out_file = argv[++i];
+      vmstate.shared->settings.specialization_disabled = true;
     } else {
       argv2 = realloc(argv2, sizeof(char*) * ++argc2);
       argv2[argc2 - 1] = argv[i];
@@ -49,12 +66,26 @@ int main(int argc, char **argv) {
     fprintf(stderr, "Profiling breaks JIT. Disabling JIT.\n");
     vmstate.shared->settings.jit_enabled = false;
   }
+  if (vmstate.shared->settings.opcode_stats_enabled && vmstate.shared->settings.jit_enabled) {
+    fprintf(stderr, "Opcode stats break JIT. Disabling JIT.\n");
+    vmstate.shared->settings.jit_enabled = false;
+  }
   argc = argc2;
   argv = argv2;
   
   init_instr_fn_table();
   
-  Object *root = create_root(&vmstate);
+  Object *root;
+  if (snapshot_file) {
+    char *error = snapshot_load(&vmstate, snapshot_file);
+    if (error) {
+      fprintf(stderr, "cannot load snapshot: %s\n", error);
+      return 1;
+    }
+    root = vmstate.root;
+  } else {
+    root = create_root(&vmstate);
+  }
   Value rootval = OBJ2VAL(root);
   
   GCRootSet set;
@@ -66,13 +97,14 @@ int main(int argc, char **argv) {
   add_reserved_identifier("new");
   
   UserFunction *module;
-  char *text = source.start;
-  ParseResult res = parse_module(&text, &module);
+  ParseResult res = parse_module_cached(source, &module);
   if (res != PARSE_OK) {
     return 1;
   }
   assert(res == PARSE_OK);
   
+  if (vmstate.shared->settings.prefetch_enabled) prefetch_requires(&vmstate, source);
+  
   int args_len = argc - 2;
   Value *args_ptr = malloc(sizeof(Value) * args_len);
   for (int i = 2; i < argc; ++i) {
@@ -90,6 +122,8 @@ int main(int argc, char **argv) {
   module = optimize_runtime(&vmstate, module, root);
   vm_resolve_functions(module);
   
+  if (emit_c_file) aot_record_functions();
+  
   Value retval;
   
   CallInfo info = {{0}};
@@ -101,6 +135,9 @@ int main(int argc, char **argv) {
   if (vmstate.shared->settings.profiling_enabled) {
     save_profile_output("profile.cg", &vmstate.shared->profstate);
   }
+  if (vmstate.shared->settings.opcode_stats_enabled) {
+    dump_opcode_stats(&vmstate.shared->profstate);
+  }
   
   int resvalue = 0;
   if (vmstate.runstate == VM_ERRORED) {
@@ -110,6 +147,24 @@ int main(int argc, char **argv) {
     resvalue = 1;
   }
   
+  if (emit_c_file && resvalue == 0) {
+    FILE *out = fopen(emit_c_file, "w");
+    if (!out) {
+      fprintf(stderr, "cannot open '%s' for writing\n", emit_c_file);
+      return 1;
+    }
+    aot_emit_module(&vmstate, module, argv[1], source.start, source.end - source.start, out);
+    fclose(out);
+  }
+  
+  if (snapshot_out_file && resvalue == 0) {
+    char *error = snapshot_save(&vmstate, snapshot_out_file, argv[1], source);
+    if (error) {
+      fprintf(stderr, "cannot save snapshot: %s\n", error);
+      return 1;
+    }
+  }
+  
   if (vmstate.shared->verbose) {
     printf("(%i cycles)\n", vmstate.shared->cyclecount);
   }
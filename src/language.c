@@ -24,7 +24,7 @@ typedef struct {
   bool safe_to_discard;
 } RefValue;
 
-static ParseResult parse_function_expr(char **textp, FunctionBuilder *pbuilder, UserFunction **uf);
+static ParseResult parse_function_expr(char **textp, FunctionBuilder *pbuilder, UserFunction **uf, UserFunction *stub);
 
 static RefValue ref_simple(Slot slot) {
   return (RefValue) { slot, (Slot) { .index = -1 }, REFMODE_NONE, NULL };
@@ -117,7 +117,7 @@ static ParseResult parse_object_literal_body(char **textp, FunctionBuilder *buil
       builder->hints.fun_name_hint = ident_name;
       
       UserFunction *fn;
-      ParseResult res = parse_function_expr(&text, builder, &fn);
+      ParseResult res = parse_function_expr(&text, builder, &fn, NULL);
       fn->is_method = is_method;
       if (res == PARSE_ERROR) return res;
       if (res == PARSE_NONE) {
@@ -365,7 +365,7 @@ static ParseResult parse_expr_stem(char **textp, FunctionBuilder *builder, RefVa
     }
     
     UserFunction *fn;
-    ParseResult res = parse_function_expr(&text, builder, &fn);
+    ParseResult res = parse_function_expr(&text, builder, &fn, NULL);
     if (res == PARSE_ERROR) return res;
     if (res == PARSE_NONE) { text = *textp; record_start(text, range); }
     else {
@@ -1795,7 +1795,7 @@ static ParseResult parse_fundecl(char **textp, FunctionBuilder *builder, FileRan
   use_range_end(builder, range);
   
   UserFunction *fn;
-  ParseResult res = parse_function_expr(textp, builder, &fn);
+  ParseResult res = parse_function_expr(textp, builder, &fn, NULL);
   if (res == PARSE_ERROR) return res;
   if (res == PARSE_NONE) {
     log_parser_error(*textp, "opening paren for parameter list expected");
@@ -1953,8 +1953,70 @@ static ParseResult parse_block(char **textp, FunctionBuilder *builder, bool forc
 
 __thread int lambda_count = 0;
 
-static ParseResult parse_function_expr(char **textp, FunctionBuilder *pbuilder, UserFunction **uf_p) {
+static __thread RegisteredFunction *registered_fns_ptr = NULL;
+static __thread int registered_fns_len = 0;
+
+// find the end of a function body without building it. strings and comments are skipped
+// as the parser would, so braces in them don't count.
+static bool skip_block(char **textp) {
   char *text = *textp;
+  if (!eat_string(&text, "{")) return false;
+  int depth = 1;
+  while (depth > 0) {
+    eat_filler(&text);
+    if (!*text) return false;
+    if (*text == '"') {
+      char *str;
+      if (parse_string(&text, &str) != PARSE_OK) return false;
+      free(str);
+      continue;
+    }
+    if (*text == '{') depth++;
+    else if (*text == '}') depth--;
+    text++;
+  }
+  *textp = text;
+  return true;
+}
+
+static __thread bool queue_registrations = false;
+static __thread RegisteredFunction *queued_fns_ptr = NULL;
+static __thread int queued_fns_len = 0;
+
+void parse_queue_registrations(bool queue) {
+  queue_registrations = queue;
+}
+
+RegisteredFunction *parse_take_queued_registrations(int *len_p) {
+  RegisteredFunction *res = queued_fns_ptr;
+  *len_p = queued_fns_len;
+  queued_fns_ptr = NULL;
+  queued_fns_len = 0;
+  return res;
+}
+
+void parse_register_function(TextRange range, char *name) {
+  if (!queue_registrations) {
+    register_function(range, name);
+    return;
+  }
+  queued_fns_ptr = realloc(queued_fns_ptr, sizeof(RegisteredFunction) * ++queued_fns_len);
+  queued_fns_ptr[queued_fns_len - 1] = (RegisteredFunction) { .range = range, .name = name };
+}
+
+static void register_fn_range(FileRange *fn_range, char *fun_hint) {
+  parse_register_function((TextRange) { fn_range->text_from, fn_range->text_from + fn_range->text_len }, fun_hint);
+  registered_fns_ptr = realloc(registered_fns_ptr, sizeof(RegisteredFunction) * ++registered_fns_len);
+  registered_fns_ptr[registered_fns_len - 1] = (RegisteredFunction) {
+    .range = { fn_range->text_from, fn_range->text_from + fn_range->text_len },
+    .name = fun_hint
+  };
+}
+
+// stub is the lazy function whose body is being built, else NULL (first parse: leave the body for later)
+static ParseResult parse_function_expr(char **textp, FunctionBuilder *pbuilder, UserFunction **uf_p, UserFunction *stub) {
+  char *text = *textp;
+  char *fn_start = text;
   char *fun_name = parse_identifier(&text);
   char *fun_hint = fun_name;
   if (!fun_hint && pbuilder && pbuilder->hints.fun_name_hint_pos == text) {
@@ -2035,6 +2097,28 @@ static ParseResult parse_function_expr(char **textp, FunctionBuilder *pbuilder,
   
   *textp = text;
   
+  if (!stub) {
+    // don't build the body until the first call; if it won't brace-match, parse it now for the error
+    char *body_end = text;
+    if (skip_block(&body_end)) {
+      record_end(body_end, fn_range);
+      register_fn_range(fn_range, fun_hint);
+      UserFunction *uf = calloc(sizeof(UserFunction), 1);
+      uf->arity = arg_list_len;
+      uf->name = fun_name;
+      uf->variadic_tail = variadic_tail;
+      uf->body.function_range = fnframe_range;
+      uf->lazy_text = fn_start;
+      finalize(uf);
+      for (int i = 0; i < arg_list_len; ++i) free(arg_list_ptr[i]);
+      free(arg_list_ptr);
+      free(type_constraints_ptr);
+      *textp = body_end;
+      *uf_p = uf;
+      return PARSE_OK;
+    }
+  }
+  
   FunctionBuilder *builder = calloc(sizeof(FunctionBuilder), 1);
   builder->arglist_ptr = arg_list_ptr;
   builder->arglist_len = arg_list_len;
@@ -2091,18 +2175,40 @@ static ParseResult parse_function_expr(char **textp, FunctionBuilder *pbuilder,
   assert(res == PARSE_OK);
   
   record_end(*textp, fn_range);
-  register_function((TextRange) { fn_range->text_from, fn_range->text_from + fn_range->text_len }, fun_hint);
+  if (!stub) register_fn_range(fn_range, fun_hint); // else done on the first parse
   
   use_range_start(builder, fnframe_range);
   terminate(builder);
   use_range_end(builder, fnframe_range);
   
-  *uf_p = optimize(build_function(builder));
-  finalize(*uf_p);
+  UserFunction *uf = optimize(build_function(builder));
+  finalize(uf);
+  if (stub) {
+    // closures already point at the stub, so fill it in place
+    uf->is_method = stub->is_method;
+    free(fun_hint);
+    *stub = *uf;
+    free(uf);
+    uf = stub;
+  }
+  *uf_p = uf;
   return PARSE_OK;
 }
 
+bool parse_lazy_function(UserFunction *uf) {
+  assert(uf->lazy_text);
+  char *text = uf->lazy_text;
+  UserFunction *res_fn;
+  return parse_function_expr(&text, NULL, &res_fn, uf) == PARSE_OK;
+}
+
+RegisteredFunction *parse_registered_functions(int *len_p) {
+  *len_p = registered_fns_len;
+  return registered_fns_ptr;
+}
+
 ParseResult parse_module(char **textp, UserFunction **uf_p) {
+  registered_fns_len = 0;
   FunctionBuilder *builder = calloc(sizeof(FunctionBuilder), 1);
   builder->slot_base = 2;
   builder->name = NULL;
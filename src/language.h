@@ -6,4 +6,28 @@
 
 ParseResult parse_module(char **textp, UserFunction **uf_p);
 
+// what the last parse_module passed to register_function, so the bytecode cache can replay it
+typedef struct {
+  TextRange range;
+  char *name;
+} RegisteredFunction;
+
+RegisteredFunction *parse_registered_functions(int *len_p);
+
+// rdparse's file and function registry isn't safe to use from several threads. a thread that parses
+// alongside others (see vm/prefetch.h) queues its register_function calls instead, and the thread
+// that owns the registry replays them.
+void parse_queue_registrations(bool queue);
+
+// the queued registrations, which the caller now owns; the queue is empty afterwards
+RegisteredFunction *parse_take_queued_registrations(int *len_p);
+
+// register_function, or queue it
+void parse_register_function(TextRange range, char *name);
+
+// nested functions are parsed lazily: the first parse only reads the parameter list and brace-matches
+// the body, leaving a stub with lazy_text set. this builds the stub in place, so a syntax error in
+// a function body is only reported once it's called. false on parse error (already logged).
+bool parse_lazy_function(UserFunction *uf);
+
 #endif
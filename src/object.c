@@ -6,6 +6,7 @@
 
 #include "object.h"
 #include "trie.h"
+#include "vm/analysis.h"
 
 #define DEBUG_MEM 0
 
@@ -439,6 +440,8 @@ Value make_fn_custom(VMState *state, VMFunctionPointer fn, InstrDispatchFn dispa
   obj->fn_ptr = fn;
   obj->dispatch_fn_ptr = dispatch_fn;
   obj->method = method;
+  obj->pure = false;
+  obj->allocates = false;
   return OBJ2VAL((Object*) obj);
 }
 
@@ -446,8 +449,23 @@ Value make_fn(VMState *state, VMFunctionPointer fn) {
   return make_fn_custom(state, fn, NULL, sizeof(FunctionObject), true);
 }
 
+// fast functions are all arithmetic, so they're pure as well
 Value make_fn_fast(VMState *state, VMFunctionPointer fn, InstrDispatchFn dispatch_fn) {
-  return make_fn_custom(state, fn, dispatch_fn, sizeof(FunctionObject), true);
+  Value fn_val = make_fn_custom(state, fn, dispatch_fn, sizeof(FunctionObject), true);
+  ((FunctionObject*) AS_OBJ(fn_val))->pure = true;
+  return fn_val;
+}
+
+Value make_fn_pure(VMState *state, VMFunctionPointer fn) {
+  Value fn_val = make_fn(state, fn);
+  ((FunctionObject*) AS_OBJ(fn_val))->pure = true;
+  return fn_val;
+}
+
+Value make_fn_pure_alloc(VMState *state, VMFunctionPointer fn) {
+  Value fn_val = make_fn_pure(state, fn);
+  ((FunctionObject*) AS_OBJ(fn_val))->allocates = true;
+  return fn_val;
 }
 
 Value make_fn_global(VMState *state, VMFunctionPointer fn) {
@@ -455,6 +473,12 @@ Value make_fn_global(VMState *state, VMFunctionPointer fn) {
   return make_fn_custom(state, fn, NULL, sizeof(FunctionObject), false);
 }
 
+Value make_fn_global_pure(VMState *state, VMFunctionPointer fn) {
+  Value fn_val = make_fn_global(state, fn);
+  ((FunctionObject*) AS_OBJ(fn_val))->pure = true;
+  return fn_val;
+}
+
 char *get_val_info(VMState *state, Value val) {
   if (IS_NULL(val)) return "<null>";
   else if (IS_INT(val)) return my_asprintf("<int: %i>", AS_INT(val));
@@ -472,6 +496,14 @@ char *get_val_info(VMState *state, Value val) {
 }
 
 void free_function(UserFunction *uf) {
+  analysis_invalidate(uf);
+  if (uf->specializations) {
+    // the specialized versions themselves may still be in use by closures
+    SpecializationCache *cache = uf->specializations;
+    *cache->prev_p = cache->next;
+    if (cache->next) cache->next->prev_p = cache->prev_p;
+    free(cache);
+  }
   free(uf->body.blocks_ptr);
   free(uf->body.instrs_ptr);
   free(uf->body.ranges_ptr);
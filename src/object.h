@@ -93,7 +93,7 @@ static inline Value load_arg(Callframe *frame, Arg arg) {
   } else if (arg.kind == ARG_REFSLOT) {
     assert(arg.refslot.is_resolved);
     return read_refslot(frame, arg.refslot);
-  } else return arg.value;
+  } else return *arg.value;
   // NOT faster
   /*
   Value *ptrs[] = {
@@ -116,7 +116,7 @@ static inline Value load_arg_specialized(Callframe *frame, Arg arg, int kind) {
   } else if (kind == ARG_REFSLOT) {
     assert(arg.refslot.is_resolved);
     return read_refslot(frame, arg.refslot);
-  } else return arg.value;
+  } else return *arg.value;
 }
 
 void value_failed_type_constraint_error(VMState *state, Object *constraint, Value value);
@@ -175,6 +175,8 @@ typedef struct {
   VMFunctionPointer fn_ptr;
   InstrDispatchFn dispatch_fn_ptr;
   bool method;
+  bool pure; // writes no objects, result depends only on this and args
+  bool allocates; // pure, but returns a new object every call (like string '+'), so two calls can't share it
 } FunctionObject;
 
 // such as script functions
@@ -226,8 +228,14 @@ Value make_fn(VMState *state, VMFunctionPointer fn);
 
 Value make_fn_fast(VMState *state, VMFunctionPointer fn, InstrDispatchFn fast_fn);
 
+Value make_fn_pure(VMState *state, VMFunctionPointer fn);
+
+Value make_fn_pure_alloc(VMState *state, VMFunctionPointer fn);
+
 Value make_fn_global(VMState *state, VMFunctionPointer fn);
 
+Value make_fn_global_pure(VMState *state, VMFunctionPointer fn);
+
 Value make_custom_gc(VMState *state);
 
 // here so that object.c can use it
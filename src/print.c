@@ -70,8 +70,8 @@ static void print_recursive_indent(VMState *state, FILE *fh, Value val, bool all
     Value str;
     
     CallInfo info = {{0}};
-    info.this_arg = (Arg) { .kind = ARG_VALUE, .value = val };
-    info.fn = (Arg) { .kind = ARG_VALUE, .value = toString_fn };
+    info.this_arg = (Arg) { .kind = ARG_VALUE, .value = &val };
+    info.fn = (Arg) { .kind = ARG_VALUE, .value = &toString_fn };
     info.target = (WriteArg) { .kind = ARG_POINTER, .pointer = &str };
     
     if (!setup_call(&substate, &info, NULL)) return;
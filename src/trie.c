@@ -7,6 +7,9 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 // TODO sync
 static void *freeslab = NULL; // should be 1-2MB, so allocate in MB-size steps
@@ -200,11 +203,26 @@ bool trie_lookup(TrieNode * __restrict__ node, const char *key_ptr, size_t key_l
   }
 }
 
-// TODO mutex or make lockless (read/write lock? writes should be rare)
+// TODO make lockless (read/write lock? writes should be rare)
 static TrieNode *intern_string_trie = NULL;
 static uint32_t lcg_state = 1;
 static HashTable intern_reverse = {0}; // unique hash value to string
 
+// the lock is only taken while other threads may intern too, so the vm doesn't pay for it otherwise
+static bool intern_threaded = false;
+#ifndef _WIN32
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+#define INTERN_LOCK() if (UNLIKELY(intern_threaded)) pthread_mutex_lock(&intern_lock)
+#define INTERN_UNLOCK() if (UNLIKELY(intern_threaded)) pthread_mutex_unlock(&intern_lock)
+#else
+#define INTERN_LOCK() (void) 0
+#define INTERN_UNLOCK() (void) 0
+#endif
+
+void intern_set_threaded(bool threaded) {
+  intern_threaded = threaded;
+}
+
 void trie_dump_intern(FILE *file) {
   trie_dump_internal(file, intern_string_trie, 0);
 }
@@ -215,6 +233,7 @@ FastKey prepare_key(const char *key_ptr, size_t key_len) {
   // const char *old_ptr = key_ptr;
   // hash will be identical
   uint32_t hash; const char *key;
+  INTERN_LOCK();
   if (!trie_lookup(intern_string_trie, key_ptr, key_len, &hash, &key)) {
     char *copy = trie_alloc_uninitialized(key_len + 1);
     memcpy(copy, key_ptr, key_len);
@@ -237,6 +256,7 @@ FastKey prepare_key(const char *key_ptr, size_t key_len) {
     // trie_dump(stderr, intern_string_trie);
     // fprintf(stderr, "------\n");
   }
+  INTERN_UNLOCK();
   return (FastKey) {
     .hash = hash,
     .key = key
@@ -245,7 +265,10 @@ FastKey prepare_key(const char *key_ptr, size_t key_len) {
 
 const char *trie_reverse_lookup(uint32_t hash) {
   FastKey fkey = { .hash = hash };
+  INTERN_LOCK();
   TableEntry *rev_entry = table_lookup_prepared(&intern_reverse, &fkey);
   assert(rev_entry != NULL);
-  return (const char*) rev_entry->value.obj;
+  const char *res = (const char*) rev_entry->value.obj;
+  INTERN_UNLOCK();
+  return res;
 }
@@ -0,0 +1,239 @@
+#include "vm/analysis.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "vm/dump.h"
+
+static FunctionAnalysis *analysis_get(UserFunction *uf) {
+  if (!uf->analysis) uf->analysis = calloc(1, sizeof(FunctionAnalysis));
+  return uf->analysis;
+}
+
+void analysis_invalidate(UserFunction *uf) {
+  FunctionAnalysis *an = uf->analysis;
+  if (!an) return;
+  free(an->idom_ptr);
+  free(an->dom_pre_ptr);
+  free(an->dom_post_ptr);
+  free(an->loop_header_ptr);
+  free(an->loop_depth_ptr);
+  if (an->loop_body_ptr) {
+    for (int i = 0; i < an->cfg.nodes_len; i++) if (an->loop_body_ptr[i].ptr) bitset_free(an->loop_body_ptr[i]);
+    free(an->loop_body_ptr);
+  }
+  free(an->refslot_slot_ptr);
+  if (an->has_cfg) cfg_destroy(&an->cfg);
+  free(an);
+  uf->analysis = NULL;
+}
+
+CFG *analysis_cfg(UserFunction *uf) {
+  FunctionAnalysis *an = analysis_get(uf);
+  if (!an->has_cfg) {
+    cfg_build(&an->cfg, uf);
+    an->has_cfg = true;
+  }
+  return &an->cfg;
+}
+
+int analysis_instr_block(UserFunction *uf, Instr *instr) {
+  // blocks are laid out in order, so binary search their offsets
+  int offset = (char*) instr - (char*) uf->body.instrs_ptr;
+  int low = 0, high = uf->body.blocks_len - 1;
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (uf->body.blocks_ptr[mid].offset <= offset) low = mid;
+    else high = mid - 1;
+  }
+  InstrBlock *blk = &uf->body.blocks_ptr[low];
+  if (offset < blk->offset || offset >= blk->offset + blk->size) {
+    fprintf(stderr, "instr not in function\n");
+    abort();
+  }
+  return low;
+}
+
+static void analysis_build_domtree(UserFunction *uf, FunctionAnalysis *an) {
+  CFG *cfg = analysis_cfg(uf);
+  int blocks_len = cfg->nodes_len;
+  RPost2Node rpost2node = cfg_get_reverse_postorder(cfg);
+  Node2RPost node2rpost = cfg_invert_rpost(cfg, rpost2node);
+  an->idom_ptr = cfg_build_sfidom_list(cfg, rpost2node, node2rpost);
+  free(rpost2node.ptr);
+  free(node2rpost.ptr);
+
+  // children lists of the dominator tree, flattened
+  int *child_first = calloc(blocks_len + 1, sizeof(int));
+  for (int i = 1; i < blocks_len; i++) if (an->idom_ptr[i] != -1) child_first[an->idom_ptr[i] + 1]++;
+  for (int i = 0; i < blocks_len; i++) child_first[i + 1] += child_first[i];
+  int *children = malloc(sizeof(int) * (child_first[blocks_len] + 1));
+  int *child_cursor = malloc(sizeof(int) * blocks_len);
+  for (int i = 0; i < blocks_len; i++) child_cursor[i] = child_first[i];
+  for (int i = 1; i < blocks_len; i++) if (an->idom_ptr[i] != -1) children[child_cursor[an->idom_ptr[i]]++] = i;
+
+  // number the tree depth-first; unreachable blocks keep -1
+  an->dom_pre_ptr = malloc(sizeof(int) * blocks_len);
+  an->dom_post_ptr = malloc(sizeof(int) * blocks_len);
+  for (int i = 0; i < blocks_len; i++) an->dom_pre_ptr[i] = an->dom_post_ptr[i] = -1;
+  int *stack = malloc(sizeof(int) * blocks_len), stack_len = 0;
+  int pre = 0, post = 0;
+  for (int i = 0; i < blocks_len; i++) child_cursor[i] = child_first[i];
+  stack[stack_len++] = 0;
+  an->dom_pre_ptr[0] = pre++;
+  while (stack_len) {
+    int blk = stack[stack_len - 1];
+    if (child_cursor[blk] < child_first[blk + 1]) {
+      int child = children[child_cursor[blk]++];
+      an->dom_pre_ptr[child] = pre++;
+      stack[stack_len++] = child;
+    } else {
+      an->dom_post_ptr[blk] = post++;
+      stack_len--;
+    }
+  }
+  free(stack);
+  free(child_cursor);
+  free(children);
+  free(child_first);
+}
+
+int analysis_idom(UserFunction *uf, int blk) {
+  FunctionAnalysis *an = analysis_get(uf);
+  if (!an->idom_ptr) analysis_build_domtree(uf, an);
+  return an->idom_ptr[blk];
+}
+
+bool analysis_block_dominates(UserFunction *uf, int dominator, int blk) {
+  FunctionAnalysis *an = analysis_get(uf);
+  if (!an->idom_ptr) analysis_build_domtree(uf, an);
+  if (an->dom_pre_ptr[dominator] == -1 || an->dom_pre_ptr[blk] == -1) return false;
+  return an->dom_pre_ptr[dominator] <= an->dom_pre_ptr[blk]
+    && an->dom_post_ptr[blk] <= an->dom_post_ptr[dominator];
+}
+
+bool analysis_dominates(UserFunction *uf, Instr *earlier, Instr *later) {
+  int blk_earlier = analysis_instr_block(uf, earlier);
+  int blk_later = analysis_instr_block(uf, later);
+  if (blk_earlier == blk_later) {
+    return earlier <= later;
+  }
+  return analysis_block_dominates(uf, blk_earlier, blk_later);
+}
+
+static void analysis_build_loops(UserFunction *uf, FunctionAnalysis *an) {
+  CFG *cfg = analysis_cfg(uf);
+  int blocks_len = cfg->nodes_len;
+  an->loop_header_ptr = malloc(sizeof(int) * blocks_len);
+  an->loop_depth_ptr = calloc(blocks_len, sizeof(int));
+  for (int i = 0; i < blocks_len; i++) an->loop_header_ptr[i] = -1;
+
+  // a natural loop per header: every block that reaches a back edge into it without passing it.
+  // (irreducible control flow can't come out of our compiler, so back edges are all we look for.)
+  Bitset *body_ptr = an->loop_body_ptr = calloc(blocks_len, sizeof(Bitset));
+  int *body_size = calloc(blocks_len, sizeof(int));
+  int *worklist = malloc(sizeof(int) * blocks_len);
+  for (int blk = 0; blk < blocks_len; blk++) {
+    for (int k = 0; k < cfg->nodes_ptr[blk].succ_len; k++) {
+      int header = cfg->nodes_ptr[blk].succ_ptr[k];
+      if (!analysis_block_dominates(uf, header, blk)) continue;
+      if (!body_ptr[header].ptr) {
+        body_ptr[header] = bitset_alloc(blocks_len);
+        bitset_set(body_ptr[header], header);
+        body_size[header] = 1;
+      }
+      Bitset body = body_ptr[header];
+      int worklist_len = 0;
+      if (!bitset_test(body, blk)) {
+        bitset_set(body, blk);
+        body_size[header]++;
+        worklist[worklist_len++] = blk;
+      }
+      while (worklist_len) {
+        CFGNode *node = &cfg->nodes_ptr[worklist[--worklist_len]];
+        for (int l = 0; l < node->pred_len; l++) {
+          int pred = node->pred_ptr[l];
+          if (bitset_test(body, pred)) continue;
+          bitset_set(body, pred);
+          body_size[header]++;
+          worklist[worklist_len++] = pred;
+        }
+      }
+    }
+  }
+  free(worklist);
+
+  // outer loops first, so inner loops overwrite them as the innermost header
+  int *headers = malloc(sizeof(int) * blocks_len), headers_len = 0;
+  for (int i = 0; i < blocks_len; i++) if (body_ptr[i].ptr) headers[headers_len++] = i;
+  for (int i = 1; i < headers_len; i++) {
+    int header = headers[i], k = i;
+    for (; k > 0 && body_size[headers[k - 1]] < body_size[header]; k--) headers[k] = headers[k - 1];
+    headers[k] = header;
+  }
+  for (int i = 0; i < headers_len; i++) {
+    Bitset body = body_ptr[headers[i]];
+    for (int blk = bitset_next(body, 0); blk != -1; blk = bitset_next(body, blk + 1)) {
+      an->loop_header_ptr[blk] = headers[i];
+      an->loop_depth_ptr[blk]++;
+    }
+  }
+  free(headers);
+  free(body_size);
+}
+
+int analysis_loop_header(UserFunction *uf, int blk) {
+  FunctionAnalysis *an = analysis_get(uf);
+  if (!an->loop_header_ptr) analysis_build_loops(uf, an);
+  return an->loop_header_ptr[blk];
+}
+
+int analysis_loop_depth(UserFunction *uf, int blk) {
+  FunctionAnalysis *an = analysis_get(uf);
+  if (!an->loop_header_ptr) analysis_build_loops(uf, an);
+  return an->loop_depth_ptr[blk];
+}
+
+bool analysis_loop_contains(UserFunction *uf, int header, int blk) {
+  FunctionAnalysis *an = analysis_get(uf);
+  if (!an->loop_header_ptr) analysis_build_loops(uf, an);
+  return an->loop_body_ptr[header].ptr && bitset_test(an->loop_body_ptr[header], blk);
+}
+
+static void analysis_build_refslot_slots(UserFunction *uf, FunctionAnalysis *an) {
+  an->refslots_len = uf->refslots;
+  an->refslot_slot_ptr = malloc(sizeof(int) * uf->refslots);
+  for (int i = 0; i < uf->refslots; i++) an->refslot_slot_ptr[i] = -1;
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr != instr_end) {
+      if (instr->type == INSTR_DEFINE_REFSLOT) {
+        DefineRefslotInstr *dri = (DefineRefslotInstr*) instr;
+        an->refslot_slot_ptr[refslot_index_rt(uf, dri->target_refslot)] = slot_index_rt(uf, dri->obj_slot);
+      }
+      if (instr->type == INSTR_ALLOC_STATIC_OBJECT) {
+        AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr;
+        for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
+          an->refslot_slot_ptr[refslot_index_rt(uf, ASOI_INFO(asoi)[k].refslot)] = slot_index_rt(uf, asoi->target_slot);
+        }
+      }
+      instr = (Instr*)((char*) instr + instr_size(instr));
+    }
+  }
+}
+
+Slot analysis_refslot_slot(UserFunction *uf, Refslot refslot) {
+  FunctionAnalysis *an = analysis_get(uf);
+  if (!an->refslot_slot_ptr) analysis_build_refslot_slots(uf, an);
+  int refslot_index = refslot_index_rt(uf, refslot);
+  assert(an->refslots_len == uf->refslots);
+  if (an->refslot_slot_ptr[refslot_index] == -1) {
+    dump_fn(NULL, uf);
+    fprintf(stderr, "Refslot not found\n");
+    abort();
+  }
+  Slot slot = (Slot) { .index = an->refslot_slot_ptr[refslot_index] };
+  if (uf->resolved) resolve_slot_ref(uf, &slot);
+  return slot;
+}
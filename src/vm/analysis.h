@@ -0,0 +1,49 @@
+#ifndef JERBOA_VM_ANALYSIS_H
+#define JERBOA_VM_ANALYSIS_H
+
+#include "vm/cfg.h"
+#include "vm/dataflow.h"
+
+// per-function cache of the analyses that optimizer passes share.
+// every part is computed on first use and kept until analysis_invalidate.
+// functions built by a pass start out without one; a pass that modifies a function
+// in place must invalidate it before anything else asks.
+struct _FunctionAnalysis {
+  bool has_cfg;
+  CFG cfg;
+
+  // dominator tree
+  int *idom_ptr; // immediate dominator per block; the entry is its own, -1 if unreachable
+  int *dom_pre_ptr, *dom_post_ptr; // dfs numbering of the tree, for O(1) dominance checks
+
+  // natural loops
+  int *loop_header_ptr; // header of the innermost loop containing the block, or -1
+  int *loop_depth_ptr;
+  Bitset *loop_body_ptr; // blocks of the loop headed by the block, including nested loops; empty .ptr if not a header
+
+  int *refslot_slot_ptr; int refslots_len; // index of the object slot each refslot was defined on, or -1
+};
+
+void analysis_invalidate(UserFunction *uf);
+
+CFG *analysis_cfg(UserFunction *uf);
+
+// block containing the instr
+int analysis_instr_block(UserFunction *uf, Instr *instr);
+
+int analysis_idom(UserFunction *uf, int blk);
+
+bool analysis_block_dominates(UserFunction *uf, int dominator, int blk);
+
+bool analysis_dominates(UserFunction *uf, Instr *earlier, Instr *later);
+
+int analysis_loop_header(UserFunction *uf, int blk);
+
+int analysis_loop_depth(UserFunction *uf, int blk);
+
+// is blk part of the loop headed by header (possibly in a nested loop)?
+bool analysis_loop_contains(UserFunction *uf, int header, int blk);
+
+Slot analysis_refslot_slot(UserFunction *uf, Refslot refslot);
+
+#endif
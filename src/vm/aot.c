@@ -0,0 +1,359 @@
+#include "vm/aot.h"
+#include "vm/optimize.h"
+#include "vm/vm.h"
+#include "object.h"
+#include "language.h"
+#include "util.h"
+
+#include <string.h>
+
+// loaded compiled modules, searched by code hash whenever a function gets its final shape
+typedef struct _AotRegistry AotRegistry;
+struct _AotRegistry {
+  const AotModule *module;
+  AotRegistry *next;
+};
+
+static AotRegistry *aot_registry = NULL;
+
+// functions optimized at runtime during an --emit-c run
+static bool aot_recording = false;
+static UserFunction **aot_recorded_ptr = NULL;
+static int aot_recorded_len = 0;
+
+static void add_function(UserFunction *fn, UserFunction ***fns_ptr_p, int *fns_len_p) {
+  for (int i = 0; i < *fns_len_p; i++) if ((*fns_ptr_p)[i] == fn) return;
+  *fns_ptr_p = realloc(*fns_ptr_p, sizeof(UserFunction*) * ++*fns_len_p);
+  (*fns_ptr_p)[*fns_len_p - 1] = fn;
+}
+
+// every function reachable through closure allocations, in dump_fn order
+static void collect_closures(UserFunction *fn, UserFunction ***fns_ptr_p, int *fns_len_p) {
+  for (int i = 0; i < fn->body.blocks_len; i++) {
+    Instr *instr = BLOCK_START(fn, i), *instr_end = BLOCK_END(fn, i);
+    while (instr != instr_end) {
+      if (instr->type == INSTR_ALLOC_CLOSURE_OBJECT) {
+        UserFunction *closure_fn = ((AllocClosureObjectInstr*) instr)->fn;
+        // compiled code is found by a hash of the body, so build it now rather than on the first call
+        if (closure_fn->lazy_text && !parse_lazy_function(closure_fn)) {
+          instr = (Instr*) ((char*) instr + instr_size(instr));
+          continue;
+        }
+        int prev_len = *fns_len_p;
+        add_function(closure_fn, fns_ptr_p, fns_len_p);
+        if (*fns_len_p != prev_len) collect_closures(closure_fn, fns_ptr_p, fns_len_p);
+      }
+      instr = (Instr*) ((char*) instr + instr_size(instr));
+    }
+  }
+}
+
+#define INSTR_AT(T, OFFS) "((" #T "*) (instrs + %i))", (OFFS)
+
+static void emit_load(FILE *out, Arg arg, const char *instr_fmt, int offset, const char *field) {
+  if (arg.kind == ARG_SLOT) {
+    fprintf(out, "(*(Value*) ((char*) frame + %i))", arg.slot.offset);
+  } else if (arg.kind == ARG_REFSLOT) {
+    fprintf(out, "((*(TableEntry**) ((char*) frame + %i))->value)", arg.refslot.offset);
+  } else if (arg.value->type == TYPE_NULL) {
+    fprintf(out, "VNULL");
+  } else if (arg.value->type == TYPE_INT) {
+    fprintf(out, "INT2VAL(%i)", arg.value->i);
+  } else if (arg.value->type == TYPE_BOOL) {
+    fprintf(out, "BOOL2VAL(%s)", arg.value->b ? "true" : "false");
+  } else if (arg.value->type == TYPE_FLOAT) {
+    fprintf(out, "FLOAT2VAL(%a)", arg.value->f);
+  } else {
+    // objects are reached through the constant pool pointer in the loaded function's instr
+    fprintf(out, "(*");
+    fprintf(out, instr_fmt, offset);
+    fprintf(out, "->%s.value)", field);
+  }
+}
+
+static void emit_slot(FILE *out, WriteArg target) {
+  assert(target.kind == ARG_SLOT);
+  fprintf(out, "*(Value*) ((char*) frame + %i)", target.slot.offset);
+}
+
+// hand the instr to its interpreter function; stay compiled if it went on to the next instr
+static void emit_fallback(FILE *out, int offset, int next_offset, const char *indent) {
+  fprintf(out, "%sstate->instr = (Instr*) (instrs + %i);\n", indent, offset);
+  fprintf(out, "%snext = state->instr->fn(state);\n", indent);
+  fprintf(out, "%sif (UNLIKELY(state->instr != (Instr*) (instrs + %i) || state->runstate != VM_RUNNING)) return next;\n",
+          indent, next_offset);
+}
+
+static void emit_exit(FILE *out, int offset) {
+  fprintf(out, "  state->instr = (Instr*) (instrs + %i);\n", offset);
+  fprintf(out, "  return state->instr->fn(state);\n");
+}
+
+// blocks are emitted in order (see layout_blocks_by_profile), so a branch to the next one falls through
+static bool falls_through(int from_blk, int to_blk) {
+  return to_blk == from_blk + 1;
+}
+
+static void emit_branch(FILE *out, UserFunction *fn, int from_blk, int to_blk, const char *indent) {
+  if (!fn->phi_free) fprintf(out, "%sframe->block = %i;\n", indent, to_blk);
+  if (falls_through(from_blk, to_blk)) return;
+  if (to_blk <= from_blk) {
+    // gc only runs in the main loop, so loops must drop back into the interpreter when it's due
+    fprintf(out, "%sif (UNLIKELY(state->shared->gcstate.bytes_allocated > state->shared->gcstate.next_gc_run)) {\n", indent);
+    fprintf(out, "%s  state->instr = (Instr*) (instrs + %i);\n", indent, fn->body.blocks_ptr[to_blk].offset);
+    fprintf(out, "%s  return (FnWrap) { state->instr->fn };\n", indent);
+    fprintf(out, "%s}\n", indent);
+  }
+  fprintf(out, "%sgoto blk_%i;\n", indent, to_blk);
+}
+
+static void emit_instr(FILE *out, UserFunction *fn, int blk, Instr *instr, bool last_in_block) {
+  int offset = (char*) instr - (char*) fn->body.instrs_ptr;
+  int next_offset = offset + instr_size(instr);
+  switch (instr->type) {
+    case INSTR_MOVE: {
+      MoveInstr *mi = (MoveInstr*) instr;
+      if (last_in_block || mi->target.kind != ARG_SLOT) break;
+      fprintf(out, "  "); emit_slot(out, mi->target); fprintf(out, " = ");
+      emit_load(out, mi->source, INSTR_AT(MoveInstr, offset), "source");
+      fprintf(out, ";\n");
+      return;
+    }
+    case INSTR_TEST: {
+      TestInstr *ti = (TestInstr*) instr;
+      if (last_in_block || ti->target.kind != ARG_SLOT) break;
+      fprintf(out, "  "); emit_slot(out, ti->target); fprintf(out, " = BOOL2VAL(value_is_truthy(");
+      emit_load(out, ti->value, INSTR_AT(TestInstr, offset), "value");
+      fprintf(out, "));\n");
+      return;
+    }
+    case INSTR_PHI: {
+      PhiInstr *phi = (PhiInstr*) instr;
+      if (last_in_block || phi->target.kind != ARG_SLOT) break;
+      fprintf(out, "  "); emit_slot(out, phi->target); fprintf(out, " = (frame->prev_block == %i) ? ", phi->block1);
+      emit_load(out, phi->arg1, INSTR_AT(PhiInstr, offset), "arg1");
+      fprintf(out, " : ");
+      emit_load(out, phi->arg2, INSTR_AT(PhiInstr, offset), "arg2");
+      fprintf(out, ";\n");
+      return;
+    }
+    case INSTR_ACCESS_STRING_KEY: {
+      AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr;
+      if (last_in_block || aski->target.kind != ARG_SLOT) break;
+      fprintf(out, "  found = false;\n");
+      fprintf(out, "  val = object_lookup_p(closest_obj(state, ");
+      emit_load(out, aski->obj, INSTR_AT(AccessStringKeyInstr, offset), "obj");
+      fprintf(out, "), &((AccessStringKeyInstr*) (instrs + %i))->key, &found);\n", offset);
+      fprintf(out, "  if (LIKELY(found)) "); emit_slot(out, aski->target); fprintf(out, " = val;\n");
+      fprintf(out, "  else {\n");
+      emit_fallback(out, offset, next_offset, "    ");
+      fprintf(out, "  }\n");
+      return;
+    }
+    case INSTR_CALL_FUNCTION_DIRECT: {
+      CallFunctionDirectInstr *cfdi = (CallFunctionDirectInstr*) instr;
+      if (last_in_block || cfdi->fast) break;
+      fprintf(out, "  state->instr = (Instr*) (instrs + %i);\n", offset);
+      fprintf(out, "  ((CallFunctionDirectInstr*) (instrs + %i))->fn(state, &((CallFunctionDirectInstr*) (instrs + %i))->info);\n",
+              offset, offset);
+      fprintf(out, "  if (UNLIKELY(state->runstate != VM_RUNNING)) return (FnWrap) { vm_halt };\n");
+      return;
+    }
+    case INSTR_BR: {
+      BranchInstr *br = (BranchInstr*) instr;
+      if (!fn->phi_free) fprintf(out, "  frame->prev_block = frame->block;\n");
+      emit_branch(out, fn, blk, br->blk, "  ");
+      return;
+    }
+    case INSTR_TESTBR: {
+      TestBranchInstr *tbr = (TestBranchInstr*) instr;
+      if (!fn->phi_free) fprintf(out, "  frame->prev_block = frame->block;\n");
+      if (tbr->test.kind == ARG_VALUE) {
+        emit_branch(out, fn, blk, tbr->test.value->b ? tbr->true_blk : tbr->false_blk, "  ");
+        return;
+      }
+      fprintf(out, "  if (");
+      emit_load(out, tbr->test, INSTR_AT(TestBranchInstr, offset), "test");
+      fprintf(out, ".b) {\n");
+      emit_branch(out, fn, blk, tbr->true_blk, "    ");
+      fprintf(out, "  } else {\n");
+      emit_branch(out, fn, blk, tbr->false_blk, "    ");
+      fprintf(out, "  }\n");
+      return;
+    }
+    default:
+      break;
+  }
+  // return, and anything we don't have a direct translation for
+  if (last_in_block) emit_exit(out, offset);
+  else emit_fallback(out, offset, next_offset, "  ");
+}
+
+// the function body, without its name, so it can be hashed
+static void emit_fn_body(FILE *out, UserFunction *fn) {
+  bool *targeted = calloc(fn->body.blocks_len, sizeof(bool));
+  for (int i = 0; i < fn->body.blocks_len; i++) {
+    Instr *instr = BLOCK_START(fn, i), *instr_end = BLOCK_END(fn, i);
+    while (instr != instr_end) {
+      // fused instrs only save dispatches, which we don't have; emit the parts
+      if (instr->type == INSTR_FUSED) instr = FUSED_PARTS(instr);
+      if (instr->type == INSTR_BR) {
+        int to_blk = ((BranchInstr*) instr)->blk;
+        if (!falls_through(i, to_blk)) targeted[to_blk] = true;
+      }
+      if (instr->type == INSTR_TESTBR) {
+        TestBranchInstr *tbr = (TestBranchInstr*) instr;
+        if (!falls_through(i, tbr->true_blk)) targeted[tbr->true_blk] = true;
+        if (!falls_through(i, tbr->false_blk)) targeted[tbr->false_blk] = true;
+      }
+      instr = (Instr*) ((char*) instr + instr_size(instr));
+    }
+  }
+
+  fprintf(out, "{\n");
+  fprintf(out, "  Callframe * __restrict__ frame = state->frame;\n");
+  fprintf(out, "  char *instrs = (char*) frame->uf->body.instrs_ptr;\n");
+  fprintf(out, "  FnWrap next; Value val; bool found;\n");
+  fprintf(out, "  (void) next; (void) val; (void) found;\n");
+  for (int i = 0; i < fn->body.blocks_len; i++) {
+    if (targeted[i]) fprintf(out, "blk_%i:\n", i);
+    Instr *instr = BLOCK_START(fn, i), *instr_end = BLOCK_END(fn, i);
+    while (instr != instr_end) {
+      if (instr->type == INSTR_FUSED) instr = FUSED_PARTS(instr);
+      Instr *next_instr = (Instr*) ((char*) instr + instr_size(instr));
+      emit_instr(out, fn, i, instr, next_instr == instr_end);
+      instr = next_instr;
+    }
+  }
+  fprintf(out, "}\n");
+  free(targeted);
+}
+
+// FNV-1a of the generated code: if that's unchanged, so are the offsets and constants it relies on
+static uint64_t fn_hash(UserFunction *fn) {
+  if (!fn->resolved) vm_resolve(fn);
+  char *text = NULL; size_t text_len = 0;
+  FILE *out = open_memstream(&text, &text_len);
+  emit_fn_body(out, fn);
+  fclose(out);
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < text_len; i++) {
+    hash = (hash ^ (unsigned char) text[i]) * 1099511628211ULL;
+  }
+  free(text);
+  return hash;
+}
+
+static void attach(UserFunction *fn) {
+  if (!aot_registry || fn->opt_jit_fn) return;
+  uint64_t hash = fn_hash(fn);
+  for (AotRegistry *entry = aot_registry; entry; entry = entry->next) {
+    for (int i = 0; i < entry->module->functions_len; i++) {
+      if (entry->module->functions[i].hash == hash) {
+        fn->opt_jit_fn = entry->module->functions[i].fn;
+        return;
+      }
+    }
+  }
+}
+
+void aot_record_functions() {
+  aot_recording = true;
+}
+
+void aot_function_optimized(UserFunction *fn) {
+  if (aot_recording) add_function(fn, &aot_recorded_ptr, &aot_recorded_len);
+  attach(fn);
+}
+
+void aot_emit_module(VMState *state, UserFunction *module, const char *filename,
+                     const char *source, size_t source_len, FILE *out)
+{
+  (void) state;
+  // the module body runs once, and is left to the interpreter
+  UserFunction **fns_ptr = NULL; int fns_len = 0;
+  collect_closures(module, &fns_ptr, &fns_len);
+  for (int i = 0; i < aot_recorded_len; i++) {
+    add_function(aot_recorded_ptr[i], &fns_ptr, &fns_len);
+  }
+
+  fprintf(out, "// generated by jerboa --emit-c from %s, do not edit\n", filename);
+  fprintf(out, "// build with: cc -shared -fPIC -O2 -std=c11 -D_GNU_SOURCE -I<jerboa>/src -I<jerboa>/rdparse <this file> -o <module>.so\n");
+  fprintf(out, "// then require(\"<module>.so\") in place of the source.\n");
+  fprintf(out, "#include \"object.h\"\n");
+  fprintf(out, "#include \"vm/aot.h\"\n\n");
+
+  uint64_t *hashes_ptr = malloc(sizeof(uint64_t) * fns_len);
+  int emitted = 0;
+  for (int i = 0; i < fns_len; i++) {
+    uint64_t hash = fn_hash(fns_ptr[i]);
+    bool duplicate = false;
+    for (int k = 0; k < emitted; k++) if (hashes_ptr[k] == hash) duplicate = true;
+    if (duplicate) continue;
+    hashes_ptr[emitted] = hash;
+    UserFunction *fn = fns_ptr[i];
+    fprintf(out, "// %s%s\n", fn->name ? fn->name : "(anonymous)", fn->optimized ? ", optimized at runtime" : "");
+    fprintf(out, "static FnWrap aot_fn_%i(VMState *state) FAST_FN;\n", emitted);
+    fprintf(out, "static FnWrap aot_fn_%i(VMState *state) ", emitted);
+    emit_fn_body(out, fn);
+    fprintf(out, "\n");
+    emitted ++;
+  }
+
+  fprintf(out, "static const AotFunction aot_functions[] = {\n");
+  for (int i = 0; i < emitted; i++) {
+    fprintf(out, "  { aot_fn_%i, 0x%016llxULL },\n", i, (unsigned long long) hashes_ptr[i]);
+  }
+  fprintf(out, "};\n\n");
+
+  // as a byte array, because string literals have a length limit
+  fprintf(out, "static const char aot_source[] = {");
+  for (size_t i = 0; i < source_len; i++) {
+    if (i % 16 == 0) fprintf(out, "\n ");
+    fprintf(out, " %i,", (unsigned char) source[i]);
+  }
+  fprintf(out, "\n  0\n};\n\n");
+
+  fprintf(out, "const AotModule jerboa_aot_module = { AOT_ABI, \"");
+  for (const char *ch = filename; *ch; ch++) {
+    if (*ch == '"' || *ch == '\\') fprintf(out, "\\%c", *ch);
+    else fprintf(out, "%c", *ch);
+  }
+  fprintf(out, "\", aot_source, %i, aot_functions };\n", emitted);
+  free(hashes_ptr);
+  free(fns_ptr);
+}
+
+UserFunction *aot_load_module(VMState *state, const char *filename) {
+  void *handle = dlopen(filename, RTLD_LAZY);
+  VM_ASSERT(handle, "cannot load compiled module: %s", dlerror()) NULL;
+  const AotModule *aot = dlsym(handle, "jerboa_aot_module");
+  VM_ASSERT(aot, "'%s' is not a compiled jerboa module", filename) NULL;
+  int abi[] = AOT_ABI;
+  VM_ASSERT(memcmp(abi, aot->abi, sizeof(abi)) == 0, "'%s' was compiled for a different build of jerboa", filename) NULL;
+
+  AotRegistry *entry = malloc(sizeof(AotRegistry));
+  *entry = (AotRegistry) { .module = aot, .next = aot_registry };
+  aot_registry = entry;
+
+  int source_len = strlen(aot->source);
+  char *text = malloc(source_len + 1);
+  memcpy(text, aot->source, source_len + 1);
+  register_file((TextRange) { .start = text, .end = text + source_len }, my_asprintf("%s", aot->filename), 0, 0);
+
+  UserFunction *module;
+  char *cur = text;
+  ParseResult res = parse_module(&cur, &module);
+  VM_ASSERT(res == PARSE_OK, "parsing the source of '%s' failed!", filename) NULL;
+
+  // same as jerboa.c does for the main module
+  vm_resolve(module);
+  module = optimize_runtime(state, module, state->root);
+  vm_resolve_functions(module);
+
+  UserFunction **fns_ptr = NULL; int fns_len = 0;
+  collect_closures(module, &fns_ptr, &fns_len);
+  for (int i = 0; i < fns_len; i++) attach(fns_ptr[i]);
+  free(fns_ptr);
+  return module;
+}
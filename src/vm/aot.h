@@ -0,0 +1,42 @@
+#ifndef JERBOA_VM_AOT_H
+#define JERBOA_VM_AOT_H
+
+// ahead-of-time compilation of modules to C (jerboa --emit-c out.c script.jb [arguments])
+// the script is run once as usual, then every function it contains, plus every function
+// optimize_runtime produced along the way, is written out as a C function.
+// the generated file is built into a shared object that require() can load in place of the source.
+// it carries the module source, which is parsed and optimized as usual on load; whenever a
+// function's code matches a compiled one (by hash), that is attached as its opt_jit_fn.
+// so closures stay ordinary UserFunctions, and anything that doesn't match is just interpreted.
+
+#include "core.h"
+
+// compared on load: the .so must have been built against the same struct layouts
+#define AOT_ABI { (int) sizeof(Callframe), (int) sizeof(Arg), (int) sizeof(WriteArg), (int) sizeof(Instr), (int) INSTR_LAST }
+#define AOT_ABI_LEN 5
+
+typedef struct {
+  VMInstrFn fn;
+  uint64_t hash; // of the generated code
+} AotFunction;
+
+typedef struct {
+  int abi[AOT_ABI_LEN];
+  const char *filename, *source;
+  int functions_len;
+  const AotFunction *functions;
+} AotModule;
+
+// remember functions from optimize_runtime, for aot_emit_module
+void aot_record_functions();
+
+// call when a function has been runtime optimized
+void aot_function_optimized(UserFunction *fn);
+
+void aot_emit_module(VMState *state, UserFunction *module, const char *filename,
+                     const char *source, size_t source_len, FILE *out);
+
+// errors and returns NULL if the file is not a usable compiled module
+UserFunction *aot_load_module(VMState *state, const char *filename);
+
+#endif
@@ -38,7 +38,10 @@ int new_block(FunctionBuilder *builder) {
   FunctionBody *body = &builder->body;
   int offset = (char*) body->instrs_ptr_end - (char*) body->instrs_ptr;
   body->blocks_len ++;
-  body->blocks_ptr = realloc(body->blocks_ptr, body->blocks_len * sizeof(InstrBlock));
+  if (body->blocks_len > builder->blocks_cap) {
+    builder->blocks_cap = builder->blocks_cap ? builder->blocks_cap * 2 : 8;
+    body->blocks_ptr = realloc(body->blocks_ptr, builder->blocks_cap * sizeof(InstrBlock));
+  }
   body->blocks_ptr[body->blocks_len - 1] = (InstrBlock){offset, 0};
   builder->block_terminated = false;
   return body->blocks_len - 1;
@@ -53,10 +56,40 @@ void terminate(FunctionBuilder *builder) {
   addinstr_return(builder, (Slot) {0});
 }
 
-FileRange **instr_belongs_to_p(FunctionBody *body, Instr *instr) {
+RangeRun *instr_range_run(FunctionBody *body, Instr *instr) {
   int offset = (char*) instr - (char*) body->instrs_ptr;
   assert(offset >= 0 && offset < (char*) body->instrs_ptr_end - (char*) body->instrs_ptr);
-  return (FileRange**)((char*) body->ranges_ptr + offset);
+  assert(body->ranges_len > 0 && body->ranges_ptr[0].offset == 0);
+  // last run that starts at or before offset
+  int lo = 0, hi = body->ranges_len - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (body->ranges_ptr[mid].offset <= offset) lo = mid;
+    else hi = mid - 1;
+  }
+  return &body->ranges_ptr[lo];
+}
+
+static void add_range_run(FunctionBuilder *builder, int offset, FileRange *range) {
+  FunctionBody *body = &builder->body;
+  if (body->ranges_len) {
+    RangeRun *last = &body->ranges_ptr[body->ranges_len - 1];
+    assert(offset >= last->offset);
+    if (last->range == range) return;
+    if (last->offset == offset) { // nothing was added under it
+      last->range = range;
+      return;
+    }
+  }
+  if (body->ranges_len == builder->ranges_cap) {
+    builder->ranges_cap = builder->ranges_cap ? builder->ranges_cap * 2 : 16;
+    body->ranges_ptr = realloc(body->ranges_ptr, builder->ranges_cap * sizeof(RangeRun));
+  }
+  body->ranges_ptr[body->ranges_len++] = (RangeRun) { offset, range };
+}
+
+void set_range_from(FunctionBuilder *builder, Instr *instr, FileRange *range) {
+  add_range_run(builder, (char*) instr - (char*) builder->body.instrs_ptr, range);
 }
 
 void addinstr(FunctionBuilder *builder, int size, Instr *instr) {
@@ -66,15 +99,18 @@ void addinstr(FunctionBuilder *builder, int size, Instr *instr) {
   InstrBlock *block = &body->blocks_ptr[body->blocks_len - 1];
   int current_len = (char*) body->instrs_ptr_end - (char*) body->instrs_ptr;
   int new_len = current_len + size;
-  body->instrs_ptr = realloc(body->instrs_ptr, new_len);
+  if (new_len > builder->instrs_cap) {
+    int new_cap = builder->instrs_cap ? builder->instrs_cap * 2 : 256;
+    while (new_cap < new_len) new_cap *= 2;
+    builder->instrs_cap = new_cap;
+    body->instrs_ptr = realloc(body->instrs_ptr, new_cap);
+  }
   body->instrs_ptr_end = (Instr*) ((char*) body->instrs_ptr + new_len);
   block->size += size;
   Instr *new_instr = (Instr*) ((char*) body->instrs_ptr + current_len);
   memcpy((void*) new_instr, instr, size);
 
-  int new_len_ranges = current_len + sizeof(FileRange*);
-  body->ranges_ptr = realloc(body->ranges_ptr, new_len_ranges);
-  *instr_belongs_to_p(body, new_instr) = builder->current_range;
+  add_range_run(builder, current_len, builder->current_range);
 
   if (instr->type == INSTR_BR || instr->type == INSTR_TESTBR || instr->type == INSTR_RETURN) {
     builder->block_terminated = true;
@@ -83,9 +119,10 @@ void addinstr(FunctionBuilder *builder, int size, Instr *instr) {
 
 #include <stdio.h>
 void addinstr_like(FunctionBuilder *builder, FunctionBody *body, Instr *basis, int size, Instr *instr) {
-  use_range_start(builder, *instr_belongs_to_p(body, basis));
+  FileRange *range = instr_belongs_to(body, basis);
+  use_range_start(builder, range);
   addinstr(builder, size, instr);
-  use_range_end(builder, *instr_belongs_to_p(body, basis));
+  use_range_end(builder, range);
 }
 
 static int offset_to_instr_about_to_be_added(FunctionBuilder *builder, char *instr, char *ptr) {
@@ -268,6 +305,7 @@ Slot addinstr_call(FunctionBuilder *builder, Slot fn, Slot this_slot, Slot *args
   CallInstr *instr = alloca(size);
   instr->base.type = INSTR_CALL;
   instr->size = size;
+  instr->tail = false;
   instr->info.fn = (Arg) { .kind = ARG_SLOT, .slot = fn };
   instr->info.this_arg = (Arg) { .kind = ARG_SLOT, .slot = this_slot };
   instr->info.args_len = args_len;
@@ -418,6 +456,17 @@ char *loop_contbrk(FunctionBuilder *builder, char *name, bool is_break) {
 UserFunction *build_function(FunctionBuilder *builder) {
   assert(builder->block_terminated);
   if (builder->body.blocks_len == 0) { fprintf(stderr, "Built an invalid function!\n"); abort(); }
+  // trim the builder's slack
+  FunctionBody *body = &builder->body;
+  int size = (char*) body->instrs_ptr_end - (char*) body->instrs_ptr;
+  body->instrs_ptr = realloc(body->instrs_ptr, size);
+  body->instrs_ptr_end = (Instr*) ((char*) body->instrs_ptr + size);
+  body->ranges_ptr = realloc(body->ranges_ptr, body->ranges_len * sizeof(RangeRun));
+  body->blocks_ptr = realloc(body->blocks_ptr, body->blocks_len * sizeof(InstrBlock));
+  builder->instrs_cap = size;
+  builder->blocks_cap = body->blocks_len;
+  builder->ranges_cap = body->ranges_len;
+
   UserFunction *fn = malloc(sizeof(UserFunction));
   fn->arity = builder->arglist_len;
   fn->variadic_tail = builder->variadic_tail;
@@ -427,23 +476,24 @@ UserFunction *build_function(FunctionBuilder *builder) {
   fn->body = builder->body;
   fn->is_method = false;
   fn->non_ssa = false;
+  fn->phi_free = false;
   fn->optimized = false;
   fn->resolved = false;
   fn->num_optimized = 0;
   fn->proposed_jit_fn = fn->opt_jit_fn = NULL;
+  fn->analysis = NULL;
+  fn->specializations = NULL;
+  fn->lazy_text = NULL;
   return fn;
 }
 
 static size_t ranges_offset = 0;
 void finalize(UserFunction *uf) {
-  size_t ranges_offset_new = ranges_offset;
-
-  uf->body.function_range_id = ranges_offset_new;
-  ranges_offset_new += 4;
-  size_t size = (char*) uf->body.instrs_ptr_end - (char*) uf->body.instrs_ptr;
-  uf->body.ranges_base = ranges_offset_new;
-  ranges_offset_new += size;
+  size_t size = 4 + uf->body.ranges_len;
+  // atomic, since prefetched modules are parsed on several threads
+  size_t ranges_offset_old = __sync_fetch_and_add(&ranges_offset, size);
+  if (ranges_offset_old + size < ranges_offset_old) abort(); // check for overflow
 
-  if (ranges_offset_new < ranges_offset) abort(); // check for overflow
-  ranges_offset = ranges_offset_new;
+  uf->body.function_range_id = ranges_offset_old;
+  uf->body.ranges_base = ranges_offset_old + 4;
 }
@@ -37,6 +37,8 @@ typedef struct {
   ContextHints hints; // used for internal pattern-based hacks, like ["foo"]=function being tagged as foo
 
   FunctionBody body;
+  // allocated sizes of body.instrs_ptr (bytes), body.blocks_ptr and body.ranges_ptr; grown geometrically, trimmed by build_function
+  int instrs_cap, blocks_cap, ranges_cap;
 } FunctionBuilder;
 
 LoopRecord *open_loop(FunctionBuilder *builder, char *name);
@@ -65,6 +67,10 @@ void addinstr(FunctionBuilder *builder, int size, Instr *instr);
 
 void addinstr_like(FunctionBuilder *builder, FunctionBody *body, Instr *basis, int size, Instr *instr);
 
+// instrs from instr on belong to range; instr must not be before the last instr given a range.
+// for parts of an instr, like those of INSTR_FUSED
+void set_range_from(FunctionBuilder *builder, Instr *instr, FileRange *range);
+
 void set_int_var(FunctionBuilder *builder, int offset, int value);
 
 Slot addinstr_get_root(FunctionBuilder *builder);
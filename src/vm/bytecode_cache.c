@@ -0,0 +1,495 @@
+#include "vm/bytecode_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <pthread.h>
+#endif
+
+#include "vm/builder.h"
+#include "vm/constants.h"
+#include "vm/vm.h"
+#include "hash.h"
+#include "util.h"
+
+#ifndef _WIN32
+
+#define CACHE_MAGIC 0x43424a4a // "JJBC"
+#define CACHE_FORMAT 4
+
+typedef struct {
+  uint32_t magic, format;
+  VMStamp vm;
+  uint64_t source_hash;
+  int source_len;
+} CacheHeader;
+
+void cache_sync_bytes(CacheStream *cs, void *ptr, size_t len) {
+  if (cs->writing) {
+    if (fwrite(ptr, 1, len, cs->out) != len) cs->failed = true;
+    return;
+  }
+  if (cs->failed || (size_t) (cs->end - cs->cur) < len) {
+    cs->failed = true;
+    memset(ptr, 0, len);
+    return;
+  }
+  memcpy(ptr, cs->cur, len);
+  cs->cur += len;
+}
+
+void cache_sync_int(CacheStream *cs, int *ip) {
+  cache_sync_bytes(cs, ip, sizeof(int));
+}
+
+void cache_sync_bool(CacheStream *cs, bool *bp) {
+  cache_sync_bytes(cs, bp, sizeof(bool));
+}
+
+void cache_sync_string(CacheStream *cs, char **str_p) {
+  int len = -1;
+  if (cs->writing && *str_p) len = strlen(*str_p);
+  cache_sync_int(cs, &len);
+  if (cs->writing) {
+    cache_sync_bytes(cs, *str_p, len > 0 ? len : 0);
+    return;
+  }
+  *str_p = NULL;
+  if (len < -1) cs->failed = true;
+  if (len < 0 || cs->failed) return;
+  char *str = malloc(len + 1);
+  cache_sync_bytes(cs, str, len);
+  str[len] = 0;
+  *str_p = str;
+}
+
+void cache_sync_key(CacheStream *cs, FastKey *key) {
+  char *str = (char*) key->key;
+  cache_sync_string(cs, &str);
+  if (cs->writing) return;
+  if (!str) {
+    cs->failed = true;
+    return;
+  }
+  // interning hands out different hashes every run
+  *key = prepare_key(str, strlen(str));
+  free(str);
+}
+
+static void sync_constant(CacheStream *cs, Value **value_p) {
+  Value value = cs->writing ? **value_p : VNULL;
+  // the parser only makes primitive constants; objects don't outlive the run
+  if (IS_OBJ(value)) cs->failed = true;
+  cache_sync_bytes(cs, &value, sizeof(Value));
+  if (cs->writing) return;
+  if (IS_OBJ(value)) cs->failed = true;
+  *value_p = constant_pool_add(IS_OBJ(value) ? VNULL : value);
+}
+
+// index in cs->sources_ptr of the file text points into; fails the stream if none
+static int source_of(CacheStream *cs, char *text) {
+  for (int i = 0; i < cs->sources_len; i++) {
+    TextRange range = cs->sources_ptr[i];
+    if (text >= range.start && text <= range.end) return i;
+  }
+  cs->failed = true; // not from any file we're storing
+  return -1;
+}
+
+// a pointer into one of the sources, or NULL
+static void sync_text_ptr(CacheStream *cs, char **text_p) {
+  int source = -1, from = 0;
+  if (cs->writing && *text_p) {
+    source = source_of(cs, *text_p);
+    if (source != -1) from = *text_p - cs->sources_ptr[source].start;
+  }
+  cache_sync_int(cs, &source);
+  cache_sync_int(cs, &from);
+  if (cs->writing) return;
+  *text_p = NULL;
+  if (source < -1 || source >= cs->sources_len) cs->failed = true;
+  if (source == -1 || cs->failed) return;
+  TextRange text = cs->sources_ptr[source];
+  if (from < 0 || from > text.end - text.start) cs->failed = true;
+  else *text_p = text.start + from;
+}
+
+static void sync_range(CacheStream *cs, FileRange **range_p) {
+  int source = -1, from = 0, len = 0;
+  if (cs->writing && *range_p) {
+    char *text_from = (*range_p)->text_from;
+    source = source_of(cs, text_from);
+    if (source != -1) from = text_from - cs->sources_ptr[source].start;
+    len = (*range_p)->text_len;
+  }
+  cache_sync_int(cs, &source);
+  cache_sync_int(cs, &from);
+  cache_sync_int(cs, &len);
+  if (cs->writing) return;
+  *range_p = NULL;
+  if (source < -1 || source >= cs->sources_len) cs->failed = true;
+  if (source == -1 || cs->failed) return;
+  TextRange text = cs->sources_ptr[source];
+  if (from < 0 || len < 0 || from + len > text.end - text.start) cs->failed = true;
+  if (cs->failed) return;
+  FileRange *last = cs->last_range;
+  if (!last || last->text_from != text.start + from || last->text_len != len) {
+    last = cs->last_range = alloc_and_record_start(text.start + from);
+    last->text_len = len;
+  }
+  *range_p = last;
+}
+
+void cache_sync_function_ref(CacheStream *cs, UserFunction **fn_p) {
+  int index = -1;
+  if (cs->writing) {
+    for (int i = 0; i < cs->fns_len; i++) if (cs->fns_ptr[i] == *fn_p) index = i;
+  }
+  cache_sync_int(cs, &index);
+  if (index < 0 || index >= cs->fns_len) {
+    cs->failed = true;
+    return;
+  }
+  *fn_p = cs->fns_ptr[index];
+}
+
+// every pointer in the instr; the raw bytes were synced already
+static void sync_instr(CacheStream *cs, Instr *instr_cur) {
+  if (!cs->writing) instr_cur->fn = NULL;
+  switch (instr_cur->type) {
+    case INSTR_ALLOC_STRING_OBJECT:
+      cache_sync_string(cs, &((AllocStringObjectInstr*) instr_cur)->value);
+      break;
+    case INSTR_ALLOC_CLOSURE_OBJECT:
+      cache_sync_function_ref(cs, &((AllocClosureObjectInstr*) instr_cur)->fn);
+      break;
+    case INSTR_ACCESS_STRING_KEY:
+      cache_sync_key(cs, &((AccessStringKeyInstr*) instr_cur)->key);
+      break;
+    case INSTR_ASSIGN_STRING_KEY:
+      cache_sync_key(cs, &((AssignStringKeyInstr*) instr_cur)->key);
+      break;
+    case INSTR_STRING_KEY_IN_OBJ:
+      cache_sync_key(cs, &((StringKeyInObjInstr*) instr_cur)->key);
+      break;
+    case INSTR_SET_CONSTRAINT_STRING_KEY:
+      cache_sync_key(cs, &((SetConstraintStringKeyInstr*) instr_cur)->key);
+      break;
+    case INSTR_DEFINE_REFSLOT:
+      cache_sync_key(cs, &((DefineRefslotInstr*) instr_cur)->key);
+      break;
+    case INSTR_MOVE:
+      cache_sync_string(cs, &((MoveInstr*) instr_cur)->opt_info);
+      break;
+    // only runtime passes make these, and they point into the heap
+    case INSTR_CALL_FUNCTION_DIRECT:
+    case INSTR_ALLOC_STATIC_OBJECT:
+    case INSTR_FUSED:
+      cs->failed = true;
+      return;
+    default:
+      break;
+  }
+  // constants, wherever an arg can hold one
+#define READ_SLOT(X) if ((X).kind == ARG_VALUE) sync_constant(cs, &(X).value);
+#define WRITE_SLOT(X) if ((X).kind == ARG_POINTER) cs->failed = true;
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+  switch (instr_cur->type) {
+    case INSTR_INVALID: { cs->failed = true;
+#include "vm/slots.txt"
+      CASE(INSTR_LAST, Instr) cs->failed = true;
+    } break;
+    default: cs->failed = true;
+  }
+#undef CASE
+#undef READ_SLOT
+#undef WRITE_SLOT
+}
+
+static void sync_function(CacheStream *cs, UserFunction *uf) {
+  FunctionBody *body = &uf->body;
+  cache_sync_string(cs, &uf->name);
+  cache_sync_int(cs, &uf->arity);
+  cache_sync_int(cs, &uf->slots);
+  cache_sync_int(cs, &uf->refslots);
+  cache_sync_bool(cs, &uf->is_method);
+  cache_sync_bool(cs, &uf->variadic_tail);
+  cache_sync_bool(cs, &uf->resolved);
+  sync_range(cs, &body->function_range);
+  sync_text_ptr(cs, &uf->lazy_text);
+  if (uf->lazy_text || cs->failed) return; // stub, the body is parsed from the source on its first call
+
+  cache_sync_int(cs, &body->blocks_len);
+  int size = (char*) body->instrs_ptr_end - (char*) body->instrs_ptr;
+  cache_sync_int(cs, &size);
+  if (!cs->writing) {
+    if (body->blocks_len <= 0 || size <= 0 || size > cs->end - cs->cur) cs->failed = true;
+    if (cs->failed) return;
+    body->blocks_ptr = malloc(sizeof(InstrBlock) * body->blocks_len);
+    body->instrs_ptr = malloc(size);
+    body->instrs_ptr_end = (Instr*) ((char*) body->instrs_ptr + size);
+  }
+  cache_sync_bytes(cs, body->blocks_ptr, sizeof(InstrBlock) * body->blocks_len);
+  cache_sync_bytes(cs, body->instrs_ptr, size);
+  if (cs->failed) return;
+
+  // blocks are laid out back to back
+  int offset = 0;
+  for (int i = 0; i < body->blocks_len; i++) {
+    if (body->blocks_ptr[i].offset != offset || body->blocks_ptr[i].size <= 0) cs->failed = true;
+    offset += body->blocks_ptr[i].size;
+  }
+  if (offset != size) cs->failed = true;
+
+  for (int i = 0; i < body->blocks_len && !cs->failed; i++) {
+    Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr != instr_end && !cs->failed) {
+      if (instr->type <= INSTR_INVALID || instr->type >= INSTR_LAST) {
+        cs->failed = true;
+        break;
+      }
+      int instr_len = instr_size(instr);
+      if (instr_len <= 0 || instr_len > (char*) instr_end - (char*) instr) {
+        cs->failed = true;
+        break;
+      }
+      sync_instr(cs, instr);
+      instr = (Instr*) ((char*) instr + instr_len);
+    }
+  }
+
+  cache_sync_int(cs, &body->ranges_len);
+  if (!cs->writing) {
+    if (body->ranges_len <= 0 || body->ranges_len > size) cs->failed = true;
+    if (cs->failed) return;
+    body->ranges_ptr = malloc(sizeof(RangeRun) * body->ranges_len);
+  }
+  for (int i = 0; i < body->ranges_len && !cs->failed; i++) {
+    RangeRun *run = &body->ranges_ptr[i];
+    cache_sync_int(cs, &run->offset);
+    sync_range(cs, &run->range);
+    if (cs->writing) continue;
+    int min_offset = i ? body->ranges_ptr[i - 1].offset + 1 : 0;
+    if (run->offset < min_offset || run->offset >= size || (i == 0 && run->offset != 0) || !run->range) cs->failed = true;
+  }
+}
+
+static void collect_functions(CacheStream *cs, UserFunction *uf) {
+  for (int i = 0; i < uf->body.blocks_len; i++) {
+    Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr != instr_end) {
+      if (instr->type == INSTR_ALLOC_CLOSURE_OBJECT) {
+        cache_collect_functions(cs, ((AllocClosureObjectInstr*) instr)->fn);
+      }
+      instr = (Instr*) ((char*) instr + instr_size(instr));
+    }
+  }
+  cs->fns_ptr = realloc(cs->fns_ptr, sizeof(UserFunction*) * ++cs->fns_len);
+  cs->fns_ptr[cs->fns_len - 1] = uf;
+}
+
+void cache_collect_functions(CacheStream *cs, UserFunction *uf) {
+  for (int k = 0; k < cs->fns_len; k++) if (cs->fns_ptr[k] == uf) return;
+  collect_functions(cs, uf);
+}
+
+void cache_sync_functions(CacheStream *cs) {
+  cache_sync_int(cs, &cs->fns_len);
+  if (cs->writing) {
+    for (int i = 0; i < cs->fns_len && !cs->failed; i++) sync_function(cs, cs->fns_ptr[i]);
+    return;
+  }
+  if (cs->fns_len < 0 || cs->fns_len > cs->end - cs->cur) cs->failed = true;
+  if (cs->failed) {
+    cs->fns_len = 0;
+    return;
+  }
+  cs->fns_ptr = calloc(cs->fns_len, sizeof(UserFunction*));
+  int loaded = 0;
+  for (; loaded < cs->fns_len && !cs->failed; loaded++) {
+    UserFunction *uf = cs->fns_ptr[loaded] = calloc(1, sizeof(UserFunction));
+    sync_function(cs, uf);
+  }
+  if (cs->failed) {
+    for (int i = 0; i < loaded; i++) free_function(cs->fns_ptr[i]);
+    cs->fns_len = 0;
+    return;
+  }
+  // the rest of the fields as build_function leaves them (calloc did the zeroes)
+  for (int i = 0; i < cs->fns_len; i++) {
+    finalize(cs->fns_ptr[i]);
+    // slots kept their offsets, but the instr fns were dropped
+    if (cs->fns_ptr[i]->resolved) vm_resolve_functions(cs->fns_ptr[i]);
+  }
+}
+
+static void sync_registered_functions(CacheStream *cs, RegisteredFunction **fns_p, int *len_p) {
+  cache_sync_int(cs, len_p);
+  if (!cs->writing) {
+    if (*len_p < 0 || *len_p > cs->end - cs->cur) cs->failed = true;
+    if (cs->failed) return;
+    *fns_p = malloc(sizeof(RegisteredFunction) * *len_p);
+  }
+  TextRange source = cs->sources_ptr[0];
+  for (int i = 0; i < *len_p; i++) {
+    RegisteredFunction *fn = &(*fns_p)[i];
+    int from = fn->range.start - source.start, len = fn->range.end - fn->range.start;
+    cache_sync_int(cs, &from);
+    cache_sync_int(cs, &len);
+    cache_sync_string(cs, &fn->name);
+    if (from < 0 || len < 0 || from + len > source.end - source.start) cs->failed = true;
+    if (cs->failed) return;
+    fn->range = (TextRange) { source.start + from, source.start + from + len };
+  }
+}
+
+static uint64_t source_hash(TextRange source) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char *ch = source.start; ch != source.end; ch++) {
+    hash = (hash ^ (unsigned char) *ch) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool make_vm_stamp(VMStamp *stamp) {
+  struct stat vm_stat;
+  if (stat("/proc/self/exe", &vm_stat) == -1) return false;
+  *stamp = (VMStamp) {
+    .size = vm_stat.st_size,
+    .mtime_sec = vm_stat.st_mtim.tv_sec,
+    .mtime_nsec = vm_stat.st_mtim.tv_nsec
+  };
+  return true;
+}
+
+static bool make_header(TextRange source, CacheHeader *header) {
+  memset(header, 0, sizeof(CacheHeader)); // padding too, it's compared bytewise
+  if (!make_vm_stamp(&header->vm)) return false;
+  header->magic = CACHE_MAGIC;
+  header->format = CACHE_FORMAT;
+  header->source_hash = source_hash(source);
+  header->source_len = source.end - source.start;
+  return true;
+}
+
+static char *cache_dir() {
+  char *dir = getenv("JERBOA_CACHE_DIR");
+  if (dir) return *dir ? my_asprintf("%s", dir) : NULL;
+  dir = getenv("XDG_CACHE_HOME");
+  if (dir) return my_asprintf("%s/jerboa", dir);
+  dir = getenv("HOME");
+  if (dir) return my_asprintf("%s/.cache/jerboa", dir);
+  return NULL;
+}
+
+static bool load_module(const char *path, TextRange source, CacheHeader *header, UserFunction **uf_p) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) return false;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1 || file_stat.st_size < (off_t) sizeof(CacheHeader)) {
+    close(fd);
+    return false;
+  }
+  char *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  CacheStream cs = {
+    .writing = false,
+    .cur = map + sizeof(CacheHeader), .end = map + file_stat.st_size,
+    .sources_ptr = &source, .sources_len = 1
+  };
+  // a hash collision would still have to match the length
+  if (memcmp(map, header, sizeof(CacheHeader)) != 0) cs.failed = true;
+
+  cache_sync_functions(&cs);
+  if (cs.fns_len == 0) cs.failed = true;
+  RegisteredFunction *registered_ptr = NULL; int registered_len = 0;
+  sync_registered_functions(&cs, &registered_ptr, &registered_len);
+  if (cs.cur != cs.end) cs.failed = true;
+  munmap(map, file_stat.st_size);
+
+  if (cs.failed) {
+    for (int i = 0; i < cs.fns_len; i++) free_function(cs.fns_ptr[i]);
+    free(cs.fns_ptr);
+    free(registered_ptr);
+    return false;
+  }
+  for (int i = 0; i < registered_len; i++) {
+    parse_register_function(registered_ptr[i].range, registered_ptr[i].name);
+  }
+  free(registered_ptr);
+  *uf_p = cs.fns_ptr[cs.fns_len - 1];
+  free(cs.fns_ptr);
+  return true;
+}
+
+static void save_module(const char *dir, const char *path, TextRange source, CacheHeader *header, UserFunction *module) {
+  char *parent = my_asprintf("%s", dir);
+  char *slash = strrchr(parent, '/');
+  if (slash && slash != parent) {
+    *slash = 0;
+    mkdir(parent, S_IRWXU); // ~/.cache may not be there yet
+  }
+  free(parent);
+  if (mkdir(dir, S_IRWXU) == -1 && errno != EEXIST) return;
+
+  // written under a temporary name and renamed into place, so readers never see half a file.
+  // the name is per thread, since prefetching may save two modules with the same text at once
+  char *tmp_path = my_asprintf("%s.%i.%lx.tmp", path, (int) getpid(), (unsigned long) pthread_self());
+  FILE *out = fopen(tmp_path, "wb");
+  if (!out) {
+    free(tmp_path);
+    return;
+  }
+  CacheStream cs = {
+    .writing = true, .out = out,
+    .sources_ptr = &source, .sources_len = 1
+  };
+  cache_sync_bytes(&cs, header, sizeof(CacheHeader));
+  cache_collect_functions(&cs, module);
+  cache_sync_functions(&cs);
+  RegisteredFunction *registered_ptr; int registered_len;
+  registered_ptr = parse_registered_functions(&registered_len);
+  sync_registered_functions(&cs, &registered_ptr, &registered_len);
+  free(cs.fns_ptr);
+
+  if (fclose(out) != 0) cs.failed = true;
+  if (cs.failed || rename(tmp_path, path) == -1) unlink(tmp_path);
+  free(tmp_path);
+}
+
+ParseResult parse_module_cached(TextRange source, UserFunction **uf_p) {
+  CacheHeader header;
+  char *dir = cache_dir();
+  char *path = NULL;
+  if (dir && make_header(source, &header)) {
+    path = my_asprintf("%s/%016llx.jbc", dir, (unsigned long long) header.source_hash);
+    if (load_module(path, source, &header, uf_p)) {
+      free(path);
+      free(dir);
+      return PARSE_OK;
+    }
+  }
+
+  char *text = source.start;
+  ParseResult res = parse_module(&text, uf_p);
+  if (res == PARSE_OK && path) save_module(dir, path, source, &header, *uf_p);
+  free(path);
+  free(dir);
+  return res;
+}
+
+#else
+
+ParseResult parse_module_cached(TextRange source, UserFunction **uf_p) {
+  char *text = source.start;
+  return parse_module(&text, uf_p);
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef JERBOA_VM_BYTECODE_CACHE_H
+#define JERBOA_VM_BYTECODE_CACHE_H
+
+// on-disk cache of parsed modules, so a script that was run before skips parse_module.
+// files live in $JERBOA_CACHE_DIR, else $XDG_CACHE_HOME/jerboa, else ~/.cache/jerboa;
+// setting JERBOA_CACHE_DIR to the empty string turns the cache off.
+// a file is named for the hash of the source and also records the jerboa executable
+// that wrote it, so editing the script or rebuilding jerboa both make it stale.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "core.h"
+#include "language.h"
+
+// like parse_module on source.start; source must already be registered (register_file),
+// since the cached ranges are offsets into it.
+ParseResult parse_module_cached(TextRange source, UserFunction **uf_p);
+
+// the serializer, shared with the heap snapshot (see vm/snapshot.h).
+// every cache_sync_ call either writes its field out or reads it back in,
+// so saving and loading are the same walk and can't get out of step.
+typedef struct {
+  bool writing;
+  FILE *out;
+  const char *cur, *end;
+  bool failed; // writing: can't be saved; reading: file is truncated or corrupt
+  TextRange *sources_ptr; int sources_len; // ranges are stored as offsets into one of these
+  FileRange *last_range; // consecutive ranges are often the same one
+  UserFunction **fns_ptr; int fns_len; // inner functions come before the functions that make closures of them
+} CacheStream;
+
+// the executable that wrote a file: any rebuild may change instr layouts, codegen or native function addresses
+typedef struct {
+  uint64_t size, mtime_sec, mtime_nsec;
+} VMStamp;
+
+bool make_vm_stamp(VMStamp *stamp);
+
+void cache_sync_bytes(CacheStream *cs, void *ptr, size_t len);
+
+void cache_sync_int(CacheStream *cs, int *ip);
+
+void cache_sync_bool(CacheStream *cs, bool *bp);
+
+void cache_sync_string(CacheStream *cs, char **str_p);
+
+// stored as the string, since interning hands out different hashes every run
+void cache_sync_key(CacheStream *cs, FastKey *key);
+
+// appends uf, and before it every function it makes closures of, to cs->fns_ptr unless already listed
+void cache_collect_functions(CacheStream *cs, UserFunction *uf);
+
+// the functions in cs->fns_ptr; reading allocates and finalizes them
+void cache_sync_functions(CacheStream *cs);
+
+// as its index in cs->fns_ptr
+void cache_sync_function_ref(CacheStream *cs, UserFunction **fn_p);
+
+#endif
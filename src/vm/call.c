@@ -1,10 +1,15 @@
 #include "vm/call.h"
 
 #include "vm/optimize.h"
+#include "vm/aot.h"
 #ifdef ENABLE_JIT
 #include "vm/myjit.h"
 #endif
+#ifdef ENABLE_STENCIL_JIT
+#include "vm/stencil_jit.h"
+#endif
 #include "vm/vm.h"
+#include "language.h"
 #include "util.h"
 #include "gc.h"
 
@@ -12,8 +17,12 @@ void vm_resolve(UserFunction *uf);
 
 void vm_resolve_functions(UserFunction *uf);
 
-void call_function(VMState *state, Object *context, UserFunction *fn, CallInfo *info) {
-  if (UNLIKELY(!fn->resolved)) vm_resolve(fn);
+// push the frame for fn and pass it the args; the body isn't run yet
+static void enter_function(VMState *state, Object *context, UserFunction *fn, CallInfo *info) {
+  if (UNLIKELY(!fn->resolved)) {
+    VM_ASSERT(!fn->lazy_text || parse_lazy_function(fn), "could not parse body of '%s'", fn->name ? fn->name : "lambda");
+    vm_resolve(fn);
+  }
   Callframe *callf = state->frame;
   vm_alloc_frame(state, fn->slots, fn->refslots);
   Callframe *cf = state->frame;
@@ -39,6 +48,11 @@ void call_function(VMState *state, Object *context, UserFunction *fn, CallInfo *
     resolve_slot_ref(cf->uf, &slot);
     write_slot(cf, slot, load_arg(callf, INFO_ARGS_PTR(info)[i]));
   }
+}
+
+void call_function(VMState *state, Object *context, UserFunction *fn, CallInfo *info) {
+  enter_function(state, context, fn, info);
+  if (state->runstate != VM_RUNNING) return;
   
   if (fn->opt_jit_fn) {
     fn->opt_jit_fn(state);
@@ -62,7 +76,7 @@ Value make_closure_fn(VMState *state, Object *context, UserFunction *fn) {
   return OBJ2VAL((Object*) obj);
 }
 
-static bool setup_closure_call(VMState *state, CallInfo *info, Object *fn_obj_n) {
+static bool setup_closure_call(VMState *state, CallInfo *info, Object *fn_obj_n, bool run_jit) {
   Object *closure_base = state->shared->vcache.closure_base;
   ClosureObject *cl_obj = (ClosureObject*) obj_instance_of(fn_obj_n, closure_base);
   
@@ -94,18 +108,28 @@ static bool setup_closure_call(VMState *state, CallInfo *info, Object *fn_obj_n)
     context->flags |= OBJ_CLOSED;
   }
   cl_obj->num_called ++;
-  if (UNLIKELY(cl_obj->num_called == 10)) {
+  if (UNLIKELY(cl_obj->num_called == 10 && !state->shared->settings.specialization_disabled)) {
     assert(!vmfun->optimized);
-    vmfun = cl_obj->vmfun = optimize_runtime(state, vmfun, context);
-    vm_resolve_functions(vmfun);
+    UserFunction *opt = find_specialization(state, vmfun, cl_obj->context);
+    if (!opt) {
+      opt = specialize_for_closure(state, vmfun, cl_obj->context, context);
+      vm_resolve_functions(opt);
+      aot_function_optimized(opt);
+    }
+    vmfun = cl_obj->vmfun = opt;
   }
-#ifdef ENABLE_JIT
-  if (UNLIKELY(cl_obj->num_called == 20 && state->shared->settings.jit_enabled)) {
+#if defined(ENABLE_JIT) || defined(ENABLE_STENCIL_JIT)
+  if (UNLIKELY(cl_obj->num_called == 20 && state->shared->settings.jit_enabled && !vmfun->opt_jit_fn)) {
     fprintf(stderr, "jit compiling '%s'\n", vmfun->name);
+#ifdef ENABLE_JIT
     myjit_flatten(vmfun);
+#else
+    stencil_jit_compile(vmfun);
+#endif
   }
 #endif
-  call_function(state, context, vmfun, info);
+  if (run_jit) call_function(state, context, vmfun, info);
+  else enter_function(state, context, vmfun, info);
   // gc_enable(state);
   return state->runstate != VM_ERRORED;
 }
@@ -133,7 +157,14 @@ bool setup_call(VMState *state, CallInfo *info, Instr *instr_after_call) {
       frame->instr_ptr = state->instr;
       frame->return_next_instr = instr_after_call;
     }
-    if (UNLIKELY(!setup_closure_call(state, info, fn_obj_n))) return false;
+    if (UNLIKELY(!setup_closure_call(state, info, fn_obj_n, true))) return false;
   }
   return true;
 }
+
+bool setup_tail_call(VMState *state, CallInfo *info, Instr *instr_after_call) {
+  Callframe *frame = state->frame;
+  frame->instr_ptr = state->instr;
+  frame->return_next_instr = instr_after_call;
+  return setup_closure_call(state, info, AS_OBJ(load_arg(frame, info->fn)), false);
+}
@@ -9,4 +9,8 @@ Value make_closure_fn(VMState *state, Object *context, UserFunction *fn);
 
 bool setup_call(VMState *state, CallInfo *info, Instr *instr_after_call);
 
+// like setup_call for a closure, but jitted code is left for the caller to enter,
+// so that a chain of tail calls doesn't nest on the C stack
+bool setup_tail_call(VMState *state, CallInfo *info, Instr *instr_after_call);
+
 #endif
@@ -155,6 +155,8 @@ void cfg_build(CFG *cfg, UserFunction *uf) {
   for (int i = 0; i < blocks_len; ++i) {
     Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
     while (instr != instr_end) {
+      // the branch may be part of a fused instr
+      if (instr->type == INSTR_FUSED) instr = FUSED_PARTS(instr);
       if (instr->type == INSTR_BR) {
         num_edges += 1;
         num_preds[((BranchInstr*)instr)->blk] += 1;
@@ -191,6 +193,7 @@ void cfg_build(CFG *cfg, UserFunction *uf) {
     bool exit_tracked = false;
     Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
     while (instr != instr_end) {
+      if (instr->type == INSTR_FUSED) instr = FUSED_PARTS(instr);
       if (instr->type == INSTR_BR) {
         exit_tracked = true;
         int blk = ((BranchInstr*)instr)->blk;
@@ -0,0 +1,107 @@
+#include "vm/constants.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#define CHUNK_LEN 1024
+
+typedef struct {
+  // chunks are never moved, so pointers into them stay valid
+  Value *chunk_ptr; int chunk_used;
+  // open addressing, power of two size
+  Value **table_ptr; int table_len; int table_stored;
+} ConstantPool;
+
+static ConstantPool pool = {0};
+
+// like the intern table, only locked while other threads may add constants too
+static bool pool_threaded = false;
+#ifndef _WIN32
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define POOL_LOCK() if (UNLIKELY(pool_threaded)) pthread_mutex_lock(&pool_lock)
+#define POOL_UNLOCK() if (UNLIKELY(pool_threaded)) pthread_mutex_unlock(&pool_lock)
+#else
+#define POOL_LOCK() (void) 0
+#define POOL_UNLOCK() (void) 0
+#endif
+
+void constant_pool_set_threaded(bool threaded) {
+  pool_threaded = threaded;
+}
+
+static bool value_identical(Value a, Value b) {
+  if (a.type != b.type) return false;
+  switch (a.type) {
+    case TYPE_NULL: return true;
+    case TYPE_INT: return a.i == b.i;
+    case TYPE_FLOAT: return memcmp(&a.f, &b.f, sizeof(float)) == 0;
+    case TYPE_BOOL: return a.b == b.b;
+    default: return a.obj == b.obj;
+  }
+}
+
+static uint32_t value_hash(Value value) {
+  uint64_t bits = 0;
+  switch (value.type) {
+    case TYPE_NULL: break;
+    case TYPE_INT: bits = (uint32_t) value.i; break;
+    case TYPE_FLOAT: memcpy(&bits, &value.f, sizeof(float)); break;
+    case TYPE_BOOL: bits = value.b; break;
+    default: bits = (uint64_t) (uintptr_t) value.obj; break;
+  }
+  uint64_t hash = (bits ^ ((uint64_t) value.type << 56)) * 0x9E3779B97F4A7C15ULL;
+  return hash >> 32;
+}
+
+static void table_insert(Value *constant) {
+  uint32_t mask = pool.table_len - 1;
+  for (uint32_t i = value_hash(*constant) & mask;; i = (i + 1) & mask) {
+    if (!pool.table_ptr[i]) {
+      pool.table_ptr[i] = constant;
+      pool.table_stored ++;
+      return;
+    }
+  }
+}
+
+static Value *constant_pool_add_locked(Value value) {
+  if (pool.table_len) {
+    uint32_t mask = pool.table_len - 1;
+    for (uint32_t i = value_hash(value) & mask; pool.table_ptr[i]; i = (i + 1) & mask) {
+      if (value_identical(*pool.table_ptr[i], value)) return pool.table_ptr[i];
+    }
+  }
+
+  if (!pool.chunk_ptr || pool.chunk_used == CHUNK_LEN) {
+    pool.chunk_ptr = malloc(sizeof(Value) * CHUNK_LEN);
+    pool.chunk_used = 0;
+  }
+  Value *constant = &pool.chunk_ptr[pool.chunk_used++];
+  *constant = value;
+
+  if ((pool.table_stored + 1) * 2 > pool.table_len) {
+    Value **old_table_ptr = pool.table_ptr;
+    int old_table_len = pool.table_len;
+    pool.table_len = old_table_len ? old_table_len * 2 : 256;
+    pool.table_ptr = calloc(sizeof(Value*), pool.table_len);
+    pool.table_stored = 0;
+    for (int i = 0; i < old_table_len; i++) {
+      if (old_table_ptr[i]) table_insert(old_table_ptr[i]);
+    }
+    free(old_table_ptr);
+  }
+  table_insert(constant);
+  return constant;
+}
+
+Value *constant_pool_add(Value value) {
+  POOL_LOCK();
+  Value *constant = constant_pool_add_locked(value);
+  POOL_UNLOCK();
+  return constant;
+}
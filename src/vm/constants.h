@@ -0,0 +1,15 @@
+#ifndef JERBOA_VM_CONSTANTS_H
+#define JERBOA_VM_CONSTANTS_H
+
+// the constant pool: the value of every ARG_VALUE arg in an instr lives in here.
+// keeps Arg pointer-sized instead of carrying a whole Value.
+// constants are deduplicated and never freed, so instrs can be copied between functions freely.
+
+#include "core.h"
+
+Value *constant_pool_add(Value value);
+
+// makes constant_pool_add safe to call from several threads at once, for as long as they may (see vm/prefetch.h)
+void constant_pool_set_threaded(bool threaded);
+
+#endif
@@ -0,0 +1,292 @@
+#include "vm/dataflow.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+Bitset bitset_alloc(int bits) {
+  Bitset set;
+  set.len = (bits + 63) / 64;
+  set.ptr = calloc(set.len ? set.len : 1, sizeof(uint64_t));
+  return set;
+}
+
+void bitset_free(Bitset set) {
+  free(set.ptr);
+}
+
+void bitset_copy(Bitset target, Bitset source) {
+  assert(target.len == source.len);
+  memcpy(target.ptr, source.ptr, sizeof(uint64_t) * target.len);
+}
+
+void bitset_set_range(Bitset set, int from, int to) {
+  while (from < to && (from & 63)) bitset_set(set, from++);
+  for (; to - from >= 64; from += 64) set.ptr[from >> 6] = ~0ULL;
+  while (from < to) bitset_set(set, from++);
+}
+
+bool bitset_union_into(Bitset target, Bitset source) {
+  assert(target.len == source.len);
+  uint64_t changed = 0;
+  for (int i = 0; i < target.len; i++) {
+    uint64_t word = target.ptr[i] | source.ptr[i];
+    changed |= word ^ target.ptr[i];
+    target.ptr[i] = word;
+  }
+  return changed != 0;
+}
+
+bool bitset_intersect_into(Bitset target, Bitset source) {
+  assert(target.len == source.len);
+  uint64_t changed = 0;
+  for (int i = 0; i < target.len; i++) {
+    uint64_t word = target.ptr[i] & source.ptr[i];
+    changed |= word ^ target.ptr[i];
+    target.ptr[i] = word;
+  }
+  return changed != 0;
+}
+
+bool bitset_subtract_from(Bitset target, Bitset source) {
+  assert(target.len == source.len);
+  uint64_t changed = 0;
+  for (int i = 0; i < target.len; i++) {
+    changed |= target.ptr[i] & source.ptr[i];
+    target.ptr[i] &= ~source.ptr[i];
+  }
+  return changed != 0;
+}
+
+int bitset_next(Bitset set, int from) {
+  int i = from >> 6;
+  if (i >= set.len) return -1;
+  uint64_t word = set.ptr[i] & (~0ULL << (from & 63));
+  while (!word) {
+    if (++i == set.len) return -1;
+    word = set.ptr[i];
+  }
+  return i * 64 + __builtin_ctzll(word);
+}
+
+void dataflow_init(DataflowProblem *problem, int blocks_len, int bits, DataflowDirection direction, DataflowMeet meet) {
+  problem->direction = direction;
+  problem->meet = meet;
+  problem->blocks_len = blocks_len;
+  problem->bits = bits;
+  problem->gen_ptr = malloc(sizeof(Bitset) * blocks_len);
+  problem->kill_ptr = malloc(sizeof(Bitset) * blocks_len);
+  problem->in_ptr = malloc(sizeof(Bitset) * blocks_len);
+  problem->out_ptr = malloc(sizeof(Bitset) * blocks_len);
+  for (int i = 0; i < blocks_len; i++) {
+    problem->gen_ptr[i] = bitset_alloc(bits);
+    problem->kill_ptr[i] = bitset_alloc(bits);
+    problem->in_ptr[i] = bitset_alloc(bits);
+    problem->out_ptr[i] = bitset_alloc(bits);
+  }
+}
+
+void dataflow_destroy(DataflowProblem *problem) {
+  for (int i = 0; i < problem->blocks_len; i++) {
+    bitset_free(problem->gen_ptr[i]);
+    bitset_free(problem->kill_ptr[i]);
+    bitset_free(problem->in_ptr[i]);
+    bitset_free(problem->out_ptr[i]);
+  }
+  free(problem->gen_ptr);
+  free(problem->kill_ptr);
+  free(problem->in_ptr);
+  free(problem->out_ptr);
+}
+
+void dataflow_solve(DataflowProblem *problem, CFG *cfg) {
+  int blocks_len = problem->blocks_len;
+  assert(cfg->nodes_len == blocks_len);
+  bool forward = problem->direction == DATAFLOW_FORWARD;
+
+  // visit in reverse postorder (forward) or postorder (backward), so that most blocks
+  // see their inputs settled before they're processed. blocks that are unreachable
+  // from the entry still get solved, after the rest.
+  RPost2Node rpost2node = cfg_get_reverse_postorder(cfg);
+  int *order = malloc(sizeof(int) * blocks_len);
+  bool *pending = calloc(blocks_len, sizeof(bool));
+  int order_len = 0;
+  for (int i = 0; i < rpost2node.len; i++) {
+    int blk = forward ? rpost2node.ptr[i] : rpost2node.ptr[rpost2node.len - 1 - i];
+    order[order_len++] = blk;
+    pending[blk] = true;
+  }
+  free(rpost2node.ptr);
+  for (int i = 0; i < blocks_len; i++) if (!pending[i]) {
+    order[order_len++] = i;
+    pending[i] = true;
+  }
+  assert(order_len == blocks_len);
+
+  // "meet" is the side joined from neighbors, "result" the side produced by the transfer
+  Bitset *meet_ptr = forward ? problem->in_ptr : problem->out_ptr;
+  Bitset *result_ptr = forward ? problem->out_ptr : problem->in_ptr;
+  if (problem->meet == DATAFLOW_INTERSECT) {
+    // optimistic start: everything holds until proven otherwise
+    for (int i = 0; i < blocks_len; i++) bitset_set_range(result_ptr[i], 0, problem->bits);
+  }
+
+  int num_pending = blocks_len;
+  while (num_pending) {
+    for (int i = 0; i < blocks_len; i++) {
+      int blk = order[i];
+      if (!pending[blk]) continue;
+      pending[blk] = false;
+      num_pending--;
+
+      CFGNode *node = &cfg->nodes_ptr[blk];
+      int from_len = forward ? node->pred_len : node->succ_len;
+      int *from_ptr = forward ? node->pred_ptr : node->succ_ptr;
+      Bitset meet = meet_ptr[blk];
+      // the entry block also has an edge from outside, where nothing holds
+      if (problem->meet == DATAFLOW_UNION || from_len == 0 || (forward && blk == 0)) {
+        memset(meet.ptr, 0, sizeof(uint64_t) * meet.len);
+        if (problem->meet == DATAFLOW_UNION) {
+          for (int k = 0; k < from_len; k++) bitset_union_into(meet, result_ptr[from_ptr[k]]);
+        }
+      } else {
+        bitset_copy(meet, result_ptr[from_ptr[0]]);
+        for (int k = 1; k < from_len; k++) bitset_intersect_into(meet, result_ptr[from_ptr[k]]);
+      }
+
+      Bitset gen = problem->gen_ptr[blk], kill = problem->kill_ptr[blk], result = result_ptr[blk];
+      uint64_t changed = 0;
+      for (int k = 0; k < result.len; k++) {
+        uint64_t word = gen.ptr[k] | (meet.ptr[k] & ~kill.ptr[k]);
+        changed |= word ^ result.ptr[k];
+        result.ptr[k] = word;
+      }
+      if (changed) {
+        int to_len = forward ? node->succ_len : node->pred_len;
+        int *to_ptr = forward ? node->succ_ptr : node->pred_ptr;
+        for (int k = 0; k < to_len; k++) if (!pending[to_ptr[k]]) {
+          pending[to_ptr[k]] = true;
+          num_pending++;
+        }
+      }
+    }
+  }
+  free(order);
+  free(pending);
+}
+
+void dataflow_slot_liveness(DataflowProblem *problem, CFG *cfg, UserFunction *uf) {
+  dataflow_init(problem, uf->body.blocks_len, uf->slots, DATAFLOW_BACKWARD, DATAFLOW_UNION);
+  for (int blk = 0; blk < uf->body.blocks_len; blk++) {
+    // gen: slots read before they're written in the block, kill: slots written
+    Bitset gen = problem->gen_ptr[blk], kill = problem->kill_ptr[blk];
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      // slots.txt lists reads before writes, so an instr reading its own target counts as a read
+      switch (instr_cur->type) {
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+#define CHKSLOT_READ(S) { int slot = slot_index_rt(uf, S); if (!bitset_test(kill, slot)) bitset_set(gen, slot); }
+#define CHKSLOT_WRITE(S) bitset_set(kill, slot_index_rt(uf, S));
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+#undef CHKSLOT_READ
+#undef CHKSLOT_WRITE
+#undef CASE
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+  dataflow_solve(problem, cfg);
+}
+
+void slot_defs_destroy(SlotDefs *defs) {
+  free(defs->instr_ptr);
+  free(defs->slot_ptr);
+  free(defs->slot_first_ptr);
+}
+
+static void slot_defs_build(SlotDefs *defs, UserFunction *uf) {
+  // count the writes per slot, then lay them out slot by slot
+  int *slot_first = calloc(uf->slots + 1, sizeof(int));
+  for (int blk = 0; blk < uf->body.blocks_len; blk++) {
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      switch (instr_cur->type) {
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+#define CHKSLOT_WRITE(S) slot_first[slot_index_rt(uf, S) + 1]++;
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+#undef CHKSLOT_WRITE
+#undef CASE
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+  for (int i = 0; i < uf->slots; i++) slot_first[i + 1] += slot_first[i];
+
+  defs->defs_len = slot_first[uf->slots];
+  defs->instr_ptr = malloc(sizeof(Instr*) * defs->defs_len);
+  defs->slot_ptr = malloc(sizeof(int) * defs->defs_len);
+  defs->slot_first_ptr = slot_first;
+
+  int *slot_cursor = malloc(sizeof(int) * uf->slots);
+  memcpy(slot_cursor, slot_first, sizeof(int) * uf->slots);
+  for (int blk = 0; blk < uf->body.blocks_len; blk++) {
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      switch (instr_cur->type) {
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+#define CHKSLOT_WRITE(S) { int slot = slot_index_rt(uf, S), def = slot_cursor[slot]++; \
+          defs->instr_ptr[def] = instr_cur; defs->slot_ptr[def] = slot; }
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+#undef CHKSLOT_WRITE
+#undef CASE
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+  free(slot_cursor);
+}
+
+void dataflow_reaching_defs(DataflowProblem *problem, SlotDefs *defs, CFG *cfg, UserFunction *uf) {
+  slot_defs_build(defs, uf);
+  dataflow_init(problem, uf->body.blocks_len, defs->defs_len, DATAFLOW_FORWARD, DATAFLOW_UNION);
+  // replay the numbering of slot_defs_build to find each write's def
+  int *slot_cursor = malloc(sizeof(int) * uf->slots);
+  memcpy(slot_cursor, defs->slot_first_ptr, sizeof(int) * uf->slots);
+  for (int blk = 0; blk < uf->body.blocks_len; blk++) {
+    // gen: the last write of each slot in the block, kill: every write of a slot written
+    Bitset gen = problem->gen_ptr[blk], kill = problem->kill_ptr[blk];
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      switch (instr_cur->type) {
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+#define CHKSLOT_WRITE(S) { int slot = slot_index_rt(uf, S), from = defs->slot_first_ptr[slot], to = defs->slot_first_ptr[slot + 1]; \
+          int def = slot_cursor[slot]++; \
+          for (int k = from; k < to; k++) bitset_clear(gen, k); \
+          bitset_set_range(kill, from, to); \
+          bitset_set(gen, def); }
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+#undef CHKSLOT_WRITE
+#undef CASE
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+  free(slot_cursor);
+  dataflow_solve(problem, cfg);
+}
@@ -0,0 +1,93 @@
+#ifndef JERBOA_VM_DATAFLOW_H
+#define JERBOA_VM_DATAFLOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vm/cfg.h"
+
+// dense bitset, sized at allocation
+typedef struct {
+  int len; // in words
+  uint64_t *ptr;
+} Bitset;
+
+Bitset bitset_alloc(int bits);
+
+void bitset_free(Bitset set);
+
+static inline void bitset_set(Bitset set, int bit) {
+  set.ptr[bit >> 6] |= 1ULL << (bit & 63);
+}
+
+static inline void bitset_clear(Bitset set, int bit) {
+  set.ptr[bit >> 6] &= ~(1ULL << (bit & 63));
+}
+
+static inline bool bitset_test(Bitset set, int bit) {
+  return (set.ptr[bit >> 6] >> (bit & 63)) & 1;
+}
+
+void bitset_copy(Bitset target, Bitset source);
+
+// set every bit in [from, to)
+void bitset_set_range(Bitset set, int from, int to);
+
+// target |= source; returns true if target changed
+bool bitset_union_into(Bitset target, Bitset source);
+
+// target &= source; returns true if target changed
+bool bitset_intersect_into(Bitset target, Bitset source);
+
+// target &= ~source; returns true if target changed
+bool bitset_subtract_from(Bitset target, Bitset source);
+
+// the first set bit at or after 'from', or -1
+// for (int i = bitset_next(set, 0); i != -1; i = bitset_next(set, i + 1))
+int bitset_next(Bitset set, int from);
+
+typedef enum {
+  DATAFLOW_FORWARD,
+  DATAFLOW_BACKWARD
+} DataflowDirection;
+
+typedef enum {
+  DATAFLOW_UNION, // "may" problems: liveness, reaching definitions
+  DATAFLOW_INTERSECT // "must" problems: available values
+} DataflowMeet;
+
+// a gen/kill problem over the blocks of a cfg
+// forward:  in = meet(out of preds), out = gen | (in & ~kill)
+// backward: out = meet(in of succs), in = gen | (out & ~kill)
+typedef struct {
+  DataflowDirection direction;
+  DataflowMeet meet;
+  int blocks_len, bits;
+  Bitset *gen_ptr, *kill_ptr; // filled in by the caller
+  Bitset *in_ptr, *out_ptr; // filled in by dataflow_solve
+} DataflowProblem;
+
+void dataflow_init(DataflowProblem *problem, int blocks_len, int bits, DataflowDirection direction, DataflowMeet meet);
+
+// iterate to a fixpoint with a worklist in reverse postorder (postorder for backward problems)
+void dataflow_solve(DataflowProblem *problem, CFG *cfg);
+
+void dataflow_destroy(DataflowProblem *problem);
+
+// backward/union over slot indices: slot is live on entry to/exit from a block
+void dataflow_slot_liveness(DataflowProblem *problem, CFG *cfg, UserFunction *uf);
+
+// every write of a slot, numbered so the writes of one slot are contiguous
+typedef struct {
+  int defs_len;
+  Instr **instr_ptr; // the writing instr
+  int *slot_ptr; // the slot written
+  int *slot_first_ptr; // defs of slot i are [slot_first_ptr[i], slot_first_ptr[i + 1])
+} SlotDefs;
+
+void slot_defs_destroy(SlotDefs *defs);
+
+// forward/union over SlotDefs numbering: definition reaches entry to/exit from a block
+void dataflow_reaching_defs(DataflowProblem *problem, SlotDefs *defs, CFG *cfg, UserFunction *uf);
+
+#endif
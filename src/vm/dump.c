@@ -137,7 +137,7 @@ void dump_instr(VMState *state, Instr **instr_p) {
     case INSTR_CALL:
     {
       CallInstr *ci = (CallInstr*) instr;
-      fprintf(stderr, "call: %s = %s . %s ( ",
+      fprintf(stderr, "%s: %s = %s . %s ( ", ci->tail ? "tail call" : "call",
               get_write_arg_info(ci->info.target), get_arg_info(state, ci->info.this_arg), get_arg_info(state, ci->info.fn));
       for (int i = 0; i < ci->info.args_len; ++i) {
         if (i) fprintf(stderr, ", ");
@@ -257,6 +257,22 @@ void dump_instr(VMState *state, Instr **instr_p) {
       *instr_p = (Instr*) ((char*) instr + instr_size(instr));
       break;
     }
+    case INSTR_ACCESS_ARRAY_INDEX:
+    {
+      AccessArrayIndexInstr *aaii = (AccessArrayIndexInstr*) instr;
+      fprintf(stderr, "access: %s = %s [ %s ] \t\t(opt: array index)\n",
+              get_write_arg_info(aaii->target), get_arg_info(state, aaii->obj), get_arg_info(state, aaii->key));
+      *instr_p = (Instr*) (aaii + 1);
+      break;
+    }
+    case INSTR_FUSED:
+    {
+      FusedInstr *fi = (FusedInstr*) instr;
+      fprintf(stderr, "fused (%i bytes):\n", fi->size);
+      // the parts are dumped as the following instrs
+      *instr_p = FUSED_PARTS(fi);
+      break;
+    }
     default:
       fprintf(stderr, "    unknown instruction: %i\n", instr->type);
       abort();
@@ -268,6 +284,10 @@ void dump_fn(VMState *state, UserFunction *fn) {
   UserFunction **other_fns_ptr = NULL; int other_fns_len = 0;
 
   FunctionBody *body = &fn->body;
+  if (fn->lazy_text) {
+    fprintf(stderr, "function %s (%i), not parsed yet\n", fn->name, fn->arity);
+    return;
+  }
   fprintf(stderr, "function %s (%i), %i slots, %i refslots [\n", fn->name, fn->arity, fn->slots, fn->refslots);
   for (int i = 0; i < body->blocks_len; ++i) {
     fprintf(stderr, "  block <%i> [\n", i);
@@ -289,3 +309,86 @@ void dump_fn(VMState *state, UserFunction *fn) {
   }
   free(other_fns_ptr);
 }
+
+static const char *instr_names[INSTR_LAST] = {
+  [INSTR_ALLOC_OBJECT] = "alloc_object",
+  [INSTR_ALLOC_INT_OBJECT] = "alloc_int_object",
+  [INSTR_ALLOC_BOOL_OBJECT] = "alloc_bool_object",
+  [INSTR_ALLOC_FLOAT_OBJECT] = "alloc_float_object",
+  [INSTR_ALLOC_ARRAY_OBJECT] = "alloc_array_object",
+  [INSTR_ALLOC_STRING_OBJECT] = "alloc_string_object",
+  [INSTR_ALLOC_CLOSURE_OBJECT] = "alloc_closure_object",
+  [INSTR_FREE_OBJECT] = "free_object",
+  [INSTR_CLOSE_OBJECT] = "close_object",
+  [INSTR_FREEZE_OBJECT] = "freeze_object",
+  [INSTR_ACCESS] = "access",
+  [INSTR_ASSIGN] = "assign",
+  [INSTR_KEY_IN_OBJ] = "key_in_obj",
+  [INSTR_IDENTICAL] = "identical",
+  [INSTR_INSTANCEOF] = "instanceof",
+  [INSTR_SET_CONSTRAINT] = "set_constraint",
+  [INSTR_CALL] = "call",
+  [INSTR_TEST] = "test",
+  [INSTR_RETURN] = "return",
+  [INSTR_BR] = "br",
+  [INSTR_TESTBR] = "testbr",
+  [INSTR_PHI] = "phi",
+  [INSTR_ACCESS_STRING_KEY] = "access_string_key",
+  [INSTR_ASSIGN_STRING_KEY] = "assign_string_key",
+  [INSTR_STRING_KEY_IN_OBJ] = "string_key_in_obj",
+  [INSTR_SET_CONSTRAINT_STRING_KEY] = "set_constraint_string_key",
+  [INSTR_DEFINE_REFSLOT] = "define_refslot",
+  [INSTR_MOVE] = "move",
+  [INSTR_CALL_FUNCTION_DIRECT] = "call_function_direct",
+  [INSTR_ALLOC_STATIC_OBJECT] = "alloc_static_object",
+  [INSTR_ACCESS_ARRAY_INDEX] = "access_array_index",
+  [INSTR_FUSED] = "fused",
+};
+
+static const char *get_instr_name(InstrType type) {
+  if (type < 0 || type >= INSTR_LAST || !instr_names[type]) return "?";
+  return instr_names[type];
+}
+
+typedef struct {
+  long long count;
+  int index;
+} OpcodeStatsRecord;
+
+static int opcode_stats_sort_fn(const void *a, const void *b) {
+  const OpcodeStatsRecord *rec_a = a, *rec_b = b;
+  if (rec_a->count > rec_b->count) return -1;
+  if (rec_a->count < rec_b->count) return 1;
+  return 0;
+}
+
+static void dump_opcode_counts(long long *counts, int len, int width, long long total) {
+  OpcodeStatsRecord *records = malloc(sizeof(OpcodeStatsRecord) * len);
+  for (int i = 0; i < len; i++) records[i] = (OpcodeStatsRecord) { .count = counts[i], .index = i };
+  qsort(records, len, sizeof(OpcodeStatsRecord), opcode_stats_sort_fn);
+  for (int i = 0; i < 20 && i < len && records[i].count; i++) {
+    fprintf(stderr, "  %12lli %5.1f%%  ", records[i].count, records[i].count * 100.0 / total);
+    int index = records[i].index, divisor = 1;
+    for (int k = 1; k < width; k++) divisor *= INSTR_LAST;
+    for (int k = 0; k < width; k++) {
+      fprintf(stderr, "%s%s", k ? " + " : "", get_instr_name((index / divisor) % INSTR_LAST));
+      divisor /= INSTR_LAST;
+    }
+    fprintf(stderr, "\n");
+  }
+  free(records);
+}
+
+void dump_opcode_stats(VMProfileState *profstate) {
+  if (!profstate->pair_counts) return;
+  long long total = 0;
+  for (int i = 0; i < INSTR_LAST * INSTR_LAST; i++) total += profstate->pair_counts[i];
+  if (!total) return;
+  fprintf(stderr, "top opcode pairs (of %lli):\n", total);
+  dump_opcode_counts(profstate->pair_counts, INSTR_LAST * INSTR_LAST, 2, total);
+  total = 0;
+  for (int i = 0; i < INSTR_LAST * INSTR_LAST * INSTR_LAST; i++) total += profstate->triple_counts[i];
+  if (!total) return;
+  fprintf(stderr, "top opcode triples (of %lli):\n", total);
+  dump_opcode_counts(profstate->triple_counts, INSTR_LAST * INSTR_LAST * INSTR_LAST, 3, total);
+}
@@ -7,4 +7,7 @@ void dump_instr(VMState *, Instr **instr);
 
 void dump_fn(VMState *, UserFunction *fn);
 
+// top pairs and triples of executed instrs, recorded with -ps
+void dump_opcode_stats(VMProfileState *profstate);
+
 #endif
@@ -9,7 +9,7 @@ char *get_arg_info(VMState *state, Arg arg) {
   if (arg.kind == ARG_SLOT) return my_asprintf("%%%i", arg.slot.index);
   if (arg.kind == ARG_REFSLOT) return my_asprintf("&%i", arg.refslot.index);
   assert(arg.kind == ARG_VALUE);
-  return get_val_info(state, arg.value);
+  return get_val_info(state, *arg.value);
 }
 
 char *get_write_arg_info(WriteArg warg) {
@@ -49,12 +49,14 @@ int instr_size(Instr *instr) {
     CASE(INSTR_SET_CONSTRAINT_STRING_KEY, SetConstraintStringKeyInstr);
     CASE(INSTR_DEFINE_REFSLOT, DefineRefslotInstr);
     CASE(INSTR_MOVE, MoveInstr);
+    CASE(INSTR_ACCESS_ARRAY_INDEX, AccessArrayIndexInstr);
 #undef CASE
     case INSTR_ALLOC_STATIC_OBJECT:
       return sizeof(AllocStaticObjectInstr)
       + sizeof(StaticFieldInfo) * ((AllocStaticObjectInstr*)instr)->tbl.entries_stored;
     case INSTR_CALL: return ((CallInstr*)instr)->size;
     case INSTR_CALL_FUNCTION_DIRECT: return ((CallFunctionDirectInstr*)instr)->size;
+    case INSTR_FUSED: return ((FusedInstr*)instr)->size;
     default: fprintf(stderr, "unknown instruction size for %i\n", instr->type); abort();
   }
 }
@@ -132,6 +132,7 @@ typedef struct {
 typedef struct {
   Instr base;
   int size; // faster than recomputing
+  bool tail; // result is returned right away; the callee takes over our frame (see mark_tail_calls)
   CallInfo info;
 } CallInstr;
 
@@ -151,6 +152,8 @@ typedef struct {
             // can be safely freed before this instr
             // (relevant for testbranch at the end of a loop)
   int true_blk, false_blk;
+  // how often each side was taken before the function was optimized; see layout_blocks_by_profile
+  unsigned int true_count, false_count;
 } TestBranchInstr;
 
 typedef struct {
@@ -168,6 +171,12 @@ typedef struct {
   WriteArg target;
 } AccessStringKeyInstr;
 
+typedef struct {
+  Instr base;
+  Arg obj, key; // key always holds an int
+  WriteArg target;
+} AccessArrayIndexInstr;
+
 typedef struct {
   Instr base;
   FastKey key;
@@ -235,4 +244,21 @@ typedef struct {
   CallInfo info; // must be last! has tail!
 } CallFunctionDirectInstr;
 
+typedef enum {
+  FUSED_TEST_TESTBR,
+  FUSED_ACCESS_STRING_KEY_CALL,
+  FUSED_ACCESS_STRING_KEY_2,
+  FUSED_MOVE_2,
+} FusedKind;
+
+// the fused instrs follow directly after, unchanged.
+// code that doesn't care about fusion can just step into them (see FUSED_PARTS).
+typedef struct {
+  Instr base;
+  int size; // including the parts
+  FusedKind kind;
+} FusedInstr;
+
+#define FUSED_PARTS(I) ((Instr*)((FusedInstr*)(I) + 1))
+
 #endif
@@ -0,0 +1,49 @@
+#ifndef OBJ_KIND
+#define OBJ_KIND aski->obj.kind
+#define OBJ_KIND_DEFINED
+#endif
+
+#ifndef TARGET_KIND
+#define TARGET_KIND aski->target.kind
+#define TARGET_KIND_DEFINED
+#endif
+
+#ifndef FN_NAME
+#define FN_NAME vm_instr_access_string_key
+#define FN_NAME_DEFINED
+#endif
+
+#include "core.h"
+#include "object.h"
+
+static FnWrap FN_NAME(VMState * __restrict__ state) FAST_FN;
+static FnWrap FN_NAME(VMState * __restrict__ state) {
+  AccessStringKeyInstr * __restrict__ aski = (AccessStringKeyInstr*) state->instr;
+
+  Object *obj = closest_obj(state, load_arg_specialized(state->frame, aski->obj, OBJ_KIND));
+
+  bool object_found = false;
+  Value result = object_lookup_p(obj, &aski->key, &object_found);
+
+  if (UNLIKELY(!object_found)) {
+    return vm_instr_access_string_key_index_fallback(state, aski, (Instr*)(aski + 1));
+  }
+  set_arg_specialized(state, aski->target, result, TARGET_KIND);
+  state->instr = (Instr*)(aski + 1);
+  STEP_VM;
+}
+
+#ifdef OBJ_KIND_DEFINED
+#undef OBJ_KIND_DEFINED
+#undef OBJ_KIND
+#endif
+
+#ifdef TARGET_KIND_DEFINED
+#undef TARGET_KIND_DEFINED
+#undef TARGET_KIND
+#endif
+
+#ifdef FN_NAME_DEFINED
+#undef FN_NAME_DEFINED
+#undef FN_NAME
+#endif
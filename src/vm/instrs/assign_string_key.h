@@ -0,0 +1,40 @@
+#ifndef OBJ_KIND
+#define OBJ_KIND aski->obj.kind
+#define OBJ_KIND_DEFINED
+#endif
+
+#ifndef VALUE_KIND
+#define VALUE_KIND aski->value.kind
+#define VALUE_KIND_DEFINED
+#endif
+
+#ifndef FN_NAME
+#define FN_NAME vm_instr_assign_string_key
+#define FN_NAME_DEFINED
+#endif
+
+#include "core.h"
+#include "object.h"
+
+static FnWrap FN_NAME(VMState * __restrict__ state) FAST_FN;
+static FnWrap FN_NAME(VMState * __restrict__ state) {
+  AssignStringKeyInstr * __restrict__ aski = (AssignStringKeyInstr*) state->instr;
+  Value obj_val = load_arg_specialized(state->frame, aski->obj, OBJ_KIND);
+  Value value = load_arg_specialized(state->frame, aski->value, VALUE_KIND);
+  return vm_assign_string_key(state, aski, obj_val, value);
+}
+
+#ifdef OBJ_KIND_DEFINED
+#undef OBJ_KIND_DEFINED
+#undef OBJ_KIND
+#endif
+
+#ifdef VALUE_KIND_DEFINED
+#undef VALUE_KIND_DEFINED
+#undef VALUE_KIND
+#endif
+
+#ifdef FN_NAME_DEFINED
+#undef FN_NAME_DEFINED
+#undef FN_NAME
+#endif
@@ -0,0 +1,41 @@
+#ifndef SOURCE_KIND
+#define SOURCE_KIND mi->source.kind
+#define SOURCE_KIND_DEFINED
+#endif
+
+#ifndef TARGET_KIND
+#define TARGET_KIND mi->target.kind
+#define TARGET_KIND_DEFINED
+#endif
+
+#ifndef FN_NAME
+#define FN_NAME vm_instr_move
+#define FN_NAME_DEFINED
+#endif
+
+#include "core.h"
+#include "object.h"
+
+static FnWrap FN_NAME(VMState * __restrict__ state) FAST_FN;
+static FnWrap FN_NAME(VMState * __restrict__ state) {
+  MoveInstr * __restrict__ mi = (MoveInstr*) state->instr;
+  Value value = load_arg_specialized(state->frame, mi->source, SOURCE_KIND);
+  set_arg_specialized(state, mi->target, value, TARGET_KIND);
+  state->instr = (Instr*)(mi + 1);
+  STEP_VM;
+}
+
+#ifdef SOURCE_KIND_DEFINED
+#undef SOURCE_KIND_DEFINED
+#undef SOURCE_KIND
+#endif
+
+#ifdef TARGET_KIND_DEFINED
+#undef TARGET_KIND_DEFINED
+#undef TARGET_KIND
+#endif
+
+#ifdef FN_NAME_DEFINED
+#undef FN_NAME_DEFINED
+#undef FN_NAME
+#endif
@@ -0,0 +1,57 @@
+#ifndef ARG1_KIND
+#define ARG1_KIND phi->arg1.kind
+#define ARG1_KIND_DEFINED
+#endif
+
+#ifndef ARG2_KIND
+#define ARG2_KIND phi->arg2.kind
+#define ARG2_KIND_DEFINED
+#endif
+
+#ifndef TARGET_KIND
+#define TARGET_KIND phi->target.kind
+#define TARGET_KIND_DEFINED
+#endif
+
+#ifndef FN_NAME
+#define FN_NAME vm_instr_phi
+#define FN_NAME_DEFINED
+#endif
+
+#include "core.h"
+#include "object.h"
+
+static FnWrap FN_NAME(VMState * __restrict__ state) FAST_FN;
+static FnWrap FN_NAME(VMState * __restrict__ state) {
+  PhiInstr * __restrict__ phi = (PhiInstr*) state->instr;
+  Callframe * __restrict__ frame = state->frame;
+  if (frame->prev_block == phi->block1) {
+    set_arg_specialized(state, phi->target, load_arg_specialized(frame, phi->arg1, ARG1_KIND), TARGET_KIND);
+  } else if (frame->prev_block == phi->block2) {
+    set_arg_specialized(state, phi->target, load_arg_specialized(frame, phi->arg2, ARG2_KIND), TARGET_KIND);
+  } else VM_ASSERT2(false, "phi block error: arrived here from block not in list: [%i, %i], but came from %i",
+                    phi->block1, phi->block2, frame->prev_block);
+
+  state->instr = (Instr*)(phi + 1);
+  STEP_VM;
+}
+
+#ifdef ARG1_KIND_DEFINED
+#undef ARG1_KIND_DEFINED
+#undef ARG1_KIND
+#endif
+
+#ifdef ARG2_KIND_DEFINED
+#undef ARG2_KIND_DEFINED
+#undef ARG2_KIND
+#endif
+
+#ifdef TARGET_KIND_DEFINED
+#undef TARGET_KIND_DEFINED
+#undef TARGET_KIND
+#endif
+
+#ifdef FN_NAME_DEFINED
+#undef FN_NAME_DEFINED
+#undef FN_NAME
+#endif
@@ -0,0 +1,43 @@
+// generates every Arg kind specialization of an instr template, plus a table to pick them from.
+// define before including:
+//   SPEC_TEMPLATE   the template header; it gets the kinds as SPEC_KIND0.. and its name as FN_NAME
+//   SPEC_NAME       base function name; variants are SPEC_NAME_<prefix><kind>_.., kind being s/r/v
+//   SPEC_PREFIX0..  one letter per operand, for the variant names
+//   SPEC_WRITE0..   1 if the operand is a WriteArg; those are only specialized for slot and refslot
+//   SPEC_OPERANDS   2 or 3
+//   SPEC_TABLE      name of the table, indexed [kind0][kind1]([kind2]); NULL for missing variants
+
+#ifndef SPEC_CAT
+#define SPEC_CAT_(A, B) A##B
+#define SPEC_CAT(A, B) SPEC_CAT_(A, B)
+#define SPEC_SUFFIX(PREFIX, LETTER) SPEC_CAT(_, SPEC_CAT(PREFIX, LETTER))
+#endif
+
+#if SPEC_OPERANDS == 2
+#define SPEC_INNER0 "vm/instrs/specialize_kind1.h"
+#define SPEC_INNER1 "vm/instrs/specialize_leaf.h"
+#elif SPEC_OPERANDS == 3
+#define SPEC_INNER0 "vm/instrs/specialize_kind1.h"
+#define SPEC_INNER1 "vm/instrs/specialize_kind2.h"
+#define SPEC_INNER2 "vm/instrs/specialize_leaf.h"
+#else
+#error "SPEC_OPERANDS must be 2 or 3"
+#endif
+
+#include "vm/instrs/specialize_kind0.h"
+
+#if SPEC_OPERANDS == 2
+static VMInstrFn SPEC_TABLE[3][3] = {
+#else
+static VMInstrFn SPEC_TABLE[3][3][3] = {
+#endif
+#define SPEC_EMIT_TABLE
+#include "vm/instrs/specialize_kind0.h"
+#undef SPEC_EMIT_TABLE
+};
+
+#undef SPEC_INNER0
+#undef SPEC_INNER1
+#ifdef SPEC_INNER2
+#undef SPEC_INNER2
+#endif
@@ -0,0 +1,21 @@
+// operand 0 of vm/instrs/specialize.h goes through every kind
+
+#define SPEC_KIND0 ARG_SLOT
+#define SPEC_LETTER0 s
+#include SPEC_INNER0
+#undef SPEC_KIND0
+#undef SPEC_LETTER0
+
+#define SPEC_KIND0 ARG_REFSLOT
+#define SPEC_LETTER0 r
+#include SPEC_INNER0
+#undef SPEC_KIND0
+#undef SPEC_LETTER0
+
+#if !SPEC_WRITE0
+#define SPEC_KIND0 ARG_VALUE
+#define SPEC_LETTER0 v
+#include SPEC_INNER0
+#undef SPEC_KIND0
+#undef SPEC_LETTER0
+#endif
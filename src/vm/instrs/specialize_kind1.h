@@ -0,0 +1,21 @@
+// operand 1 of vm/instrs/specialize.h goes through every kind
+
+#define SPEC_KIND1 ARG_SLOT
+#define SPEC_LETTER1 s
+#include SPEC_INNER1
+#undef SPEC_KIND1
+#undef SPEC_LETTER1
+
+#define SPEC_KIND1 ARG_REFSLOT
+#define SPEC_LETTER1 r
+#include SPEC_INNER1
+#undef SPEC_KIND1
+#undef SPEC_LETTER1
+
+#if !SPEC_WRITE1
+#define SPEC_KIND1 ARG_VALUE
+#define SPEC_LETTER1 v
+#include SPEC_INNER1
+#undef SPEC_KIND1
+#undef SPEC_LETTER1
+#endif
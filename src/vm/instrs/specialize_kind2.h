@@ -0,0 +1,21 @@
+// operand 2 of vm/instrs/specialize.h goes through every kind
+
+#define SPEC_KIND2 ARG_SLOT
+#define SPEC_LETTER2 s
+#include SPEC_INNER2
+#undef SPEC_KIND2
+#undef SPEC_LETTER2
+
+#define SPEC_KIND2 ARG_REFSLOT
+#define SPEC_LETTER2 r
+#include SPEC_INNER2
+#undef SPEC_KIND2
+#undef SPEC_LETTER2
+
+#if !SPEC_WRITE2
+#define SPEC_KIND2 ARG_VALUE
+#define SPEC_LETTER2 v
+#include SPEC_INNER2
+#undef SPEC_KIND2
+#undef SPEC_LETTER2
+#endif
@@ -0,0 +1,21 @@
+// one variant of vm/instrs/specialize.h: either its definition or its table entry
+
+#if SPEC_OPERANDS == 2
+#define FN_NAME SPEC_CAT(SPEC_CAT(SPEC_NAME, SPEC_SUFFIX(SPEC_PREFIX0, SPEC_LETTER0)), \
+                         SPEC_SUFFIX(SPEC_PREFIX1, SPEC_LETTER1))
+#else
+#define FN_NAME SPEC_CAT(SPEC_CAT(SPEC_CAT(SPEC_NAME, SPEC_SUFFIX(SPEC_PREFIX0, SPEC_LETTER0)), \
+                         SPEC_SUFFIX(SPEC_PREFIX1, SPEC_LETTER1)), SPEC_SUFFIX(SPEC_PREFIX2, SPEC_LETTER2))
+#endif
+
+#ifdef SPEC_EMIT_TABLE
+#if SPEC_OPERANDS == 2
+  [SPEC_KIND0][SPEC_KIND1] = FN_NAME,
+#else
+  [SPEC_KIND0][SPEC_KIND1][SPEC_KIND2] = FN_NAME,
+#endif
+#else
+#include SPEC_TEMPLATE
+#endif
+
+#undef FN_NAME
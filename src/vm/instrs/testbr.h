@@ -8,6 +8,18 @@
 #define FN_NAME_DEFINED
 #endif
 
+// phis need to know where we came from; phi_free functions don't
+#ifndef TRACK_BLOCK
+#define TRACK_BLOCK 1
+#define TRACK_BLOCK_DEFINED
+#endif
+
+// count the sides taken, for block layout; only until the function is optimized
+#ifndef PROFILE_BRANCH
+#define PROFILE_BRANCH 0
+#define PROFILE_BRANCH_DEFINED
+#endif
+
 #include "core.h"
 #include "object.h"
 
@@ -21,10 +33,16 @@ static FnWrap FN_NAME(VMState * __restrict__ state) {
   VM_ASSERT2_DEBUG(IS_BOOL(test_value), "can't branch on non-bool");
   bool test = AS_BOOL(test_value);
   
+  if (PROFILE_BRANCH) {
+    if (test) instr->true_count++;
+    else instr->false_count++;
+  }
   int target_blk = test ? true_blk : false_blk;
   state->instr = (Instr*) ((char*) frame->uf->body.instrs_ptr + frame->uf->body.blocks_ptr[target_blk].offset);
-  frame->prev_block = frame->block;
-  frame->block = target_blk;
+  if (TRACK_BLOCK) {
+    frame->prev_block = frame->block;
+    frame->block = target_blk;
+  }
   STEP_VM;
 }
 
@@ -33,6 +51,16 @@ static FnWrap FN_NAME(VMState * __restrict__ state) {
 #undef TEST_KIND
 #endif
 
+#ifdef PROFILE_BRANCH_DEFINED
+#undef PROFILE_BRANCH_DEFINED
+#undef PROFILE_BRANCH
+#endif
+
+#ifdef TRACK_BLOCK_DEFINED
+#undef TRACK_BLOCK_DEFINED
+#undef TRACK_BLOCK
+#endif
+
 #ifdef FN_NAME_DEFINED
 #undef FN_NAME_DEFINED
 #undef FN_NAME
@@ -0,0 +1,127 @@
+#include "vm/jitdump.h"
+#include "util.h"
+
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <elf.h>
+#include <string.h>
+#include <stdlib.h>
+
+int jit_dump_index = 0;
+
+#if defined(_i386__) || defined(__x86_64__)
+#define USE_NATIVE_TIMESTAMP
+#endif
+#define JITDUMP_FLAGS_ARCH_TIMESTAMP 1
+
+static uint64_t get_timestamp(void) {
+#ifdef USE_NATIVE_TIMESTAMP
+  unsigned int low, high;
+
+  __asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
+
+  return low | ((uint64_t)high) << 32;
+#else
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
+    fprintf(stderr, "clock_gettime failed: %s\n", strerror(errno));
+    abort();
+  }
+
+  return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+#endif
+}
+
+void jitdump_code_load(const char *fun_name, void *code, size_t code_size) {
+  // see https://github.com/torvalds/linux/blob/master/tools/perf/jvmti/jvmti_agent.c
+  char *basepath = getenv("JITDUMPDIR");
+  if (basepath == NULL) basepath = getenv("HOME");
+  if (basepath == NULL) basepath = getenv(".");
+  char *dump_path = my_asprintf("%s/.debug/", basepath);
+  if (mkdir(dump_path, S_IRWXU) < 0 && errno != EEXIST) {
+    fprintf(stderr, "failed to create .debug dir!\n");
+    abort();
+  }
+  dump_path = my_asprintf("%s/.debug/jit/", basepath);
+  if (mkdir(dump_path, S_IRWXU) < 0 && errno != EEXIST) {
+    fprintf(stderr, "failed to create .debug/jit dir!\n");
+    abort();
+  }
+
+  char *filename = my_asprintf("%s/.debug/jit/jit-%d.dump", basepath, getpid());
+
+  bool appending;
+  FILE *jitdump;
+  if (access(filename, F_OK) != -1) {
+    jitdump = fopen(filename, "a");
+    appending = true;
+  } else {
+    jitdump = fopen(filename, "w");
+    appending = false;
+  }
+  if (jitdump == NULL) {
+    fprintf(stderr, "cannot open jit dump: %s\n", strerror(errno));
+    abort();
+  }
+
+#ifdef __i386__
+#define MACHINE EM_386
+#endif
+#ifdef __x86_64__
+#define MACHINE EM_X86_64
+#endif
+  if (!appending) {
+    jitdump_header jheader = {
+      .magic = 0x4A695444, /* JITHEADER_MAGIC */
+      .version = 2,
+      .total_size = sizeof(jitdump_header),
+      .elf_mach = MACHINE,
+      .pid = getpid(),
+      .timestamp = get_timestamp(),
+      .flags = 0
+    };
+#ifdef USE_NATIVE_TIMESTAMP
+    jheader.flags |= JITDUMP_FLAGS_ARCH_TIMESTAMP;
+#endif
+    fwrite(&jheader, sizeof(jheader), 1, jitdump);
+  }
+
+  if (!fun_name) {
+    fun_name = my_asprintf("<%p>", code);
+  }
+
+  int namelen = strlen(fun_name);
+
+  jitdump_code_load_record jloadrecord = {
+    .header = {
+      .id = JIT_CODE_LOAD,
+      .total_size = sizeof(jitdump_code_load_record) + namelen + 1 + code_size,
+      .timestamp = get_timestamp()
+    },
+    .pid = getpid(),
+    .tid = syscall(SYS_gettid),
+    .vma = (size_t) code,
+    .code_addr = (size_t) code,
+    .code_size = code_size,
+    .code_index = jit_dump_index++
+  };
+  fwrite(&jloadrecord, sizeof(jloadrecord), 1, jitdump);
+  fwrite(fun_name, namelen + 1, 1, jitdump);
+  fwrite(code, code_size, 1, jitdump);
+  fclose(jitdump);
+
+  // place perf hint
+  int fd = open(filename, 0);
+  int fd_size = lseek(fd, 0, SEEK_END);
+  void *map = mmap(NULL, fd_size, PROT_READ|PROT_EXEC, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "error mmapping perf dump: %s\n", strerror(errno));
+    abort();
+  }
+  munmap(map, 1);
+  close(fd);
+}
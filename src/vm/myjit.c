@@ -1,14 +1,6 @@
 #include "vm/myjit.h"
 #include "object.h"
 
-#include <sys/syscall.h>
-#include <sys/stat.h>
-#include <sys/mman.h>
-#include <unistd.h>
-#include <fcntl.h>
-#include <errno.h>
-#include <elf.h>
-
 #define JIT_READ_STRUCT(R, T, M) jit_ldxi_u(p, R, R, offsetof(T, M), sizeof ((T) {0}).M);
 
 #define JIT_WRITE_STRUCT(R, T, M, R2) jit_stxi(p, offsetof(T, M), R, R2, sizeof ((T) {0}).M);
@@ -21,8 +13,6 @@
 
 #define JIT_READ_ARRAY_THEN_ARRAY(R, T1, O1, T2, O2) jit_ldxi_u(p, R, R, sizeof(T1) * O1 + sizeof(T2) * O2, sizeof(T2));
 
-int jit_dump_index = 0;
-
 static void load_frame_jit(JitInfo *jit, int reg) {
   struct jit * p = jit->p;
   
@@ -87,7 +77,7 @@ static void load_arg_bool_jit(JitInfo *jit, int reg, Arg test) {
     JIT_READ_ARRAY_THEN_ARRAY(reg, unsigned char, test.refslot.offset, TableEntry*, 0);
     JIT_READ_STRUCT(reg, TableEntry, value.b);
   } else {
-    jit_movi(p, reg, AS_BOOL(test.value));
+    jit_movi(p, reg, AS_BOOL(*test.value));
   }
 }
 
@@ -115,15 +105,17 @@ static void jump_to_block_jit(JitInfo *jit, int block, int T0, int T1, int T2) {
   jit_getarg(p, T1, 0); // T1 = state
   JIT_WRITE_STRUCT(T1, VMState, instr, T2);
   
-  // frame->prev_block = frame->block;
-  jit_movr(p, T1, T0); // T1 = frame
-  JIT_READ_STRUCT(T1, Callframe, block);
-  JIT_WRITE_STRUCT(T0, Callframe, prev_block, T1);
-  
-  // frame->block = target_blk;
-  
-  jit_movi(p, T1, block);
-  JIT_WRITE_STRUCT(T0, Callframe, block, T1);
+  if (jit->track_blocks) {
+    // frame->prev_block = frame->block;
+    jit_movr(p, T1, T0); // T1 = frame
+    JIT_READ_STRUCT(T1, Callframe, block);
+    JIT_WRITE_STRUCT(T0, Callframe, prev_block, T1);
+    
+    // frame->block = target_blk;
+    
+    jit_movi(p, T1, block);
+    JIT_WRITE_STRUCT(T0, Callframe, block, T1);
+  }
   
   if (block > jit->current_block) {
     jit_op *jmp_op = jit_jmpi(p, JIT_FORWARD);
@@ -206,29 +198,6 @@ static void patch_jit_labels(JitInfo *jit, int block) {
   }
 }
 
-#if defined(_i386__) || defined(__x86_64__)
-#define USE_NATIVE_TIMESTAMP
-#endif
-#define JITDUMP_FLAGS_ARCH_TIMESTAMP 1
-
-static uint64_t get_timestamp(void) {
-#ifdef USE_NATIVE_TIMESTAMP
-  unsigned int low, high;
-
-  __asm__ volatile("rdtsc" : "=a" (low), "=d" (high));
-
-  return low | ((uint64_t)high) << 32;
-#else
-  struct timespec ts;
-  if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
-    fprintf(stderr, "clock_gettime failed: %s\n", strerror(errno));
-    abort();
-  }
-  
-  return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
-#endif
-}
-
 void myjit_flatten(UserFunction *vmfun) {
   assert(vmfun->opt_jit_fn == NULL);
   assert(vmfun->proposed_jit_fn == NULL);
@@ -240,6 +209,7 @@ void myjit_flatten(UserFunction *vmfun) {
   jit.p = p;
   jit.block_label_ptr = malloc(sizeof(JumpEntry) * vmfun->body.blocks_len);
   jit.unresolved_jumps = NULL;
+  jit.track_blocks = !vmfun->phi_free;
   
   jit_label *start_label = jit_get_label(p);
   jit_prolog(p, &vmfun->proposed_jit_fn);
@@ -262,6 +232,8 @@ void myjit_flatten(UserFunction *vmfun) {
     int k = 0; (void) k;
     
     while (instr_cur != instr_end) {
+      // jit the parts of fused instrs separately
+      if (instr_cur->type == INSTR_FUSED) instr_cur = FUSED_PARTS(instr_cur);
       Instr *instr_next = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
       
       VMInstrFn vm_fn = instr_cur->fn;
@@ -318,94 +290,7 @@ void myjit_flatten(UserFunction *vmfun) {
   jit_generate_code(p);
   size_t fnsize = end_label->pos - start_label->pos;
   
-  // see https://github.com/torvalds/linux/blob/master/tools/perf/jvmti/jvmti_agent.c
-  char *basepath = getenv("JITDUMPDIR");
-  if (basepath == NULL) basepath = getenv("HOME");
-  if (basepath == NULL) basepath = getenv(".");
-  char *dump_path = my_asprintf("%s/.debug/", basepath);
-  if (mkdir(dump_path, S_IRWXU) < 0 && errno != EEXIST) {
-    fprintf(stderr, "failed to create .debug dir!\n");
-    abort();
-  }
-  dump_path = my_asprintf("%s/.debug/jit/", basepath);
-  if (mkdir(dump_path, S_IRWXU) < 0 && errno != EEXIST) {
-    fprintf(stderr, "failed to create .debug/jit dir!\n");
-    abort();
-  }
-  
-  char *filename = my_asprintf("%s/.debug/jit/jit-%d.dump", basepath, getpid());
-  
-  bool appending;
-  FILE *jitdump;
-  if (access(filename, F_OK) != -1) {
-    jitdump = fopen(filename, "a");
-    appending = true;
-  } else {
-    jitdump = fopen(filename, "w");
-    appending = false;
-  }
-  if (jitdump == NULL) {
-    fprintf(stderr, "cannot open jit dump: %s\n", strerror(errno));
-    abort();
-  }
-  
-#ifdef __i386__
-#define MACHINE EM_386
-#endif
-#ifdef __x86_64__
-#define MACHINE EM_X86_64
-#endif
-  if (!appending) {
-    jitdump_header jheader = {
-      .magic = 0x4A695444, /* JITHEADER_MAGIC */
-      .version = 2,
-      .total_size = sizeof(jitdump_header),
-      .elf_mach = MACHINE,
-      .pid = getpid(),
-      .timestamp = get_timestamp(),
-      .flags = 0
-    };
-#ifdef USE_NATIVE_TIMESTAMP
-    jheader.flags |= JITDUMP_FLAGS_ARCH_TIMESTAMP;
-#endif
-    fwrite(&jheader, sizeof(jheader), 1, jitdump);
-  }
-  
-  char *fun_name = vmfun->name;
-  if (!fun_name) {
-    fun_name = my_asprintf("<%p>", vmfun->proposed_jit_fn);
-  }
-  
-  int namelen = strlen(fun_name);
-  
-  jitdump_code_load_record jloadrecord = {
-    .header = {
-      .id = JIT_CODE_LOAD,
-      .total_size = sizeof(jitdump_code_load_record) + namelen + 1 + fnsize,
-      .timestamp = get_timestamp()
-    },
-    .pid = getpid(),
-    .tid = syscall(SYS_gettid),
-    .vma = *(size_t*) &vmfun->proposed_jit_fn,
-    .code_addr = *(size_t*) &vmfun->proposed_jit_fn,
-    .code_size = fnsize,
-    .code_index = jit_dump_index++
-  };
-  fwrite(&jloadrecord, sizeof(jloadrecord), 1, jitdump);
-  fwrite(fun_name, namelen + 1, 1, jitdump);
-  fwrite(*(void**) &vmfun->proposed_jit_fn, fnsize, 1, jitdump);
-  fclose(jitdump);
-  
-  // place perf hint
-  int fd = open(filename, 0);
-  int fd_size = lseek(fd, 0, SEEK_END);
-  void *map = mmap(NULL, fd_size, PROT_READ|PROT_EXEC, MAP_PRIVATE, fd, 0);
-  if (map == MAP_FAILED) {
-    fprintf(stderr, "error mmapping perf dump: %s\n", strerror(errno));
-    abort();
-  }
-  munmap(map, 1);
-  close(fd);
+  jitdump_code_load(vmfun->name, *(void**) &vmfun->proposed_jit_fn, fnsize);
   
 	// printf("generated function at %p: size %li\n", *(void**) &vmfun->proposed_jit_fn, fnsize);
   
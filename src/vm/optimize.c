@@ -2,9 +2,22 @@
 
 #include <stdio.h>
 
+#include "vm/analysis.h"
 #include "vm/builder.h"
 #include "vm/cfg.h"
+#include "vm/constants.h"
+#include "vm/dataflow.h"
 #include "gc.h"
+#include "util.h"
+
+// state shared by the runtime passes; see optimize_runtime
+typedef struct {
+  VMState *state;
+  Object *context;
+  // false while uf is still the unoptimized function that every closure points to.
+  // once a pass has rebuilt it, the copy is ours to patch in place and free.
+  bool owned;
+} PassManager;
 
 // mark slots whose value is only
 // used as parameter to other instructions and does not escape
@@ -83,7 +96,7 @@ static Value *find_constant_slots(UserFunction *uf) {
       if (instr->type == INSTR_MOVE) {
         MoveInstr *mi = (MoveInstr*) instr;
         if (mi->source.kind == ARG_VALUE && mi->target.kind == ARG_SLOT) {
-          slots[slot_index_rt(uf, mi->target.slot)] = mi->source.value;
+          slots[slot_index_rt(uf, mi->target.slot)] = *mi->source.value;
         }
       }
       instr = (Instr*)((char*) instr + instr_size(instr));
@@ -144,8 +157,7 @@ static int static_info_find_field(SlotIsStaticObjInfo *rec, const char *name_ptr
 static void slot_is_static_object(UserFunction *uf, SlotIsStaticObjInfo **slots_p) {
   *slots_p = calloc(sizeof(SlotIsStaticObjInfo), uf->slots);
 
-  CFG cfg;
-  cfg_build(&cfg, uf);
+  CFG *cfg = analysis_cfg(uf);
 
   Value *constant_slots = find_constant_slots(uf);
   int *field_for_refslot = calloc(sizeof(int), uf->refslots);
@@ -206,7 +218,7 @@ static void slot_is_static_object(UserFunction *uf, SlotIsStaticObjInfo **slots_
         (*slots_p)[target_slot].fields_len = fields_len;
         (*slots_p)[target_slot].names_ptr = names_ptr;
         (*slots_p)[target_slot].constraints_ptr = calloc(sizeof(ConstraintInfo), fields_len);
-        (*slots_p)[target_slot].belongs_to = *instr_belongs_to_p(&uf->body, instr);
+        (*slots_p)[target_slot].belongs_to = instr_belongs_to(&uf->body, instr);
 
         instr = (Instr*)((CloseObjectInstr*) instr + 1);
         (*slots_p)[target_slot].after_object_decl = instr;
@@ -226,7 +238,7 @@ static void slot_is_static_object(UserFunction *uf, SlotIsStaticObjInfo **slots_
           && scski->obj.kind == ARG_SLOT)
         {
           Object *constraint;
-          if (scski->constraint.kind == ARG_VALUE) constraint = OBJ_OR_NULL(scski->constraint.value);
+          if (scski->constraint.kind == ARG_VALUE) constraint = OBJ_OR_NULL(*scski->constraint.value);
           else constraint = OBJ_OR_NULL(constant_slots[slot_index_rt(uf, scski->constraint.slot)]);
           SlotIsStaticObjInfo *rec = &(*slots_p)[slot_index_rt(uf, scski->obj.slot)];
 
@@ -251,7 +263,7 @@ static void slot_is_static_object(UserFunction *uf, SlotIsStaticObjInfo **slots_
       if (instr->type == INSTR_INSTANCEOF) {
         InstanceofInstr *ins = (InstanceofInstr*) instr;
         instr = (Instr*) (ins + 1);
-        if (ins->proto.kind == ARG_VALUE && IS_OBJ(ins->proto.value)
+        if (ins->proto.kind == ARG_VALUE && IS_OBJ(*ins->proto.value)
           && ins->obj.kind == ARG_REFSLOT
           && ins->target.kind == ARG_SLOT)
         {
@@ -270,10 +282,10 @@ static void slot_is_static_object(UserFunction *uf, SlotIsStaticObjInfo **slots_
             TestBranchInstr *tbr = (TestBranchInstr*) instr;
             instr = (Instr*) (tbr + 1);
             if (tbr->test.kind == ARG_SLOT && slot_index_rt(uf, bool_slot) == slot_index_rt(uf, tbr->test.slot)
-              && cfg.nodes_ptr[tbr->true_blk].pred_len == 1)
+              && cfg->nodes_ptr[tbr->true_blk].pred_len == 1)
             {
-              assert(cfg.nodes_ptr[tbr->true_blk].pred_ptr[0] == i);
-              Object *constraint = AS_OBJ(ins->proto.value);
+              assert(cfg->nodes_ptr[tbr->true_blk].pred_ptr[0] == i);
+              Object *constraint = AS_OBJ(*ins->proto.value);
               int refslot = refslot_index_rt(uf, ins->obj.refslot);
               if (objslot_for_refslot[refslot] != -1) {
                 SlotIsStaticObjInfo *rec = &(*slots_p)[objslot_for_refslot[refslot]];
@@ -298,7 +310,6 @@ static void slot_is_static_object(UserFunction *uf, SlotIsStaticObjInfo **slots_
     }
   }
 
-  cfg_destroy(&cfg);
 
   free(constant_slots);
   free(objslot_for_refslot);
@@ -314,6 +325,7 @@ static void copy_fn_stats(UserFunction *from, UserFunction *to) {
   to->variadic_tail = from->variadic_tail;
   to->body.function_range = from->body.function_range;
   to->resolved = from->resolved;
+  to->phi_free = from->phi_free;
 }
 
 UserFunction *redirect_predictable_lookup_misses(UserFunction *uf) {
@@ -379,7 +391,7 @@ UserFunction *redirect_predictable_lookup_misses(UserFunction *uf) {
   return fn;
 }
 
-UserFunction *access_vars_via_refslots(UserFunction *uf) {
+UserFunction *access_vars_via_refslots(PassManager *pm, UserFunction *uf) {
   assert(uf->resolved);
 
   SlotIsStaticObjInfo *info;
@@ -445,11 +457,11 @@ UserFunction *access_vars_via_refslots(UserFunction *uf) {
             for (int k = 0; k < info[obj_slot].fields_len; ++k) {
               if (keyptr == info[obj_slot].names_ptr[k]) {
                 Refslot refslot = ref_slots_ptr[obj_slot][k];
-                use_range_start(&builder, *instr_belongs_to_p(&uf->body, instr));
+                use_range_start(&builder, instr_belongs_to(&uf->body, instr));
                 addinstr_move(&builder,
                               (Arg){.kind=ARG_REFSLOT,.refslot=refslot},
                               aski->target);
-                use_range_end(&builder, *instr_belongs_to_p(&uf->body, instr));
+                use_range_end(&builder, instr_belongs_to(&uf->body, instr));
                 instr = (Instr*) (aski + 1);
                 continue_outer = true;
                 break;
@@ -470,9 +482,9 @@ UserFunction *access_vars_via_refslots(UserFunction *uf) {
             for (int k = 0; k < info[obj_slot].fields_len; ++k) {
               if (key.key == info[obj_slot].names_ptr[k]) {
                 Refslot refslot = ref_slots_ptr[obj_slot][k];
-                use_range_start(&builder, *instr_belongs_to_p(&uf->body, instr));
+                use_range_start(&builder, instr_belongs_to(&uf->body, instr));
                 addinstr_move(&builder, aski->value, (WriteArg){.kind=ARG_REFSLOT,.refslot=refslot});
-                use_range_end(&builder, *instr_belongs_to_p(&uf->body, instr));
+                use_range_end(&builder, instr_belongs_to(&uf->body, instr));
                 instr = (Instr*) (aski + 1);
                 continue_outer = true;
                 break;
@@ -491,7 +503,6 @@ UserFunction *access_vars_via_refslots(UserFunction *uf) {
   int new_refslots = fn->refslots;
   assert(fn->slots == uf->slots);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   fn->refslots = new_refslots; // safe to update, can only grow
 
   free(info);
@@ -505,48 +516,32 @@ UserFunction *access_vars_via_refslots(UserFunction *uf) {
   return fn;
 }
 
-UserFunction *null_this_in_thisless_calls(VMState *state, UserFunction *uf) {
-  FunctionBuilder builder = {0};
-  builder.block_terminated = true;
-
-  Object *closure_base = state->shared->vcache.closure_base;
-  Object *function_base = state->shared->vcache.function_base;
+void null_this_in_thisless_calls(PassManager *pm, UserFunction *uf) {
+  Object *closure_base = pm->state->shared->vcache.closure_base;
+  Object *function_base = pm->state->shared->vcache.function_base;
 
   for (int i = 0; i < uf->body.blocks_len; ++i) {
-    new_block(&builder);
-
     Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
     while (instr_cur != instr_end) {
-      int instrsz = instr_size(instr_cur);
       if (instr_cur->type == INSTR_CALL) {
         CallInstr *instr = (CallInstr*) instr_cur;
-        CallInstr *instr_new = alloca(instrsz);
-        memcpy(instr_new, instr, instrsz);
         if (instr->info.fn.kind == ARG_VALUE) {
-          Object *fn_obj = OBJ_OR_NULL(instr->info.fn.value);
+          Object *fn_obj = OBJ_OR_NULL(*instr->info.fn.value);
           ClosureObject *cl = (ClosureObject*) obj_instance_of(fn_obj, closure_base);
           if (cl && !cl->vmfun->is_method) {
-            instr_new->info.this_arg = (Arg) {.kind = ARG_VALUE, .value = VNULL };
+            instr->info.this_arg = (Arg) {.kind = ARG_VALUE, .value = constant_pool_add(VNULL) };
           }
           FunctionObject *fn = (FunctionObject*) obj_instance_of(fn_obj, function_base);
           if (fn && !fn->method)
           {
-            instr_new->info.this_arg = (Arg) {.kind = ARG_VALUE, .value = VNULL };
+            instr->info.this_arg = (Arg) {.kind = ARG_VALUE, .value = constant_pool_add(VNULL) };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, instrsz, (Instr*) instr_new);
-      } else {
-        addinstr_like(&builder, &uf->body, instr_cur, instrsz, (Instr*) instr_cur);
       }
 
       instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
     }
   }
-
-  UserFunction *fn = build_function(&builder);
-  copy_fn_stats(uf, fn);
-  free_function(uf);
-  return fn;
 }
 
 typedef struct {
@@ -569,7 +564,7 @@ bool any_escape(SlotEscapeStat *escape_stat, int slot) {
   return false;
 }
 
-UserFunction *stackify_nonescaping_heap_allocs(UserFunction *uf) {
+UserFunction *stackify_nonescaping_heap_allocs(PassManager *pm, UserFunction *uf) {
   FunctionBuilder builder = {0};
   builder.block_terminated = true;
 
@@ -666,7 +661,6 @@ UserFunction *stackify_nonescaping_heap_allocs(UserFunction *uf) {
 
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   return fn;
 }
 
@@ -806,7 +800,7 @@ Value lookup_statically(Object *obj, FastKey key, bool *key_found_p) {
   return VNULL; // no hits.
 }
 
-UserFunction *remove_dead_slot_writes(UserFunction *uf) {
+UserFunction *remove_dead_slot_writes(PassManager *pm, UserFunction *uf) {
   bool *slot_live = calloc(sizeof(bool), uf->slots);
   for (int i = 0; i < uf->body.blocks_len; ++i) {
     Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
@@ -924,11 +918,10 @@ UserFunction *remove_dead_slot_writes(UserFunction *uf) {
   }
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   return fn;
 }
 
-UserFunction *call_functions_directly(VMState *state, UserFunction *uf) {
+UserFunction *call_functions_directly(PassManager *pm, UserFunction *uf) {
 FunctionBuilder builder = {0};
   builder.block_terminated = true;
 
@@ -939,9 +932,9 @@ FunctionBuilder builder = {0};
     while (instr_cur != instr_end) {
       if (instr_cur->type == INSTR_CALL) {
         CallInstr *instr = (CallInstr*) instr_cur;
-        if (instr->info.fn.kind == ARG_VALUE && IS_OBJ(instr->info.fn.value)) {
-          Object *fn_obj_n = AS_OBJ(instr->info.fn.value);
-          if (fn_obj_n->parent == state->shared->vcache.function_base) {
+        if (instr->info.fn.kind == ARG_VALUE && IS_OBJ(*instr->info.fn.value)) {
+          Object *fn_obj_n = AS_OBJ(*instr->info.fn.value);
+          if (fn_obj_n->parent == pm->state->shared->vcache.function_base) {
             FunctionObject *fn_obj = (FunctionObject*) fn_obj_n;
             int size = sizeof(CallFunctionDirectInstr) + sizeof(Arg) * instr->size;
             CallFunctionDirectInstr *cfdi = alloca(size);
@@ -973,29 +966,24 @@ FunctionBuilder builder = {0};
   }
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   return fn;
 }
 
-bool dominates(UserFunction *uf, Node2RPost node2rpost, int *sfidoms_ptr, Instr *earlier, Instr *later);
-
-UserFunction *inline_static_lookups_to_constants(VMState *state, UserFunction *uf, Object *context, bool free_fn_after) {
+UserFunction *inline_static_lookups_to_constants(PassManager *pm, UserFunction *uf) {
+  VMState *state = pm->state;
   SlotIsStaticObjInfo *static_info;
   slot_is_static_object(uf, &static_info);
-  CFG cfg;
-  cfg_build(&cfg, uf);
-
-  RPost2Node rpost2node = cfg_get_reverse_postorder(&cfg);
-  Node2RPost node2rpost = cfg_invert_rpost(&cfg, rpost2node);
-  int *sfidoms_ptr = cfg_build_sfidom_list(&cfg, rpost2node, node2rpost);
 
   Object *int_base = state->shared->vcache.int_base;
   Object *float_base = state->shared->vcache.float_base;
 
   bool *object_known = calloc(sizeof(bool), uf->slots);
   Value *known_values_table = calloc(sizeof(Value), uf->slots);
-  object_known[1] = true;
-  known_values_table[1] = OBJ2VAL(context);
+  // the generic specialization doesn't know its context
+  if (pm->context) {
+    object_known[1] = true;
+    known_values_table[1] = OBJ2VAL(pm->context);
+  }
 
   ConstraintInfo **slot_constraints = calloc(sizeof(ConstraintInfo*), uf->slots);
   ConstraintInfo **refslot_constraints = calloc(sizeof(ConstraintInfo*), uf->slots);
@@ -1036,7 +1024,7 @@ UserFunction *inline_static_lookups_to_constants(VMState *state, UserFunction *u
         MoveInstr *mi = (MoveInstr*) instr;
         if (mi->target.kind == ARG_SLOT && mi->source.kind == ARG_VALUE) {
           object_known[slot_index_rt(uf, mi->target.slot)] = true;
-          known_values_table[slot_index_rt(uf, mi->target.slot)] = mi->source.value;
+          known_values_table[slot_index_rt(uf, mi->target.slot)] = *mi->source.value;
         }
       }
 
@@ -1070,7 +1058,7 @@ UserFunction *inline_static_lookups_to_constants(VMState *state, UserFunction *u
             Object *constraint = constraints->constraint_ptr[k];
             Instr *location = constraints->constraint_imposed_here_ptr[k];
             if (constraint == int_base || constraint == float_base) { // primitives, always closed
-              if (dominates(uf, node2rpost, sfidoms_ptr, location, instr)) {
+              if (analysis_dominates(uf, location, instr)) {
                 object_known[slot_index_rt(uf, aski->target.slot)] = true;
                 bool key_found = false;
                 known_values_table[slot_index_rt(uf, aski->target.slot)] = object_lookup_p(constraint, &aski->key, &key_found);
@@ -1092,10 +1080,6 @@ UserFunction *inline_static_lookups_to_constants(VMState *state, UserFunction *u
       instr = (Instr*) ((char*) instr + instr_size(instr));
     }
   }
-  cfg_destroy(&cfg);
-  free(rpost2node.ptr);
-  free(node2rpost.ptr);
-  free(sfidoms_ptr);
   free(static_info);
 
   FunctionBuilder builder = {0};
@@ -1158,7 +1142,7 @@ UserFunction *inline_static_lookups_to_constants(VMState *state, UserFunction *u
       if (replace_with_mv) {
         MoveInstr mi = {
           .base = { .type = INSTR_MOVE },
-          .source = (Arg) { .kind = ARG_VALUE, .value = val },
+          .source = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(val) },
           .target = target,
           .opt_info = opt_info
         };
@@ -1172,7 +1156,6 @@ UserFunction *inline_static_lookups_to_constants(VMState *state, UserFunction *u
   }
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  if (free_fn_after) free_function(uf);
   return fn;
 }
 
@@ -1194,47 +1177,8 @@ UserFunction *optimize(UserFunction *uf) {
   return uf;
 }
 
-// does earlier dominate later?
-// note: if this is too slow, make a struct InstrLocation { int block; Instr *instr; }
-bool dominates(UserFunction *uf, Node2RPost node2rpost, int *sfidoms_ptr, Instr *earlier, Instr *later) {
-  int blk_earlier = -1, blk_later = -1;
-  for (int i = 0; i < uf->body.blocks_len; ++i) {
-    Instr *blk_start = BLOCK_START(uf, i), *blk_end = BLOCK_END(uf, i);
-    if (earlier >= blk_start && earlier < blk_end) {
-      blk_earlier = i;
-    }
-    if (later >= blk_start && later < blk_end) {
-      blk_later = i;
-    }
-    if (blk_earlier != -1 && blk_later != -1) break;
-  }
-  if (blk_earlier == -1) {
-    fprintf(stderr, "start instr not in function\n");
-    abort();
-  }
-  if (blk_later == -1) {
-    fprintf(stderr, "end instr not in function\n");
-    abort();
-  }
-  if (blk_earlier == blk_later) {
-    return earlier <= later;
-  }
-  // is blk_earlier in blk_later's dominance set?
-
-  if (node2rpost.ptr[blk_earlier] == -1 || node2rpost.ptr[blk_later] == -1) {
-    return false;
-  }
-  // run the intersect algo from sfidom partially
-  int current = blk_later;
-  while (node2rpost.ptr[current] > node2rpost.ptr[blk_earlier]) {
-    current = sfidoms_ptr[current];
-  }
-  // otherwise blk_earlier's dom set is not a prefix of ours - ie. it doesn't dominate us
-  return current == blk_earlier;
-}
-
 // pattern: %0 = instr; &0 = %0;     -> &0 = instr;
-UserFunction *slot_refslot_fuse(VMState *state, UserFunction *uf) {
+UserFunction *slot_refslot_fuse(PassManager *pm, UserFunction *uf) {
   FunctionBuilder builder = {0};
   builder.block_terminated = true;
 
@@ -1312,19 +1256,14 @@ UserFunction *slot_refslot_fuse(VMState *state, UserFunction *uf) {
 
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   return fn;
 }
 
-UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
-  FunctionBuilder builder = {0};
-  builder.block_terminated = true;
+void inline_constant_slots(PassManager *pm, UserFunction *uf) {
   Value *constant_slots = find_constant_slots(uf);
   Refslot *refslots = find_refslots(uf);
 
   for (int i = 0; i < uf->body.blocks_len; ++i) {
-    new_block(&builder);
-
     Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
     while (instr_cur != instr_end) {
       if (instr_cur->type == INSTR_CALL) {
@@ -1332,7 +1271,7 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         Arg fn = instr->info.fn;
         if (fn.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, fn.slot)])) {
-            fn = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, fn.slot)] };
+            fn = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, fn.slot)]) };
           } else if (refslots[slot_index_rt(uf, fn.slot)].index != -1) {
             fn = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, fn.slot)] };
           }
@@ -1340,7 +1279,7 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         Arg this_arg = instr->info.this_arg;
         if (this_arg.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, this_arg.slot)])) {
-            this_arg = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, this_arg.slot)] };
+            this_arg = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, this_arg.slot)]) };
           } else if (refslots[slot_index_rt(uf, this_arg.slot)].index != -1) {
             this_arg = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, this_arg.slot)] };
           }
@@ -1365,14 +1304,14 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
           Arg arg = ((Arg*)(&instr->info + 1))[k];
           if (arg.kind == ARG_SLOT) {
             if (NOT_NULL(constant_slots[slot_index_rt(uf, arg.slot)])) {
-              arg = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, arg.slot)] };
+              arg = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, arg.slot)]) };
             } else if (refslots[slot_index_rt(uf, arg.slot)].index != -1) {
               arg = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, arg.slot)] };
             }
           }
           ((Arg*)(&ci->info + 1))[k] = arg;
         }
-        addinstr_like(&builder, &uf->body, instr_cur, size, (Instr*)ci);
+        memcpy(instr_cur, ci, size);
         instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
         continue;
       }
@@ -1381,14 +1320,14 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         KeyInObjInstr instr = *(KeyInObjInstr*) instr_cur;
         if (instr.key.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.key.slot)])) {
-            instr.key = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.key.slot)] };
+            instr.key = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.key.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.key.slot)].index != -1) {
             instr.key = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.key.slot)] };
           }
         }
         if (instr.obj.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.obj.slot)])) {
-            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.obj.slot)] };
+            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.obj.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.obj.slot)].index != -1) {
             instr.obj = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.obj.slot)] };
           }
@@ -1402,7 +1341,7 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
             instr.target = (WriteArg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.target.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1411,7 +1350,7 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         AccessStringKeyInstr instr = *(AccessStringKeyInstr*) instr_cur;
         if (instr.obj.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.obj.slot)])) {
-            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.obj.slot)] };
+            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.obj.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.obj.slot)].index != -1) {
             instr.obj = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.obj.slot)] };
           }
@@ -1425,7 +1364,7 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
             instr.target = (WriteArg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.target.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1434,12 +1373,12 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         MoveInstr instr = *(MoveInstr*) instr_cur;
         if (instr.source.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.source.slot)])) {
-            instr.source = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.source.slot)] };
+            instr.source = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.source.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.source.slot)].index != -1) {
             instr.source = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.source.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1448,12 +1387,12 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         TestBranchInstr instr = *(TestBranchInstr*) instr_cur;
         if (instr.test.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.test.slot)])) {
-            instr.test = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.test.slot)] };
+            instr.test = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.test.slot)]) };
           } /*else if (refslots[instr.test.slot] != -1) { // invalid state - branch instructions mustn't access refslots
             instr.test = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[instr.test.slot] };
           }*/
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1471,19 +1410,19 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         }
         if (instr.arg1.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.arg1.slot)])) {
-            instr.arg1 = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.arg1.slot)] };
+            instr.arg1 = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.arg1.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.arg1.slot)].index != -1) {
             instr.arg1 = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.arg1.slot)] };
           }
         }
         if (instr.arg2.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.arg2.slot)])) {
-            instr.arg2 = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.arg2.slot)] };
+            instr.arg2 = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.arg2.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.arg2.slot)].index != -1) {
             instr.arg2 = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.arg2.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1492,12 +1431,12 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         ReturnInstr instr = *(ReturnInstr*) instr_cur;
         if (instr.ret.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.ret.slot)])) {
-            instr.ret = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.ret.slot)] };
+            instr.ret = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.ret.slot)]) };
           } /*else if (refslots[instr.ret.slot] != -1) { // invalid state - branch instructions mustn't access refslots
             instr.ret = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[instr.ret.slot] };
           }*/
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1506,19 +1445,19 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         SetConstraintStringKeyInstr instr = *(SetConstraintStringKeyInstr*) instr_cur;
         if (instr.obj.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.obj.slot)])) {
-            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.obj.slot)] };
+            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.obj.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.obj.slot)].index != -1) {
             instr.obj = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.obj.slot)] };
           }
         }
         if (instr.constraint.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.constraint.slot)])) {
-            instr.constraint = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.constraint.slot)] };
+            instr.constraint = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.constraint.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.constraint.slot)].index != -1) {
             instr.constraint = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.constraint.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1527,7 +1466,7 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         AccessInstr instr = *(AccessInstr*) instr_cur;
         if (instr.obj.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.obj.slot)])) {
-            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.obj.slot)] };
+            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.obj.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.obj.slot)].index != -1) {
             instr.obj = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.obj.slot)] };
           }
@@ -1543,12 +1482,12 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         }
         if (instr.key.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.key.slot)])) {
-            instr.key = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.key.slot)] };
+            instr.key = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.key.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.key.slot)].index != -1) {
             instr.key = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.key.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1557,14 +1496,14 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         InstanceofInstr instr = *(InstanceofInstr*) instr_cur;
         if (instr.obj.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.obj.slot)])) {
-            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.obj.slot)] };
+            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.obj.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.obj.slot)].index != -1) {
             instr.obj = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.obj.slot)] };
           }
         }
         if (instr.proto.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.proto.slot)])) {
-            instr.proto = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.proto.slot)] };
+            instr.proto = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.proto.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.proto.slot)].index != -1) {
             instr.proto = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.proto.slot)] };
           }
@@ -1578,7 +1517,7 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
             instr.target = (WriteArg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.target.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1587,26 +1526,26 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         AssignInstr instr = *(AssignInstr*) instr_cur;
         if (instr.obj.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.obj.slot)])) {
-            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.obj.slot)] };
+            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.obj.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.obj.slot)].index != -1) {
             instr.obj = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.obj.slot)] };
           }
         }
         if (instr.value.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.value.slot)])) {
-            instr.value = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.value.slot)] };
+            instr.value = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.value.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.value.slot)].index != -1) {
             instr.value = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.value.slot)] };
           }
         }
         if (instr.key.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.key.slot)])) {
-            instr.key = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.key.slot)] };
+            instr.key = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.key.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.key.slot)].index != -1) {
             instr.key = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.key.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
@@ -1615,34 +1554,31 @@ UserFunction *inline_constant_slots(VMState *state, UserFunction *uf) {
         AssignStringKeyInstr instr = *(AssignStringKeyInstr*) instr_cur;
         if (instr.obj.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.obj.slot)])) {
-            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.obj.slot)] };
+            instr.obj = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.obj.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.obj.slot)].index != -1) {
             instr.obj = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.obj.slot)] };
           }
         }
         if (instr.value.kind == ARG_SLOT) {
           if (NOT_NULL(constant_slots[slot_index_rt(uf, instr.value.slot)])) {
-            instr.value = (Arg) { .kind = ARG_VALUE, .value = constant_slots[slot_index_rt(uf, instr.value.slot)] };
+            instr.value = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(constant_slots[slot_index_rt(uf, instr.value.slot)]) };
           } else if (refslots[slot_index_rt(uf, instr.value.slot)].index != -1) {
             instr.value = (Arg) { .kind = ARG_REFSLOT, .refslot = refslots[slot_index_rt(uf, instr.value.slot)] };
           }
         }
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(instr), (Instr*) &instr);
+        memcpy(instr_cur, &instr, sizeof(instr));
         instr_cur = (Instr*) ((char*) instr_cur + sizeof(instr));
         continue;
       }
 
-      addinstr_like(&builder, &uf->body, instr_cur, instr_size(instr_cur), instr_cur);
       instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
     }
   }
-  UserFunction *fn = build_function(&builder);
-  copy_fn_stats(uf, fn);
-  free_function(uf);
-  return fn;
+  free(constant_slots);
+  free(refslots);
 }
 
-UserFunction *fuse_static_object_alloc(VMState *state, UserFunction *uf) {
+UserFunction *fuse_static_object_alloc(PassManager *pm, UserFunction *uf) {
   FunctionBuilder builder = {0};
   builder.block_terminated = true;
 
@@ -1719,7 +1655,7 @@ UserFunction *fuse_static_object_alloc(VMState *state, UserFunction *uf) {
               if (info->key.hash == scski->key.hash) {
                 if (info->constraint) abort(); // wat wat wat
                 if (scski->constraint.kind == ARG_SLOT) info->constraint = AS_OBJ(constant_slots[slot_index_rt(uf, scski->constraint.slot)]);
-                else info->constraint = AS_OBJ(scski->constraint.value);
+                else info->constraint = AS_OBJ(*scski->constraint.value);
               }
             }
 
@@ -1729,7 +1665,7 @@ UserFunction *fuse_static_object_alloc(VMState *state, UserFunction *uf) {
           for (int k = 0; k < info_len; ++k) {
             StaticFieldInfo *info = &info_ptr[k];
             FastKey key = info->key;
-            char *error = object_set(state, &sample_obj, &key, VNULL);
+            char *error = object_set(pm->state, &sample_obj, &key, VNULL);
             if (error) { fprintf(stderr, "INTERNAL LOGIC ERROR: %s\n", error); abort(); }
           }
           for (int k = 0; k < info_len; ++k) {
@@ -1778,98 +1714,16 @@ UserFunction *fuse_static_object_alloc(VMState *state, UserFunction *uf) {
   }
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   return fn;
 }
 
-// TODO make something fast, lol
-typedef struct _SortedUniqList SortedUniqList;
-struct _SortedUniqList {
-  int value;
-  SortedUniqList *next;
-};
-
-void sl_print(FILE *file, SortedUniqList *list) {
-  fprintf(file, "{");
-  bool first = true;
-  while (list) {
-    if (first) { first = false; } else { fprintf(file, ", "); }
-    fprintf(file, "%i", list->value);
-    list = list->next;
-  }
-  fprintf(file, "}");
-}
-
-bool sl_add_to(SortedUniqList **target, SortedUniqList *source) {
-  bool changed = false;
-  SortedUniqList **cursor = target;
-  while (source) {
-    while (*cursor && (*cursor)->value < source->value) cursor = &(*cursor)->next;
-    // now cursor->value >= source->value, insert source
-    if (*cursor && (*cursor)->value == source->value) { } // already in target
-    else {
-      SortedUniqList *next = *cursor;
-      *cursor = malloc(sizeof(SortedUniqList));
-      (*cursor)->value = source->value;
-      (*cursor)->next = next;
-      changed = true;
-    }
-    source = source->next;
-  }
-  return changed;
-}
-
-bool sl_add_value_to(SortedUniqList **target, int value) {
-  SortedUniqList entry = { .value = value };
-  return sl_add_to(target, &entry);
-}
-
-bool sl_subtract_from(SortedUniqList **target, SortedUniqList *source) {
-  bool changed = false;
-  SortedUniqList **cursor = target;
-  while (source) {
-    while (*cursor && (*cursor)->value < source->value) cursor = &(*cursor)->next;
-    // now cursor->value >= source->value, insert source
-    if (*cursor && (*cursor)->value == source->value) {
-      SortedUniqList *old_ptr = *cursor;
-      *cursor = (*cursor)->next;
-      changed = true;
-      free(old_ptr);
-    }
-    source = source->next;
-  }
-  return changed;
-}
-
-bool sl_subtract_value(SortedUniqList **target, int value) {
-  SortedUniqList entry = { .value = value };
-  return sl_subtract_from(target, &entry);
-}
-
-bool sl_contains(SortedUniqList *slist, int value) {
-  while (slist) {
-    if (slist->value > value) return false;
-    if (slist->value == value) return true;
-    slist = slist->next;
-  }
-  return false;
-}
-
-void sl_free(SortedUniqList *slist) {
-  while (slist) {
-    SortedUniqList *next = slist->next;
-    free(slist);
-    slist = next;
-  }
-}
-
-static void reassign_slot(UserFunction *uf, Slot *slot_p, bool read, int special_slots, bool last_access_blk, bool *slot_inuse, int *slot_map, SortedUniqList *slot_outlist) {
+static void reassign_slot(UserFunction *uf, Slot *slot_p, bool read, int special_slots, bool pinned, bool last_access_blk, bool *slot_inuse, int *slot_map, Bitset slot_outlist) {
   int slot = slot_index_rt(uf, *slot_p);
-  if (read) {
+  if (read || pinned) {
     *slot_p = (Slot) { .index = slot_map[slot] };
     assert(uf->resolved);
     resolve_slot_ref(uf, slot_p);
-    if (slot >= special_slots && !sl_contains(slot_outlist, slot) && last_access_blk) {
+    if (read && slot >= special_slots && !pinned && !bitset_test(slot_outlist, slot) && last_access_blk) {
       slot_inuse[slot_map[slot]] = false;
       // fprintf(stderr, "open slot %i -> %i for access\n", slot, slot_map[slot]);
     }
@@ -1892,80 +1746,7 @@ static void reassign_slot(UserFunction *uf, Slot *slot_p, bool read, int special
   resolve_slot_ref(uf, slot_p);
 }
 
-// gather all slots that we read that we don't write
-bool update_block_inlist(UserFunction *uf, int block, SortedUniqList **target, SortedUniqList *out_list) {
-  SortedUniqList *read_list = NULL;
-  SortedUniqList *write_list = NULL;
-
-  Instr *instr_cur = BLOCK_START(uf, block), *instr_end = BLOCK_END(uf, block);
-  while (instr_cur != instr_end) {
-    switch (instr_cur->type) {
-#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
-#define CHKSLOT_READ(S) sl_add_value_to(&read_list, slot_index_rt(uf, S));
-#define CHKSLOT_WRITE(S) sl_add_value_to(&write_list, slot_index_rt(uf, S));
-        case INSTR_INVALID: { abort();
-#include "vm/slots.txt"
-          CASE(INSTR_LAST, Instr) abort();
-        } break;
-        default: assert("Unhandled Instruction Type!" && false);
-
-#undef CHKSLOT_READ
-#undef CHKSLOT_WRITE
-#undef CASE
-    }
-    instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
-  }
-  SortedUniqList *in_list = read_list;
-  sl_add_to(&in_list, out_list); // will be read later
-  sl_subtract_from(&in_list, write_list);
-  sl_free(write_list);
-  bool res = sl_add_to(target, in_list);
-  sl_free(in_list);
-  return res;
-}
-
-void determine_slot_liveness(UserFunction *uf, SortedUniqList ***slot_inlist, SortedUniqList ***slot_outlist) {
-  // fprintf(stderr, "for:\n");
-  // dump_fn(NULL, uf);
-  CFG cfg;
-  cfg_build(&cfg, uf);
-  // perform flow analysis; see https://en.wikipedia.org/wiki/Live_variable_analysis
-  SortedUniqList *workqueue = NULL;
-  for (int i = 0; i < cfg.nodes_len; i++) {
-    sl_add_value_to(&workqueue, i);
-  }
-  *slot_inlist = calloc(uf->slots, sizeof(SortedUniqList*));
-  *slot_outlist = calloc(uf->slots, sizeof(SortedUniqList*));
-  while (workqueue) {
-    int blk = workqueue->value;
-    sl_subtract_value(&workqueue, blk);
-
-    bool changed_outlist = false;
-    // outlist = for succ: union(inlist[succ])
-    for (int i = 0; i < cfg.nodes_ptr[blk].succ_len; i++) {
-      changed_outlist |= sl_add_to(&(*slot_outlist)[blk], (*slot_inlist)[cfg.nodes_ptr[blk].succ_ptr[i]]);
-    }
-    if (changed_outlist) {
-      // fprintf(stderr, "%i updated outlist to ", blk);
-      // sl_print(stderr, (*slot_outlist)[blk]);
-      // fprintf(stderr, "\n");
-    }
-
-    bool changed_inlist = update_block_inlist(uf, blk, &(*slot_inlist)[blk], (*slot_outlist)[blk]);
-    if (changed_inlist) {
-      // fprintf(stderr, "%i updated inlist to ", blk);
-      // sl_print(stderr, (*slot_inlist)[blk]);
-      // fprintf(stderr, "\n");
-
-      // update our preds
-      for (int i = 0; i < cfg.nodes_ptr[blk].pred_len; i++) {
-        sl_add_value_to(&workqueue, cfg.nodes_ptr[blk].pred_ptr[i]);
-      }
-    }
-  }
-}
-
-UserFunction *free_stack_objects_early(UserFunction *uf) {
+UserFunction *free_stack_objects_early(PassManager *pm, UserFunction *uf) {
   FunctionBuilder builder = {0};
   builder.block_terminated = true;
 
@@ -1976,10 +1757,11 @@ UserFunction *free_stack_objects_early(UserFunction *uf) {
   // Note: refslot reads keep stackframes alive.
   // Obviously.
 
-  SortedUniqList *stack_allocated_obj = NULL;
+  Bitset stack_allocated_obj = bitset_alloc(uf->slots);
 
-  SortedUniqList **slot_inlist, **slot_outlist;
-  determine_slot_liveness(uf, &slot_inlist, &slot_outlist);
+  CFG *cfg = analysis_cfg(uf);
+  DataflowProblem liveness;
+  dataflow_slot_liveness(&liveness, cfg, uf);
 
   Instr **blk_last_access = malloc(sizeof(Instr*) * uf->slots);
   Slot *dying_object_slots = calloc(sizeof(Slot), uf->slots);
@@ -1995,13 +1777,13 @@ UserFunction *free_stack_objects_early(UserFunction *uf) {
         if (instr_cur->type == INSTR_ALLOC_OBJECT) {
           AllocObjectInstr *instr = (AllocObjectInstr*) instr_cur;
           if (instr->alloc_stack) {
-            sl_add_value_to(&stack_allocated_obj, slot_index_rt(uf, instr->target_slot));
+            bitset_set(stack_allocated_obj, slot_index_rt(uf, instr->target_slot));
           }
         }
         if (instr_cur->type == INSTR_ALLOC_STATIC_OBJECT) {
           AllocStaticObjectInstr *instr = (AllocStaticObjectInstr*) instr_cur;
           if (instr->alloc_stack) {
-            sl_add_value_to(&stack_allocated_obj, slot_index_rt(uf, instr->target_slot));
+            bitset_set(stack_allocated_obj, slot_index_rt(uf, instr->target_slot));
           }
         }
         switch (instr_cur->type) {
@@ -2023,7 +1805,7 @@ UserFunction *free_stack_objects_early(UserFunction *uf) {
 
     int num_dying_slots = 0;
     for (int k = 0; k < uf->slots; k++) {
-      if (blk_last_access[k] && !sl_contains(slot_outlist[blk], k) && sl_contains(stack_allocated_obj, k)) {
+      if (blk_last_access[k] && !bitset_test(liveness.out_ptr[blk], k) && bitset_test(stack_allocated_obj, k)) {
         Slot slot = (Slot) { .index = k };
         assert(uf->resolved);
         resolve_slot_ref(uf, &slot);
@@ -2055,7 +1837,7 @@ UserFunction *free_stack_objects_early(UserFunction *uf) {
               CheckConstraintInstr cci = {
                 .base = { .type = INSTR_CHECK_CONSTRAINT },
                 .value = { .kind = ARG_SLOT, .slot = value },
-                .constraint = { .kind = ARG_VALUE, .value = OBJ2VAL(constraint) },
+                .constraint = { .kind = ARG_VALUE, .value = constant_pool_add(OBJ2VAL(constraint)) },
               };
               addinstr_like(&builder, &uf->body, instr_cur, sizeof(cci), (Instr*) &cci);
             }
@@ -2092,16 +1874,11 @@ UserFunction *free_stack_objects_early(UserFunction *uf) {
 
   free(blk_last_access);
   free(dying_object_slots);
-  for (int i = 0; i < uf->slots; i++) {
-    sl_free(slot_inlist[i]);
-    sl_free(slot_outlist[i]);
-  }
-  free(slot_inlist);
-  free(slot_outlist);
+  bitset_free(stack_allocated_obj);
+  dataflow_destroy(&liveness);
 
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   return fn;
 }
 
@@ -2113,19 +1890,19 @@ UserFunction *free_stack_objects_early(UserFunction *uf) {
  * then we may safely replace its refslot reads
  * with the slot reads it was constructed from!
  */
-UserFunction *deconstruct_immutable_stack_objects(UserFunction *uf) {
+UserFunction *deconstruct_immutable_stack_objects(PassManager *pm, UserFunction *uf) {
   FunctionBuilder builder = {0};
   builder.block_terminated = true;
 
-  SortedUniqList *mutable_stack_objects = NULL;
-  SortedUniqList *nonfreed_read_slots = NULL;
+  Bitset mutable_stack_objects = bitset_alloc(uf->slots);
+  Bitset nonfreed_read_slots = bitset_alloc(uf->slots);
 
   for (int i = 0; i < uf->body.blocks_len; ++i) {
     Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
 #define CHKSLOT_REF_WRITE(SLOT) \
-    sl_add_value_to(&mutable_stack_objects, slot_index_rt(uf, find_refslot_slot(uf, SLOT)));
+    bitset_set(mutable_stack_objects, slot_index_rt(uf, find_refslot_slot(uf, SLOT)));
 #define CHKSLOT_READ_RW(SLOT) \
-    if (instr_cur->type != INSTR_FREE_OBJECT) { sl_add_value_to(&nonfreed_read_slots, slot_index_rt(uf, SLOT)); }
+    if (instr_cur->type != INSTR_FREE_OBJECT) { bitset_set(nonfreed_read_slots, slot_index_rt(uf, SLOT)); }
     while (instr_cur != instr_end) {
 #define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
       switch (instr_cur->type) {
@@ -2156,7 +1933,7 @@ UserFunction *deconstruct_immutable_stack_objects(UserFunction *uf) {
 
         AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr_cur;
         int target_slot = slot_index_rt(uf, asoi->target_slot);
-        if (!sl_contains(mutable_stack_objects, target_slot) && !sl_contains(nonfreed_read_slots, target_slot)) {
+        if (!bitset_test(mutable_stack_objects, target_slot) && !bitset_test(nonfreed_read_slots, target_slot)) {
           for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
             int refslot = refslot_index_rt(uf, ASOI_INFO(instr_cur)[k].refslot);
             redirect_refslot[refslot] = true;
@@ -2187,21 +1964,42 @@ UserFunction *deconstruct_immutable_stack_objects(UserFunction *uf) {
   }
   free(field_for_refslot);
   free(redirect_refslot);
-  sl_free(mutable_stack_objects);
-  sl_free(nonfreed_read_slots);
+  bitset_free(mutable_stack_objects);
+  bitset_free(nonfreed_read_slots);
 
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   return fn;
 }
 
-void fixup_refslots(UserFunction *uf, int delta) {
-  assert(uf->resolved);
+// the key each refslot stands for, by hash
+static uint32_t *find_refslot_keys(UserFunction *uf) {
+  uint32_t *refslot_key = calloc(sizeof(uint32_t), uf->refslots);
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+      if (instr_cur->type == INSTR_DEFINE_REFSLOT) {
+        DefineRefslotInstr *dri = (DefineRefslotInstr*) instr_cur;
+        refslot_key[refslot_index_rt(uf, dri->target_refslot)] = dri->key.hash;
+      }
+      if (instr_cur->type == INSTR_ALLOC_STATIC_OBJECT) {
+        AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr_cur;
+        for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
+          refslot_key[refslot_index_rt(uf, ASOI_INFO(asoi)[k].refslot)] = ASOI_INFO(asoi)[k].key.hash;
+        }
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+  return refslot_key;
+}
+
+static int *count_slot_writes(UserFunction *uf) {
+  int *slot_writes = calloc(sizeof(int), uf->slots);
   for (int i = 0; i < uf->body.blocks_len; ++i) {
-#define CHKSLOT_REF(SLOT) SLOT.offset += delta;
     Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
     while (instr_cur != instr_end) {
+#define CHKSLOT_WRITE(SLOT) slot_writes[slot_index_rt(uf, SLOT)] ++
 #define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
       switch (instr_cur->type) {
         case INSTR_INVALID: { abort();
@@ -2211,173 +2009,1467 @@ void fixup_refslots(UserFunction *uf, int delta) {
         default: assert("Unhandled Instruction Type!" && false);
       }
 #undef CASE
-#undef CHKSLOT_REF
+#undef CHKSLOT_WRITE
       instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
     }
   }
+  return slot_writes;
 }
 
-// WARNING
-// this function makes the IR **NON-SSA**
-// and thus it **MUST** come completely last!!
-UserFunction *compactify_registers(UserFunction *uf) {
-  FunctionBuilder builder = {0};
-  builder.block_terminated = true;
-
-  SortedUniqList **slot_inlist, **slot_outlist;
-  determine_slot_liveness(uf, &slot_inlist, &slot_outlist);
-
-  bool *slot_inuse = calloc(sizeof(bool), uf->slots);
-  int *slot_map = calloc(sizeof(int), uf->slots);
-  Instr **blk_last_access = calloc(sizeof(Instr*), uf->slots);
-
-  // specials
-  int special_slots = 2 + uf->arity;
-  for (int i = 0; i < special_slots; ++i) {
-    slot_inuse[i] = true;
-    slot_map[i] = i;
+// a lookup that hits now will keep hitting if every object on the way, and the one that has
+// the key, is closed: nothing can shadow the entry or remove it. (its value may still change.)
+static bool lookup_always_hits(Object *obj, FastKey key) {
+  while (obj) {
+    if (table_lookup_prepared(&obj->tbl, &key)) return obj->flags & OBJ_CLOSED;
+    if (!(obj->flags & OBJ_CLOSED)) return false;
+    obj = obj->parent;
   }
+  return false;
+}
 
-  for (int i = 0; i < uf->body.blocks_len; ++i) {
-    new_block(&builder);
+// a string key lookup that misses calls the object's '[]' overload, which can do anything.
+// we only know it won't if the object is known, and the lookup always hits on it.
+static bool lookup_runs_no_code(PassManager *pm, UserFunction *uf, AccessStringKeyInstr *aski) {
+  Object *known_obj = NULL;
+  if (aski->obj.kind == ARG_VALUE) known_obj = OBJ_OR_NULL(*aski->obj.value);
+  else if (aski->obj.kind == ARG_SLOT && slot_index_rt(uf, aski->obj.slot) == 1) known_obj = pm->context;
+  return known_obj && lookup_always_hits(known_obj, aski->key);
+}
 
-    memset(slot_inuse + special_slots, 0, sizeof(bool) * (uf->slots - special_slots));
-    for (int k = special_slots; k < uf->slots; k++) {
-      if (sl_contains(slot_inlist[i], k)) slot_inuse[slot_map[k]] = true;
+// what can the instr change about the values of lookups?
+// returns false if it may run unknown code, and so change anything.
+// otherwise, the keys it may assign are stored in keys_ptr (at most two).
+static bool instr_assigned_keys(PassManager *pm, UserFunction *uf, uint32_t *refslot_key, Instr *instr_cur,
+                                uint32_t *keys_ptr, int *keys_len_p) {
+  *keys_len_p = 0;
+  switch (instr_cur->type) {
+    case INSTR_CALL: {
+      // only pure natives (arithmetic, comparison) are known not to touch objects
+      CallInstr *ci = (CallInstr*) instr_cur;
+      Object *fn_obj = (ci->info.fn.kind == ARG_VALUE) ? OBJ_OR_NULL(*ci->info.fn.value) : NULL;
+      if (!fn_obj || fn_obj->parent != pm->state->shared->vcache.function_base || !((FunctionObject*) fn_obj)->pure) {
+        return false;
+      }
+      break;
     }
-    /*
-    fprintf(stderr, "updating block %i:\n", i);
-    for (int k = special_slots; k < uf->slots; k++) {
-      if (slot_inuse[k]) fprintf(stderr, "| %i in use.\n", k);
+    case INSTR_ACCESS_STRING_KEY:
+      if (!lookup_runs_no_code(pm, uf, (AccessStringKeyInstr*) instr_cur)) return false;
+      break;
+    case INSTR_ASSIGN_STRING_KEY: {
+      AssignStringKeyInstr *aski = (AssignStringKeyInstr*) instr_cur;
+      // shadowing assignments fall back to '[]=', which can do anything
+      if (aski->type == ASSIGN_SHADOWING) return false;
+      keys_ptr[(*keys_len_p)++] = aski->key.hash;
+      break;
     }
-    */
-    // precomp first/last access per instr inside the block, for slots that don't escape the block
-    {
-      Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
-      while (instr_cur != instr_end) {
-        switch (instr_cur->type) {
+    case INSTR_ALLOC_OBJECT: case INSTR_ALLOC_INT_OBJECT: case INSTR_ALLOC_BOOL_OBJECT:
+    case INSTR_ALLOC_FLOAT_OBJECT: case INSTR_ALLOC_ARRAY_OBJECT: case INSTR_ALLOC_STRING_OBJECT:
+    case INSTR_ALLOC_CLOSURE_OBJECT: case INSTR_FREE_OBJECT: case INSTR_CLOSE_OBJECT: case INSTR_FREEZE_OBJECT:
+    case INSTR_IDENTICAL: case INSTR_INSTANCEOF: case INSTR_TEST: case INSTR_BR: case INSTR_TESTBR:
+    case INSTR_PHI: case INSTR_MOVE: case INSTR_STRING_KEY_IN_OBJ:
+    case INSTR_SET_CONSTRAINT_STRING_KEY: case INSTR_DEFINE_REFSLOT: case INSTR_ALLOC_STATIC_OBJECT:
+    case INSTR_RETURN:
+      break;
+    default:
+      return false;
+  }
+#define CHKSLOT_REF_WRITE(SLOT) keys_ptr[(*keys_len_p)++] = refslot_key[refslot_index_rt(uf, SLOT)];
 #define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
-#define CHKSLOT_READ(S) blk_last_access[slot_index_rt(uf, S)] = instr_cur;
-#define CHKSLOT_WRITE(S) blk_last_access[slot_index_rt(uf, S)] = instr_cur;
-          case INSTR_INVALID: { abort(); Instr *instr = NULL; (void) instr;
+  switch (instr_cur->type) {
+    case INSTR_INVALID: { abort();
 #include "vm/slots.txt"
-            CASE(INSTR_LAST, Instr) abort();
-          } break;
-          default: assert("Unhandled Instruction Type!" && false);
-#undef CHKSLOT_READ
-#undef CHKSLOT_WRITE
+      CASE(INSTR_LAST, Instr) abort();
+    } break;
+    default: assert("Unhandled Instruction Type!" && false);
+  }
 #undef CASE
-        }
-        instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
-      }
-    }
-
-    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
-    while (instr_cur != instr_end) {
-      switch (instr_cur->type) {
-#define CASE(KEY, TY) \
-          use_range_start(&builder, *instr_belongs_to_p(&uf->body, instr_cur));\
-          addinstr(&builder, sz, (Instr*) instr);\
-          use_range_end(&builder, *instr_belongs_to_p(&uf->body, instr_cur));\
-          instr_cur = (Instr*) ((char*) instr_cur + sz);\
-          continue;\
-        }\
-        case KEY: {\
-          int sz = instr_size(instr_cur);\
-          TY *instr = (TY*) alloca(sz);\
-          memcpy(instr, instr_cur, sz);
-
-#define CHKSLOT_READ_RW(S) reassign_slot(uf, &S, true, special_slots, instr_cur == blk_last_access[slot_index_rt(uf, S)], slot_inuse, slot_map,\
-                                      slot_outlist[i])
-#define CHKSLOT_WRITE_RW(S) reassign_slot(uf, &S, false, special_slots, instr_cur == blk_last_access[slot_index_rt(uf, S)], slot_inuse, slot_map,\
-                                       slot_outlist[i])
-
-        case INSTR_INVALID: { abort(); Instr *instr = NULL; int sz = 0;
-#include "vm/slots.txt"
-          CASE(INSTR_LAST, Instr) abort();
-        } break;
-        default: assert("Unhandled Instruction Type!" && false);
+#undef CHKSLOT_REF_WRITE
+  assert(*keys_len_p <= 2);
+  return true;
+}
 
-#undef CHKSLOT_READ_RW
-#undef CHKSLOT_WRITE_RW
-#undef CASE
-      }
-      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
-    }
+// an instr whose result only depends on its operands and the keys it reads
+typedef struct {
+  Instr *instr;
+  int sig_offset, sig_len; // operands, in the signature list
+  bool reads_objects; // killed by unknown code
+  bool reads_all_keys; // killed by any assignment (dynamic key)
+  uint32_t keys[2]; int keys_len; // killed by assigning these keys
+  int same_next; // next earlier instance with the same signature, or -1
+} ValueInstance;
+
+static void sig_add_arg(UserFunction *uf, ValueInstance *inst, uint64_t **sig_ptr_p, int *sig_len_p,
+                        uint32_t *refslot_key, Arg arg) {
+  *sig_ptr_p = realloc(*sig_ptr_p, sizeof(uint64_t) * (*sig_len_p + 2));
+  (*sig_ptr_p)[(*sig_len_p)++] = arg.kind;
+  if (arg.kind == ARG_SLOT) (*sig_ptr_p)[(*sig_len_p)++] = slot_index_rt(uf, arg.slot);
+  else if (arg.kind == ARG_VALUE) (*sig_ptr_p)[(*sig_len_p)++] = (uintptr_t) arg.value; // values are pooled
+  else {
+    int refslot = refslot_index_rt(uf, arg.refslot);
+    (*sig_ptr_p)[(*sig_len_p)++] = refslot;
+    inst->reads_objects = true;
+    inst->keys[inst->keys_len++] = refslot_key[refslot];
   }
+}
 
-  int maxslot = 0;
-  for (int i = 0; i < uf->slots; ++i) if (slot_map[i] > maxslot) maxslot = slot_map[i];
-  free(blk_last_access);
-  free(slot_inuse);
-  free(slot_map);
-  for (int i = 0; i < uf->slots; i++) {
-    sl_free(slot_inlist[i]);
-    sl_free(slot_outlist[i]);
+static WriteArg instance_target(Instr *instr) {
+  switch (instr->type) {
+    case INSTR_ACCESS_STRING_KEY: return ((AccessStringKeyInstr*) instr)->target;
+    case INSTR_STRING_KEY_IN_OBJ: return ((StringKeyInObjInstr*) instr)->target;
+    case INSTR_KEY_IN_OBJ: return ((KeyInObjInstr*) instr)->target;
+    case INSTR_CALL: return ((CallInstr*) instr)->info.target;
+    default: abort();
   }
-  free(slot_inlist);
-  free(slot_outlist);
-
-  UserFunction *fn = build_function(&builder);
-  copy_fn_stats(uf, fn);
-  int old_slots = uf->slots;
-  free_function(uf);
-  fn->slots = maxslot + 1;
-  fn->non_ssa = true;
-
-  fixup_refslots(fn, (fn->slots - old_slots) * sizeof(Value));
-  // dump_fn(NULL, fn);
-  return fn;
 }
 
-UserFunction *remove_pointless_blocks(UserFunction *uf) {
-  CFG cfg;
-  cfg_build(&cfg, uf);
+// the value of an arg, if it is a constant or a slot we've folded to one
+static bool fold_arg_value(UserFunction *uf, Arg arg, bool *known_p, Value *known, Value *val_p) {
+  if (arg.kind == ARG_VALUE) {
+    *val_p = *arg.value;
+    return true;
+  }
+  if (arg.kind == ARG_SLOT && known_p[slot_index_rt(uf, arg.slot)]) {
+    *val_p = known[slot_index_rt(uf, arg.slot)];
+    return true;
+  }
+  return false;
+}
 
-  bool *blk_live = calloc(sizeof(bool), uf->body.blocks_len);
-  blk_live[0] = true;
+// run a pure native on constant arguments, in a throwaway substate.
+// if it errors, we leave the call alone so the error happens at runtime, if ever.
+static bool fold_pure_call(PassManager *pm, UserFunction *uf, CallInstr *ci, bool *known_p, Value *known, Value *res_p) {
+  VMState *state = pm->state;
+  Value fn_val, this_val;
+  if (!fold_arg_value(uf, ci->info.fn, known_p, known, &fn_val)) return false;
+  Object *fn_obj = OBJ_OR_NULL(fn_val);
+  if (!fn_obj || fn_obj->parent != state->shared->vcache.function_base || !((FunctionObject*) fn_obj)->pure) return false;
+  if (!fold_arg_value(uf, ci->info.this_arg, known_p, known, &this_val)) return false;
+
+  Value *args_ptr = alloca(sizeof(Value) * ci->info.args_len);
+  CallInfo *info = alloca(sizeof(CallInfo) + sizeof(Arg) * ci->info.args_len);
+  for (int k = 0; k < ci->info.args_len; k++) {
+    if (!fold_arg_value(uf, INFO_ARGS_PTR(&ci->info)[k], known_p, known, &args_ptr[k])) return false;
+    INFO_ARGS_PTR(info)[k] = (Arg) { .kind = ARG_VALUE, .value = &args_ptr[k] };
+  }
+  Value res = VNULL;
+  info->fn = (Arg) { .kind = ARG_VALUE, .value = &fn_val };
+  info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &this_val };
+  info->target = (WriteArg) { .kind = ARG_POINTER, .pointer = &res };
+  info->args_len = ci->info.args_len;
+
+  VMState substate;
+  vm_setup_substate_of(&substate, state);
+  ((FunctionObject*) fn_obj)->fn_ptr(&substate, info);
+  if (substate.runstate == VM_ERRORED) {
+    free(substate.error);
+    return false;
+  }
+  // an object result (say, a concatenated string) would be one object shared by every run,
+  // where each run used to make its own; anything can be done to it, so we only fold primitives.
+  if (IS_OBJ(res)) return false;
+  *res_p = res;
+  return true;
+}
 
+// evaluate calls to pure natives (arithmetic, comparisons, string ops, Math) whose inputs are all constant
+// and whose result is an int, float or bool, along with the lookups and tests that feed them,
+// and turn branches on folded tests into plain jumps.
+// unreachable blocks are left for remove_pointless_blocks, dead moves for remove_dead_slot_writes.
+UserFunction *fold_constant_calls(PassManager *pm, UserFunction *uf) {
+  VMState *state = pm->state;
+  int *slot_writes = count_slot_writes(uf);
+  bool *known_p = calloc(sizeof(bool), uf->slots);
+  Value *known = calloc(sizeof(Value), uf->slots);
+  bool *call_failed = calloc(sizeof(bool), uf->slots);
+
+  // only fold into slots with one write, so the value holds wherever it's read.
+  // iterate, since phis and loops may put a use before its definition in block order.
   bool changed;
   do {
     changed = false;
-    // yes yes, you can construct a pathological graph of blocks, who cares
-    // the language doesn't have goto anyways
     for (int i = 0; i < uf->body.blocks_len; ++i) {
-      if (blk_live[i]) {
-        for (int k = 0; k < cfg.nodes_ptr[i].succ_len; ++k) {
-          bool *liveflag = &blk_live[cfg.nodes_ptr[i].succ_ptr[k]];
-          if (!*liveflag) {
-            *liveflag = true;
-            changed = true;
+      Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+      for (; instr != instr_end; instr = (Instr*) ((char*) instr + instr_size(instr))) {
+        WriteArg target;
+        Value val;
+        if (instr->type == INSTR_MOVE) {
+          MoveInstr *mi = (MoveInstr*) instr;
+          target = mi->target;
+          if (target.kind != ARG_SLOT || known_p[slot_index_rt(uf, target.slot)]) continue;
+          if (!fold_arg_value(uf, mi->source, known_p, known, &val)) continue;
+        } else if (instr->type == INSTR_ACCESS_STRING_KEY) {
+          AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr;
+          target = aski->target;
+          if (target.kind != ARG_SLOT || known_p[slot_index_rt(uf, target.slot)]) continue;
+          Value obj_val;
+          if (!fold_arg_value(uf, aski->obj, known_p, known, &obj_val)) continue;
+          Object *obj = closest_obj(state, obj_val);
+          // a string constant has no keys of its own; it's shared by every run, so we treat
+          // it as closed and look straight into the (frozen) string base
+          if (obj && obj->parent == state->shared->vcache.string_base && obj->tbl.entries_stored == 0) {
+            obj = obj->parent;
           }
-        }
+          bool key_found;
+          val = lookup_statically(obj, aski->key, &key_found);
+          if (!key_found) continue;
+        } else if (instr->type == INSTR_TEST) {
+          TestInstr *ti = (TestInstr*) instr;
+          target = ti->target;
+          if (target.kind != ARG_SLOT || known_p[slot_index_rt(uf, target.slot)]) continue;
+          if (!fold_arg_value(uf, ti->value, known_p, known, &val)) continue;
+          val = BOOL2VAL(value_is_truthy(val));
+        } else if (instr->type == INSTR_CALL) {
+          CallInstr *ci = (CallInstr*) instr;
+          target = ci->info.target;
+          if (target.kind != ARG_SLOT || known_p[slot_index_rt(uf, target.slot)]) continue;
+          if (call_failed[slot_index_rt(uf, target.slot)]) continue;
+          if (slot_writes[slot_index_rt(uf, target.slot)] != 1) continue;
+          if (!fold_pure_call(pm, uf, ci, known_p, known, &val)) {
+            // don't retry once all its inputs were known
+            Value unused;
+            bool inputs_known = fold_arg_value(uf, ci->info.fn, known_p, known, &unused)
+              && fold_arg_value(uf, ci->info.this_arg, known_p, known, &unused);
+            for (int k = 0; inputs_known && k < ci->info.args_len; k++) {
+              inputs_known = fold_arg_value(uf, INFO_ARGS_PTR(&ci->info)[k], known_p, known, &unused);
+            }
+            if (inputs_known) call_failed[slot_index_rt(uf, target.slot)] = true;
+            continue;
+          }
+        } else continue;
+
+        int slot = slot_index_rt(uf, target.slot);
+        if (slot_writes[slot] != 1) continue;
+        known_p[slot] = true;
+        known[slot] = val;
+        changed = true;
       }
     }
   } while (changed);
 
-  int *blk_map = calloc(sizeof(int), uf->body.blocks_len);
-
-  int k = 0;
-  for (int i = 0; i < uf->body.blocks_len; ++i) {
-    if (blk_live[i]) blk_map[i] = k++;
-    else blk_map[i] = -1;
-  }
-
   FunctionBuilder builder = {0};
   builder.block_terminated = true;
 
   for (int i = 0; i < uf->body.blocks_len; ++i) {
-    if (!blk_live[i]) continue;
-
     new_block(&builder);
-    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
-    while (instr_cur != instr_end) {
-      if (instr_cur->type == INSTR_BR) {
-        BranchInstr *instr = (BranchInstr*) instr_cur;
-        BranchInstr bri = *instr;
-        bri.blk = blk_map[bri.blk];
-        addinstr_like(&builder, &uf->body, instr_cur, sizeof(bri), (Instr*) &bri);
-        instr_cur = (Instr*) (instr + 1);
+
+    Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    for (; instr != instr_end; instr = (Instr*) ((char*) instr + instr_size(instr))) {
+      WriteArg target = { .kind = ARG_POINTER };
+      char *opt_info = NULL;
+      if (instr->type == INSTR_ACCESS_STRING_KEY) {
+        AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr;
+        target = aski->target;
+        opt_info = my_asprintf("folded lookup to '%s'", aski->key.key);
+      } else if (instr->type == INSTR_TEST) {
+        target = ((TestInstr*) instr)->target;
+        opt_info = my_asprintf("folded test");
+      } else if (instr->type == INSTR_CALL) {
+        target = ((CallInstr*) instr)->info.target;
+        opt_info = my_asprintf("folded pure call");
+      } else if (instr->type == INSTR_TESTBR) {
+        TestBranchInstr *tbi = (TestBranchInstr*) instr;
+        Value test_val;
+        if (fold_arg_value(uf, tbi->test, known_p, known, &test_val)) {
+          BranchInstr bri = {
+            .base = { .type = INSTR_BR },
+            .blk = value_is_truthy(test_val) ? tbi->true_blk : tbi->false_blk
+          };
+          addinstr_like(&builder, &uf->body, instr, sizeof(bri), (Instr*) &bri);
+          continue;
+        }
+      }
+
+      if (target.kind == ARG_SLOT && known_p[slot_index_rt(uf, target.slot)]) {
+        MoveInstr mi = {
+          .base = { .type = INSTR_MOVE },
+          .source = (Arg) { .kind = ARG_VALUE, .value = constant_pool_add(known[slot_index_rt(uf, target.slot)]) },
+          .target = target,
+          .opt_info = opt_info
+        };
+        addinstr_like(&builder, &uf->body, instr, sizeof(mi), (Instr*) &mi);
+        continue;
+      }
+      free(opt_info);
+      addinstr_like(&builder, &uf->body, instr, instr_size(instr), instr);
+    }
+  }
+  free(slot_writes);
+  free(known_p);
+  free(known);
+  free(call_failed);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  return fn;
+}
+
+// global value numbering for lookups and pure arithmetic.
+// an instr is redundant if an instr with the same signature ran on every path to it, and nothing
+// since could have changed the result: that's "available definitions", a forward/intersect problem.
+// the earlier result is in an ssa slot, so we drop the instr and read that slot instead.
+UserFunction *remove_redundant_computations(PassManager *pm, UserFunction *uf) {
+  CFG *cfg = analysis_cfg(uf);
+  uint32_t *refslot_key = find_refslot_keys(uf);
+  int *slot_writes = count_slot_writes(uf);
+
+  ValueInstance *inst_ptr = NULL; int inst_len = 0;
+  uint64_t *sig_ptr = NULL; int sig_len = 0;
+  int *block_inst_first = malloc(sizeof(int) * (uf->body.blocks_len + 1));
+
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    block_inst_first[blk] = inst_len;
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      ValueInstance inst = { .instr = instr_cur, .sig_offset = sig_len, .same_next = -1 };
+      WriteArg target = { .kind = ARG_VALUE };
+      bool operands_stable = true;
+#define SIG_ARG(ARG) \
+      if ((ARG).kind == ARG_SLOT && slot_writes[slot_index_rt(uf, (ARG).slot)] > 1) operands_stable = false; \
+      sig_add_arg(uf, &inst, &sig_ptr, &sig_len, refslot_key, ARG)
+#define SIG_WORD(W) sig_ptr = realloc(sig_ptr, sizeof(uint64_t) * (sig_len + 1)); sig_ptr[sig_len++] = (W)
+      switch (instr_cur->type) {
+        case INSTR_ACCESS_STRING_KEY: {
+          AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr_cur;
+          // a miss calls '[]', which may return something new every time
+          if (!lookup_runs_no_code(pm, uf, aski)) break;
+          SIG_WORD(INSTR_ACCESS_STRING_KEY); SIG_WORD(aski->key.hash); SIG_ARG(aski->obj);
+          inst.reads_objects = true;
+          inst.keys[inst.keys_len++] = aski->key.hash;
+          target = aski->target;
+          break;
+        }
+        case INSTR_STRING_KEY_IN_OBJ: {
+          StringKeyInObjInstr *skioi = (StringKeyInObjInstr*) instr_cur;
+          SIG_WORD(INSTR_STRING_KEY_IN_OBJ); SIG_WORD(skioi->key.hash); SIG_ARG(skioi->obj);
+          inst.reads_objects = true;
+          inst.keys[inst.keys_len++] = skioi->key.hash;
+          target = skioi->target;
+          break;
+        }
+        case INSTR_KEY_IN_OBJ: {
+          KeyInObjInstr *kioi = (KeyInObjInstr*) instr_cur;
+          SIG_WORD(INSTR_KEY_IN_OBJ); SIG_ARG(kioi->obj); SIG_ARG(kioi->key);
+          inst.reads_objects = inst.reads_all_keys = true;
+          target = kioi->target;
+          break;
+        }
+        case INSTR_CALL: {
+          CallInstr *ci = (CallInstr*) instr_cur;
+          Object *fn_obj = (ci->info.fn.kind == ARG_VALUE) ? OBJ_OR_NULL(*ci->info.fn.value) : NULL;
+          // refslot arguments would need one key each; one is plenty for arithmetic.
+          // natives that make a new object (string '+') can't be shared: the callers may tell the copies apart
+          if (!fn_obj || fn_obj->parent != pm->state->shared->vcache.function_base
+            || !((FunctionObject*) fn_obj)->pure || ((FunctionObject*) fn_obj)->allocates || ci->info.args_len > 1
+          ) break;
+          SIG_WORD(INSTR_CALL); SIG_WORD(ci->info.args_len); SIG_ARG(ci->info.fn); SIG_ARG(ci->info.this_arg);
+          for (int k = 0; k < ci->info.args_len; ++k) { SIG_ARG(INFO_ARGS_PTR(&ci->info)[k]); }
+          target = ci->info.target;
+          break;
+        }
+        default: break;
+      }
+#undef SIG_WORD
+#undef SIG_ARG
+      if (target.kind == ARG_SLOT && slot_writes[slot_index_rt(uf, target.slot)] == 1 && operands_stable) {
+        inst.sig_len = sig_len - inst.sig_offset;
+        inst_ptr = realloc(inst_ptr, sizeof(ValueInstance) * (inst_len + 1));
+        inst_ptr[inst_len++] = inst;
+      } else {
+        sig_len = inst.sig_offset;
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+  block_inst_first[uf->body.blocks_len] = inst_len;
+
+  // chain instances with the same signature, through a hash table of the latest one
+  int table_len = 16;
+  while (table_len < inst_len * 2) table_len *= 2;
+  int *table = malloc(sizeof(int) * table_len);
+  for (int i = 0; i < table_len; ++i) table[i] = -1;
+  for (int i = 0; i < inst_len; ++i) {
+    ValueInstance *inst = &inst_ptr[i];
+    uint64_t hash = 14695981039346656037ULL;
+    for (int k = 0; k < inst->sig_len; ++k) hash = (hash ^ sig_ptr[inst->sig_offset + k]) * 1099511628211ULL;
+    int bucket = hash & (table_len - 1);
+    while (table[bucket] != -1) {
+      ValueInstance *other = &inst_ptr[table[bucket]];
+      if (other->sig_len == inst->sig_len
+        && memcmp(&sig_ptr[other->sig_offset], &sig_ptr[inst->sig_offset], sizeof(uint64_t) * inst->sig_len) == 0
+      ) break;
+      bucket = (bucket + 1) & (table_len - 1);
+    }
+    inst->same_next = table[bucket];
+    table[bucket] = i;
+  }
+  free(table);
+
+  DataflowProblem avail;
+  dataflow_init(&avail, uf->body.blocks_len, inst_len, DATAFLOW_FORWARD, DATAFLOW_INTERSECT);
+
+  // the instances each kind of write kills, as sets: unknown code, any assignment, one key
+  Bitset reads_objects = bitset_alloc(inst_len), reads_all_keys = bitset_alloc(inst_len);
+  int key_table_len = 16;
+  while (key_table_len < inst_len * 4) key_table_len *= 2;
+  int *key_table = malloc(sizeof(int) * key_table_len);
+  for (int i = 0; i < key_table_len; ++i) key_table[i] = -1;
+  uint32_t *key_ptr = NULL; Bitset *key_readers_ptr = NULL; int keys_len = 0;
+#define KEY_BUCKET(HASH, BUCKET) \
+    int BUCKET = (HASH) & (key_table_len - 1); \
+    while (key_table[BUCKET] != -1 && key_ptr[key_table[BUCKET]] != (HASH)) BUCKET = (BUCKET + 1) & (key_table_len - 1)
+  for (int i = 0; i < inst_len; ++i) {
+    ValueInstance *inst = &inst_ptr[i];
+    if (inst->reads_objects) bitset_set(reads_objects, i);
+    if (inst->reads_all_keys) bitset_set(reads_all_keys, i);
+    for (int k = 0; k < inst->keys_len; ++k) {
+      KEY_BUCKET(inst->keys[k], bucket);
+      if (key_table[bucket] == -1) {
+        key_ptr = realloc(key_ptr, sizeof(uint32_t) * (keys_len + 1));
+        key_readers_ptr = realloc(key_readers_ptr, sizeof(Bitset) * (keys_len + 1));
+        key_ptr[keys_len] = inst->keys[k];
+        key_readers_ptr[keys_len] = bitset_alloc(inst_len);
+        key_table[bucket] = keys_len++;
+      }
+      bitset_set(key_readers_ptr[key_table[bucket]], i);
+    }
+  }
+
+  // subtract every instance whose result an instr may change from SET; KILLED(K) is run per killing set
+#define KILL(SET, INSTR_CUR, KILLED) { \
+    uint32_t assigned_ptr[2]; int assigned_len; \
+    bool known = instr_assigned_keys(pm, uf, refslot_key, INSTR_CUR, assigned_ptr, &assigned_len); \
+    if (!known) { bitset_subtract_from(SET, reads_objects); KILLED(reads_objects); } \
+    else if (assigned_len) { bitset_subtract_from(SET, reads_all_keys); KILLED(reads_all_keys); } \
+    for (int l = 0; known && l < assigned_len; ++l) { \
+      KEY_BUCKET(assigned_ptr[l], bucket); \
+      if (key_table[bucket] != -1) { \
+        bitset_subtract_from(SET, key_readers_ptr[key_table[bucket]]); \
+        KILLED(key_readers_ptr[key_table[bucket]]); \
+      } \
+    } \
+  }
+#define NO_KILLED(K)
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    Bitset gen = avail.gen_ptr[blk], kill = avail.kill_ptr[blk];
+    int next_inst = block_inst_first[blk];
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      if (next_inst < block_inst_first[blk + 1] && inst_ptr[next_inst].instr == instr_cur) {
+        bitset_set(gen, next_inst++);
+      }
+#define ADD_KILLED(K) bitset_union_into(kill, K)
+      KILL(gen, instr_cur, ADD_KILLED);
+#undef ADD_KILLED
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+  dataflow_solve(&avail, cfg);
+
+  // first find all redundant instrs: their uses may come earlier in the layout than they do
+  int *slot_map = malloc(sizeof(int) * uf->slots);
+  for (int i = 0; i < uf->slots; ++i) slot_map[i] = i;
+  Bitset redundant = bitset_alloc(inst_len);
+  Bitset cur = bitset_alloc(inst_len);
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    bitset_copy(cur, avail.in_ptr[blk]);
+    int next_inst = block_inst_first[blk];
+
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      if (next_inst < block_inst_first[blk + 1] && inst_ptr[next_inst].instr == instr_cur) {
+        ValueInstance *inst = &inst_ptr[next_inst];
+        for (int k = inst->same_next; k != -1; k = inst_ptr[k].same_next) {
+          if (!bitset_test(cur, k)) continue;
+          // k dominates us, and its target is only written there: every use of ours can read it instead.
+          slot_map[slot_index_rt(uf, instance_target(inst->instr).slot)] = slot_index_rt(uf, instance_target(inst_ptr[k].instr).slot);
+          bitset_set(redundant, next_inst);
+          break;
+        }
+        if (!bitset_test(redundant, next_inst)) bitset_set(cur, next_inst);
+        next_inst ++;
+      }
+      KILL(cur, instr_cur, NO_KILLED);
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+#undef NO_KILLED
+#undef KILL
+#undef KEY_BUCKET
+
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    new_block(&builder);
+    int next_inst = block_inst_first[blk];
+
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      int instrsz = instr_size(instr_cur);
+      if (next_inst < block_inst_first[blk + 1] && inst_ptr[next_inst].instr == instr_cur) {
+        if (bitset_test(redundant, next_inst++)) {
+          instr_cur = (Instr*) ((char*) instr_cur + instrsz);
+          continue;
+        }
+      }
+      Instr *instr_new = alloca(instrsz);
+      memcpy(instr_new, instr_cur, instrsz);
+#define MAP_SLOT(SLOT) SLOT = (Slot) { .index = slot_map[slot_index_rt(uf, SLOT)] }; if (uf->resolved) resolve_slot_ref(uf, &SLOT)
+#define READ_SLOT(ARG) if ((ARG).kind == ARG_SLOT) { MAP_SLOT((ARG).slot); }
+#define CHKSLOT_READ_RW(SLOT) MAP_SLOT(SLOT)
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_new; (void) instr;
+      switch (instr_new->type) {
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+      }
+#undef CASE
+#undef CHKSLOT_READ_RW
+#undef READ_SLOT
+#undef MAP_SLOT
+      addinstr_like(&builder, &uf->body, instr_cur, instrsz, instr_new);
+      instr_cur = (Instr*) ((char*) instr_cur + instrsz);
+    }
+  }
+
+  free(slot_map);
+  bitset_free(redundant);
+  bitset_free(cur);
+  bitset_free(reads_objects);
+  bitset_free(reads_all_keys);
+  for (int i = 0; i < keys_len; ++i) bitset_free(key_readers_ptr[i]);
+  free(key_readers_ptr);
+  free(key_ptr);
+  free(key_table);
+  dataflow_destroy(&avail);
+  free(inst_ptr);
+  free(sig_ptr);
+  free(block_inst_first);
+  free(refslot_key);
+  free(slot_writes);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  return fn;
+}
+
+static Instr *block_last_instr(UserFunction *uf, int blk) {
+  Instr *instr = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk), *last = NULL;
+  while (instr != instr_end) {
+    last = instr;
+    instr = (Instr*) ((char*) instr + instr_size(instr));
+  }
+  return last;
+}
+
+static bool key_in_list(uint32_t *hash_ptr, int hash_len, uint32_t hash) {
+  for (int i = 0; i < hash_len; ++i) if (hash_ptr[i] == hash) return true;
+  return false;
+}
+
+static int arg_refslot(UserFunction *uf, Arg arg) {
+  return (arg.kind == ARG_REFSLOT) ? refslot_index_rt(uf, arg.refslot) : -1;
+}
+
+// is the instr 'slot = refslot . key', for the given refslot?
+static bool is_lookup_on(UserFunction *uf, Instr *instr, int refslot, uint32_t key_hash) {
+  if (!instr || instr->type != INSTR_ACCESS_STRING_KEY) return false;
+  AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr;
+  return arg_refslot(uf, aski->obj) == refslot && aski->key.hash == key_hash;
+}
+
+// bounds check elimination for counting loops over arrays.
+// a counter is a frame variable that only ever holds ints >= 0: it is only set to int constants and
+// bumped by one, and nothing else can reach it (the frame is on the stack, nobody assigns its key).
+// - lookups on a counter always find the int natives, so its '<' and '+' become constant calls
+// - obj[counter] becomes the array index instr, which skips the '[]' call and its type checks,
+//   leaving one unsigned compare against the array's real length.
+// a loop test like 'counter < obj.length' proves nothing about the real length: length is
+// an ordinary key, and scripts can assign it.
+UserFunction *eliminate_array_bounds_checks(PassManager *pm, UserFunction *uf) {
+  Object *int_base = pm->state->shared->vcache.int_base;
+  uint32_t *refslot_key = find_refslot_keys(uf);
+
+  // the instr that writes a slot, if there is exactly one
+  Instr **slot_def = calloc(sizeof(Instr*), uf->slots);
+  int *slot_writes = calloc(sizeof(int), uf->slots);
+  // reads of each slot, and how many of them are as the function of a call
+  int *slot_reads = calloc(sizeof(int), uf->slots);
+  int *slot_fn_reads = calloc(sizeof(int), uf->slots);
+  // block that allocates the frame of each refslot, if it's a counter candidate
+  int *counter_blk = malloc(sizeof(int) * uf->refslots);
+  bool *not_counter = calloc(sizeof(bool), uf->refslots);
+  bool *counter_set = calloc(sizeof(bool), uf->refslots);
+  Bitset frame_slots = bitset_alloc(uf->slots);
+  for (int i = 0; i < uf->refslots; ++i) counter_blk[i] = -1;
+
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      if (instr_cur->type == INSTR_ALLOC_STATIC_OBJECT) {
+        AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr_cur;
+        bitset_set(frame_slots, slot_index_rt(uf, asoi->target_slot));
+        for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
+          int refslot = refslot_index_rt(uf, ASOI_INFO(asoi)[k].refslot);
+          if (counter_blk[refslot] != -1 || !asoi->alloc_stack) not_counter[refslot] = true;
+          counter_blk[refslot] = blk;
+        }
+      }
+      if (instr_cur->type == INSTR_DEFINE_REFSLOT) {
+        not_counter[refslot_index_rt(uf, ((DefineRefslotInstr*) instr_cur)->target_refslot)] = true;
+      }
+      if (instr_cur->type == INSTR_CALL) {
+        CallInstr *ci = (CallInstr*) instr_cur;
+        if (ci->info.fn.kind == ARG_SLOT) slot_fn_reads[slot_index_rt(uf, ci->info.fn.slot)] ++;
+      }
+#define CHKSLOT_WRITE(SLOT) { int slot = slot_index_rt(uf, SLOT); slot_def[slot] = (slot_writes[slot]++ == 0) ? instr_cur : NULL; }
+#define CHKSLOT_READ(SLOT) slot_reads[slot_index_rt(uf, SLOT)] ++
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+      switch (instr_cur->type) {
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+      }
+#undef CASE
+#undef CHKSLOT_READ
+#undef CHKSLOT_WRITE
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+
+  // every write to a counter must keep it an int >= 0
+  bool frames_assigned = false;
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      if (instr_cur->type == INSTR_ASSIGN || instr_cur->type == INSTR_ASSIGN_STRING_KEY) {
+        Arg obj = (instr_cur->type == INSTR_ASSIGN)
+          ? ((AssignInstr*) instr_cur)->obj : ((AssignStringKeyInstr*) instr_cur)->obj;
+        if (obj.kind == ARG_SLOT && bitset_test(frame_slots, slot_index_rt(uf, obj.slot))) frames_assigned = true;
+      }
+      if (instr_cur->type == INSTR_ASSIGN_STRING_KEY) {
+        uint32_t hash = ((AssignStringKeyInstr*) instr_cur)->key.hash;
+        for (int k = 0; k < uf->refslots; ++k) if (refslot_key[k] == hash) not_counter[k] = true;
+      }
+#define CHKSLOT_REF_WRITE(REFSLOT) { \
+        int refslot = refslot_index_rt(uf, REFSLOT); \
+        if (instr_cur->type == INSTR_MOVE && ((MoveInstr*) instr_cur)->source.kind == ARG_VALUE \
+          && IS_INT(*((MoveInstr*) instr_cur)->source.value) && AS_INT(*((MoveInstr*) instr_cur)->source.value) >= 0 \
+        ) { \
+          if (blk == counter_blk[refslot]) counter_set[refslot] = true; \
+        } else if (instr_cur->type == INSTR_CALL && arg_refslot(uf, ((CallInstr*) instr_cur)->info.this_arg) == refslot \
+          && ((CallInstr*) instr_cur)->info.args_len == 1 \
+          && INFO_ARGS_PTR(&((CallInstr*) instr_cur)->info)[0].kind == ARG_VALUE \
+          && IS_INT(*INFO_ARGS_PTR(&((CallInstr*) instr_cur)->info)[0].value) \
+          && AS_INT(*INFO_ARGS_PTR(&((CallInstr*) instr_cur)->info)[0].value) == 1 \
+          && ((CallInstr*) instr_cur)->info.fn.kind == ARG_SLOT \
+          && is_lookup_on(uf, slot_def[slot_index_rt(uf, ((CallInstr*) instr_cur)->info.fn.slot)], refslot, _skey___add.hash) \
+        ) { \
+        } else not_counter[refslot] = true; \
+      }
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+      switch (instr_cur->type) {
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+      }
+#undef CASE
+#undef CHKSLOT_REF_WRITE
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+  // a counter holds an int wherever it's read, except in the block that allocates it
+  // (the int is set after the frame); we leave that block alone.
+  bool *counter = calloc(sizeof(bool), uf->refslots);
+  bool any_counter = false;
+  for (int i = 0; i < uf->refslots; ++i) {
+    counter[i] = !frames_assigned && counter_blk[i] != -1 && !not_counter[i] && counter_set[i];
+    any_counter |= counter[i];
+  }
+#define COUNTER_IN(ARG, BLK) (arg_refslot(uf, ARG) != -1 && counter[arg_refslot(uf, ARG)] \
+                              && counter_blk[arg_refslot(uf, ARG)] != (BLK))
+
+  // lookups on counters to constants
+  Value **slot_const = calloc(sizeof(Value*), uf->slots);
+  for (int blk = 0; blk < uf->body.blocks_len && any_counter; ++blk) {
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      if (instr_cur->type == INSTR_ACCESS_STRING_KEY) {
+        AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr_cur;
+        if (COUNTER_IN(aski->obj, blk) && aski->target.kind == ARG_SLOT
+          && slot_writes[slot_index_rt(uf, aski->target.slot)] == 1
+        ) {
+          bool key_found;
+          Value val = lookup_statically(int_base, aski->key, &key_found);
+          if (key_found) slot_const[slot_index_rt(uf, aski->target.slot)] = constant_pool_add(val);
+        }
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    new_block(&builder);
+
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      int instrsz = instr_size(instr_cur);
+      if (instr_cur->type == INSTR_ACCESS_STRING_KEY) {
+        AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr_cur;
+        if (aski->target.kind == ARG_SLOT && slot_const[slot_index_rt(uf, aski->target.slot)]) {
+          int slot = slot_index_rt(uf, aski->target.slot);
+          // only ever called: the calls take the constant, and the lookup goes away
+          if (slot_reads[slot] != slot_fn_reads[slot]) {
+            MoveInstr mi = {
+              .base = { .type = INSTR_MOVE },
+              .source = (Arg) { .kind = ARG_VALUE, .value = slot_const[slot] },
+              .target = aski->target,
+              .opt_info = my_asprintf("inlined lookup to '%s' on int counter", aski->key.key)
+            };
+            addinstr_like(&builder, &uf->body, instr_cur, sizeof(mi), (Instr*) &mi);
+          }
+          instr_cur = (Instr*) ((char*) instr_cur + instrsz);
+          continue;
+        }
+      }
+      if (instr_cur->type == INSTR_CALL) {
+        CallInstr *ci = (CallInstr*) instr_cur;
+        if (ci->info.fn.kind == ARG_SLOT && slot_const[slot_index_rt(uf, ci->info.fn.slot)]) {
+          CallInstr *ci_new = alloca(instrsz);
+          memcpy(ci_new, ci, instrsz);
+          ci_new->info.fn = (Arg) { .kind = ARG_VALUE, .value = slot_const[slot_index_rt(uf, ci->info.fn.slot)] };
+          addinstr_like(&builder, &uf->body, instr_cur, instrsz, (Instr*) ci_new);
+          instr_cur = (Instr*) ((char*) instr_cur + instrsz);
+          continue;
+        }
+      }
+      if (instr_cur->type == INSTR_ACCESS) {
+        AccessInstr *ai = (AccessInstr*) instr_cur;
+        if (COUNTER_IN(ai->key, blk)) {
+          AccessArrayIndexInstr aaii = {
+            .base = { .type = INSTR_ACCESS_ARRAY_INDEX },
+            .obj = ai->obj,
+            .key = ai->key,
+            .target = ai->target
+          };
+          addinstr_like(&builder, &uf->body, instr_cur, sizeof(aaii), (Instr*) &aaii);
+          instr_cur = (Instr*) ((char*) instr_cur + instrsz);
+          continue;
+        }
+      }
+      addinstr_like(&builder, &uf->body, instr_cur, instrsz, instr_cur);
+      instr_cur = (Instr*) ((char*) instr_cur + instrsz);
+    }
+  }
+#undef COUNTER_IN
+
+  free(refslot_key);
+  free(slot_def);
+  free(slot_writes);
+  free(slot_reads);
+  free(slot_fn_reads);
+  free(counter_blk);
+  free(not_counter);
+  free(counter_set);
+  free(counter);
+  free(slot_const);
+  bitset_free(frame_slots);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  return fn;
+}
+
+// the loop must be entered through a single block that just branches into it; -1 if it isn't
+static int loop_preheader(UserFunction *uf, int header) {
+  CFGNode *node = &analysis_cfg(uf)->nodes_ptr[header];
+  int preheader = -1;
+  for (int k = 0; k < node->pred_len; ++k) {
+    if (analysis_loop_contains(uf, header, node->pred_ptr[k])) continue;
+    if (preheader != -1) return -1;
+    preheader = node->pred_ptr[k];
+  }
+  if (preheader == -1 || block_last_instr(uf, preheader)->type != INSTR_BR) return -1;
+  return preheader;
+}
+
+// loop-invariant code motion for string key lookups.
+// a lookup moves into the block that enters the loop if its object and key can't change in the loop:
+// no call into unknown code, no dynamic assignment, no assignment to that key.
+// a lookup that misses runs the '[]' overload, so moving it would change how often that runs.
+// we only take lookups on a known object that always hit (typically outer-scope variables via
+// the context), and any other lookup in the loop counts as unknown code.
+UserFunction *hoist_loop_invariant_lookups(PassManager *pm, UserFunction *uf) {
+  uint32_t *refslot_key = find_refslot_keys(uf);
+  int *slot_writes = count_slot_writes(uf);
+
+  int instrs_len = (char*) uf->body.instrs_ptr_end - (char*) uf->body.instrs_ptr;
+  Bitset hoisted = bitset_alloc(instrs_len); // by byte offset
+  Instr **hoisted_ptr = NULL; int *hoisted_into_ptr = NULL; int hoisted_len = 0;
+  Bitset slot_written = bitset_alloc(uf->slots);
+  Bitset refslot_defined = bitset_alloc(uf->refslots);
+  uint32_t *clobbered_ptr = NULL; int clobbered_len = 0;
+
+  for (int header = 0; header < uf->body.blocks_len; ++header) {
+    if (!analysis_loop_contains(uf, header, header)) continue;
+
+    int preheader = loop_preheader(uf, header);
+    if (preheader == -1) continue;
+
+    bool unknown_effects = false;
+    bzero(slot_written.ptr, sizeof(uint64_t) * slot_written.len);
+    bzero(refslot_defined.ptr, sizeof(uint64_t) * refslot_defined.len);
+    clobbered_len = 0;
+#define CLOBBER(HASH) \
+    clobbered_ptr = realloc(clobbered_ptr, sizeof(uint32_t) * ++clobbered_len); \
+    clobbered_ptr[clobbered_len - 1] = (HASH)
+
+    for (int blk = 0; blk < uf->body.blocks_len && !unknown_effects; ++blk) {
+      if (!analysis_loop_contains(uf, header, blk)) continue;
+      Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+      while (instr_cur != instr_end) {
+        uint32_t keys_ptr[2]; int keys_len;
+        if (!instr_assigned_keys(pm, uf, refslot_key, instr_cur, keys_ptr, &keys_len)) {
+          unknown_effects = true;
+          break;
+        }
+        for (int k = 0; k < keys_len; ++k) { CLOBBER(keys_ptr[k]); }
+        if (instr_cur->type == INSTR_DEFINE_REFSLOT) {
+          bitset_set(refslot_defined, refslot_index_rt(uf, ((DefineRefslotInstr*) instr_cur)->target_refslot));
+        }
+        if (instr_cur->type == INSTR_ALLOC_STATIC_OBJECT) {
+          AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr_cur;
+          for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
+            bitset_set(refslot_defined, refslot_index_rt(uf, ASOI_INFO(asoi)[k].refslot));
+          }
+        }
+#define CHKSLOT_WRITE(SLOT) bitset_set(slot_written, slot_index_rt(uf, SLOT))
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+        switch (instr_cur->type) {
+          case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+            CASE(INSTR_LAST, Instr) abort();
+          } break;
+          default: assert("Unhandled Instruction Type!" && false);
+        }
+#undef CASE
+#undef CHKSLOT_WRITE
+        instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+      }
+    }
+#undef CLOBBER
+    if (unknown_effects) continue;
+
+    // header first, so its lookups are in order; hoisted targets become invariant for the ones after.
+    for (int i = -1; i < uf->body.blocks_len; ++i) {
+      int blk = (i == -1) ? header : i;
+      if (i == header || analysis_loop_header(uf, blk) != header) continue;
+      Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+      while (instr_cur != instr_end) {
+        Instr *instr_next = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+        if (instr_cur->type != INSTR_ACCESS_STRING_KEY) { instr_cur = instr_next; continue; }
+        AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr_cur;
+        if (aski->target.kind != ARG_SLOT || slot_writes[slot_index_rt(uf, aski->target.slot)] != 1
+          || key_in_list(clobbered_ptr, clobbered_len, aski->key.hash)
+        ) {
+          instr_cur = instr_next;
+          continue;
+        }
+        bool invariant = false;
+        if (aski->obj.kind == ARG_VALUE) {
+          invariant = true;
+        } else if (aski->obj.kind == ARG_SLOT) {
+          invariant = !bitset_test(slot_written, slot_index_rt(uf, aski->obj.slot));
+        } else {
+          int refslot = refslot_index_rt(uf, aski->obj.refslot);
+          invariant = !bitset_test(refslot_defined, refslot)
+            && !key_in_list(clobbered_ptr, clobbered_len, refslot_key[refslot]);
+        }
+        if (invariant && lookup_runs_no_code(pm, uf, aski)) {
+          bitset_set(hoisted, (char*) instr_cur - (char*) uf->body.instrs_ptr);
+          hoisted_ptr = realloc(hoisted_ptr, sizeof(Instr*) * (hoisted_len + 1));
+          hoisted_into_ptr = realloc(hoisted_into_ptr, sizeof(int) * (hoisted_len + 1));
+          hoisted_ptr[hoisted_len] = instr_cur;
+          hoisted_into_ptr[hoisted_len] = preheader;
+          hoisted_len ++;
+          bitset_clear(slot_written, slot_index_rt(uf, aski->target.slot));
+        }
+        instr_cur = instr_next;
+      }
+    }
+  }
+
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    new_block(&builder);
+
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    Instr *last = block_last_instr(uf, blk);
+    while (instr_cur != instr_end) {
+      if (instr_cur == last) {
+        for (int k = 0; k < hoisted_len; ++k) if (hoisted_into_ptr[k] == blk) {
+          addinstr_like(&builder, &uf->body, hoisted_ptr[k], instr_size(hoisted_ptr[k]), hoisted_ptr[k]);
+        }
+      }
+      if (!bitset_test(hoisted, (char*) instr_cur - (char*) uf->body.instrs_ptr)) {
+        addinstr_like(&builder, &uf->body, instr_cur, instr_size(instr_cur), instr_cur);
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+
+  free(refslot_key);
+  free(slot_writes);
+  free(hoisted_ptr);
+  free(hoisted_into_ptr);
+  free(clobbered_ptr);
+  bitset_free(hoisted);
+  bitset_free(slot_written);
+  bitset_free(refslot_defined);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  return fn;
+}
+
+// a function literal in a loop makes a new closure every iteration, but if its context
+// (the innermost frame at the point of definition) was created before the loop,
+// every one of them would be the same. so make it once, in the block that enters the loop,
+// moving out as many loops as the context allows.
+// sharing the closure is visible through identity and through fields set on it, by anyone who
+// gets to keep it. so we only hoist closures that are never used but as the function of a call
+// (and as its 'this', which a function that isn't a method can't see):
+// stored, pushed, returned or passed on, a closure stays where it is.
+UserFunction *hoist_loop_invariant_closures(PassManager *pm, UserFunction *uf) {
+  int *slot_writes = count_slot_writes(uf);
+  int *slot_def_blk = malloc(sizeof(int) * uf->slots);
+  for (int i = 0; i < uf->slots; i++) slot_def_blk[i] = -1;
+  // reads of each slot, how many of them are as the function of a call, and as 'this' of a call to it
+  int *slot_reads = calloc(sizeof(int), uf->slots);
+  int *slot_fn_reads = calloc(sizeof(int), uf->slots);
+  int *slot_self_this_reads = calloc(sizeof(int), uf->slots);
+
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      if (instr_cur->type == INSTR_CALL) {
+        CallInstr *ci = (CallInstr*) instr_cur;
+        if (ci->info.fn.kind == ARG_SLOT) {
+          int fn_slot = slot_index_rt(uf, ci->info.fn.slot);
+          slot_fn_reads[fn_slot] ++;
+          if (ci->info.this_arg.kind == ARG_SLOT && slot_index_rt(uf, ci->info.this_arg.slot) == fn_slot) {
+            slot_self_this_reads[fn_slot] ++;
+          }
+        }
+      }
+#define CHKSLOT_WRITE(SLOT) slot_def_blk[slot_index_rt(uf, SLOT)] = blk
+#define CHKSLOT_READ(SLOT) slot_reads[slot_index_rt(uf, SLOT)] ++
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+      switch (instr_cur->type) {
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+      }
+#undef CASE
+#undef CHKSLOT_READ
+#undef CHKSLOT_WRITE
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+
+  int instrs_len = (char*) uf->body.instrs_ptr_end - (char*) uf->body.instrs_ptr;
+  Bitset hoisted = bitset_alloc(instrs_len); // by byte offset
+  Instr **hoisted_ptr = NULL; int *hoisted_into_ptr = NULL; int hoisted_len = 0;
+
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    while (instr_cur != instr_end) {
+      Instr *instr_next = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+      if (instr_cur->type != INSTR_ALLOC_CLOSURE_OBJECT) { instr_cur = instr_next; continue; }
+      AllocClosureObjectInstr *acoi = (AllocClosureObjectInstr*) instr_cur;
+      int context = slot_index_rt(uf, acoi->context_slot);
+      int target = (acoi->target.kind == ARG_SLOT) ? slot_index_rt(uf, acoi->target.slot) : -1;
+      if (target == -1 || slot_writes[target] != 1
+        || slot_reads[target] != slot_fn_reads[target] + slot_self_this_reads[target]
+        || (slot_self_this_reads[target] && acoi->fn->is_method)
+        || slot_writes[context] > 1
+      ) {
+        instr_cur = instr_next;
+        continue;
+      }
+      int target_blk = -1;
+      for (int header = analysis_loop_header(uf, blk); header != -1; ) {
+        int preheader = loop_preheader(uf, header);
+        if (preheader == -1) break;
+        if (slot_def_blk[context] != -1 && analysis_loop_contains(uf, header, slot_def_blk[context])) break;
+        target_blk = preheader;
+        header = analysis_loop_header(uf, preheader);
+      }
+      if (target_blk != -1) {
+        bitset_set(hoisted, (char*) instr_cur - (char*) uf->body.instrs_ptr);
+        hoisted_ptr = realloc(hoisted_ptr, sizeof(Instr*) * (hoisted_len + 1));
+        hoisted_into_ptr = realloc(hoisted_into_ptr, sizeof(int) * (hoisted_len + 1));
+        hoisted_ptr[hoisted_len] = instr_cur;
+        hoisted_into_ptr[hoisted_len] = target_blk;
+        hoisted_len ++;
+      }
+      instr_cur = instr_next;
+    }
+  }
+
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int blk = 0; blk < uf->body.blocks_len; ++blk) {
+    new_block(&builder);
+
+    Instr *instr_cur = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+    Instr *last = block_last_instr(uf, blk);
+    while (instr_cur != instr_end) {
+      if (instr_cur == last) {
+        for (int k = 0; k < hoisted_len; ++k) if (hoisted_into_ptr[k] == blk) {
+          addinstr_like(&builder, &uf->body, hoisted_ptr[k], instr_size(hoisted_ptr[k]), hoisted_ptr[k]);
+        }
+      }
+      if (!bitset_test(hoisted, (char*) instr_cur - (char*) uf->body.instrs_ptr)) {
+        addinstr_like(&builder, &uf->body, instr_cur, instr_size(instr_cur), instr_cur);
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+
+  free(slot_writes);
+  free(slot_def_blk);
+  free(hoisted_ptr);
+  free(hoisted_into_ptr);
+  free(slot_reads);
+  free(slot_fn_reads);
+  free(slot_self_this_reads);
+  bitset_free(hoisted);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  return fn;
+}
+
+void fixup_refslots(UserFunction *uf, int delta) {
+  assert(uf->resolved);
+  analysis_invalidate(uf);
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+#define CHKSLOT_REF(SLOT) SLOT.offset += delta;
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+      switch (instr_cur->type) {
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+      }
+#undef CASE
+#undef CHKSLOT_REF
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+}
+
+// which stack/heap frames (scope objects) can we see all uses of?
+// a frame is "tracked" if its slot is written once, by its allocation.
+typedef struct {
+  bool *tracked;
+  int *parent; // slot of the parent frame, or -1
+  AllocStaticObjectInstr **asoi; // for the keys; NULL for plain allocs
+  bool *blocked; // someone but our refslots may see the entries
+} ScopeChains;
+
+// the chain starting at slot is visible to someone else: nothing in it may be promoted
+static void scope_chain_escapes(ScopeChains *chains, int slot) {
+  for (; slot != -1 && chains->tracked[slot]; slot = chains->parent[slot]) chains->blocked[slot] = true;
+}
+
+// a lookup of hash on the frame in slot only reaches the closest frame that has the key
+static void scope_chain_key_used(ScopeChains *chains, int slot, uint32_t hash) {
+  for (; slot != -1 && chains->tracked[slot]; slot = chains->parent[slot]) {
+    AllocStaticObjectInstr *asoi = chains->asoi[slot];
+    if (!asoi) continue;
+    for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
+      if (ASOI_INFO(asoi)[k].key.hash == hash) {
+        chains->blocked[slot] = true;
+        return;
+      }
+    }
+  }
+}
+
+static void scope_slot_read(UserFunction *uf, ScopeChains *chains, Instr *instr, int slot) {
+  if (!chains->tracked[slot]) return;
+  switch (instr->type) {
+    case INSTR_FREE_OBJECT: case INSTR_CLOSE_OBJECT:
+      return;
+    case INSTR_ALLOC_OBJECT: {
+      AllocObjectInstr *aoi = (AllocObjectInstr*) instr;
+      if (chains->tracked[slot_index_rt(uf, aoi->target_slot)]) return;
+      break;
+    }
+    case INSTR_ALLOC_STATIC_OBJECT: {
+      AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr;
+      bool stored = false; // frame stored as a field value, rather than used as parent
+      for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
+        if (slot_index_rt(uf, ASOI_INFO(asoi)[k].slot) == slot) stored = true;
+      }
+      if (!stored && chains->tracked[slot_index_rt(uf, asoi->target_slot)]) return;
+      break;
+    }
+    case INSTR_ACCESS_STRING_KEY:
+      scope_chain_key_used(chains, slot, ((AccessStringKeyInstr*) instr)->key.hash);
+      return;
+    case INSTR_ASSIGN_STRING_KEY: {
+      AssignStringKeyInstr *aski = (AssignStringKeyInstr*) instr;
+      if (aski->value.kind == ARG_SLOT && slot_index_rt(uf, aski->value.slot) == slot) break;
+      scope_chain_key_used(chains, slot, aski->key.hash);
+      return;
+    }
+    case INSTR_DEFINE_REFSLOT:
+      scope_chain_key_used(chains, slot, ((DefineRefslotInstr*) instr)->key.hash);
+      return;
+    default: break;
+  }
+  scope_chain_escapes(chains, slot);
+}
+
+// every `var` gets a frame object of its own, and access_vars_via_refslots leaves us reading
+// and writing its entries through refslots. if no closure, call or dynamic lookup can see a frame,
+// or any frame below it, only those refslots ever touch its entries: turn them into plain slots.
+// variables that are captured keep their frames, since every declaration (every loop iteration)
+// must be seen as a variable of its own.
+// WARNING
+// the promoted slots are written more than once, so this makes the IR **NON-SSA**.
+// only free_stack_objects_early and compactify_registers (which pins them) may come after.
+UserFunction *promote_frame_vars_to_slots(PassManager *pm, UserFunction *uf) {
+  int *slot_writes = count_slot_writes(uf);
+  ScopeChains chains = {
+    .tracked = calloc(sizeof(bool), uf->slots),
+    .parent = malloc(sizeof(int) * uf->slots),
+    .asoi = calloc(sizeof(AllocStaticObjectInstr*), uf->slots),
+    .blocked = calloc(sizeof(bool), uf->slots)
+  };
+  bool *refslot_redefined = calloc(sizeof(bool), uf->refslots);
+
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+      int target = -1, parent = -1;
+      if (instr_cur->type == INSTR_ALLOC_OBJECT) {
+        AllocObjectInstr *aoi = (AllocObjectInstr*) instr_cur;
+        target = slot_index_rt(uf, aoi->target_slot);
+        parent = slot_index_rt(uf, aoi->parent_slot);
+      } else if (instr_cur->type == INSTR_ALLOC_STATIC_OBJECT) {
+        AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr_cur;
+        target = slot_index_rt(uf, asoi->target_slot);
+        parent = slot_index_rt(uf, asoi->parent_slot);
+        chains.asoi[target] = asoi;
+      } else if (instr_cur->type == INSTR_DEFINE_REFSLOT) {
+        refslot_redefined[refslot_index_rt(uf, ((DefineRefslotInstr*) instr_cur)->target_refslot)] = true;
+      }
+      if (target != -1 && slot_writes[target] == 1) {
+        chains.tracked[target] = true;
+        chains.parent[target] = parent;
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+#define CHKSLOT_READ_RW(S) scope_slot_read(uf, &chains, instr_cur, slot_index_rt(uf, S))
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+      switch (instr_cur->type) {
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+      }
+#undef CASE
+#undef CHKSLOT_READ_RW
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+
+  // the new slots go after the existing ones; the refslots are moved up to make room below
+  int promoted = 0;
+  bool *refslot_promoted = calloc(sizeof(bool), uf->refslots);
+  Slot *promoted_slot = calloc(sizeof(Slot), uf->refslots);
+  for (int i = 0; i < uf->slots; i++) {
+    if (!chains.tracked[i] || chains.blocked[i] || !chains.asoi[i]) continue;
+    AllocStaticObjectInstr *asoi = chains.asoi[i];
+    for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
+      int refslot = refslot_index_rt(uf, ASOI_INFO(asoi)[k].refslot);
+      // writes through the refslot check the constraint
+      if (ASOI_INFO(asoi)[k].constraint || refslot_redefined[refslot]) continue;
+      Slot slot = (Slot) { .index = uf->slots + promoted++ };
+      slot.offset = slot_to_offset(uf, slot);
+#ifndef NDEBUG
+      slot.is_resolved = true;
+#endif
+      refslot_promoted[refslot] = true;
+      promoted_slot[refslot] = slot;
+    }
+  }
+
+  free(slot_writes);
+  free(chains.tracked);
+  free(chains.parent);
+  free(chains.asoi);
+  free(chains.blocked);
+  free(refslot_redefined);
+
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    new_block(&builder);
+
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+      int instrsz = instr_size(instr_cur);
+      Instr *instr_new = alloca(instrsz);
+      memcpy(instr_new, instr_cur, instrsz);
+#define PROMOTE_REFSLOT(X) \
+      if ((X).kind == ARG_REFSLOT && refslot_promoted[refslot_index_rt(uf, (X).refslot)]) { \
+        Slot slot = promoted_slot[refslot_index_rt(uf, (X).refslot)]; \
+        (X).kind = ARG_SLOT; \
+        (X).slot = slot; \
+      }
+#define READ_SLOT(X) PROMOTE_REFSLOT(X)
+#define WRITE_SLOT(X) PROMOTE_REFSLOT(X)
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_new; (void) instr;
+      switch (instr_new->type) {
+        case INSTR_INVALID: { abort();
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+      }
+#undef CASE
+#undef WRITE_SLOT
+#undef READ_SLOT
+#undef PROMOTE_REFSLOT
+      addinstr_like(&builder, &uf->body, instr_cur, instrsz, instr_new);
+
+      if (instr_cur->type == INSTR_ALLOC_STATIC_OBJECT) {
+        // every time the frame is allocated, the variable starts over
+        AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr_cur;
+        for (int k = 0; k < asoi->tbl.entries_stored; ++k) {
+          int refslot = refslot_index_rt(uf, ASOI_INFO(asoi)[k].refslot);
+          if (!refslot_promoted[refslot]) continue;
+          MoveInstr mi = {
+            .base = { .type = INSTR_MOVE },
+            .source = (Arg) { .kind = ARG_SLOT, .slot = ASOI_INFO(asoi)[k].slot },
+            .target = (WriteArg) { .kind = ARG_SLOT, .slot = promoted_slot[refslot] },
+            .opt_info = my_asprintf("promoted var '%s'", ASOI_INFO(asoi)[k].key.key)
+          };
+          addinstr_like(&builder, &uf->body, instr_cur, sizeof(mi), (Instr*) &mi);
+        }
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instrsz);
+    }
+  }
+  free(refslot_promoted);
+  free(promoted_slot);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  if (promoted) {
+    fn->slots = uf->slots + promoted;
+    fn->non_ssa = true;
+    fixup_refslots(fn, promoted * sizeof(Value));
+  }
+  return fn;
+}
+
+// WARNING
+// this function makes the IR **NON-SSA**
+// and thus it **MUST** come completely last!!
+UserFunction *compactify_registers(PassManager *pm, UserFunction *uf) {
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  CFG *cfg = analysis_cfg(uf);
+  DataflowProblem liveness;
+  dataflow_slot_liveness(&liveness, cfg, uf);
+
+  bool *slot_inuse = calloc(sizeof(bool), uf->slots);
+  int *slot_map = calloc(sizeof(int), uf->slots);
+  Instr **blk_last_access = calloc(sizeof(Instr*), uf->slots);
+
+  // specials
+  int special_slots = 2 + uf->arity;
+  for (int i = 0; i < special_slots; ++i) {
+    slot_inuse[i] = true;
+    slot_map[i] = i;
+  }
+
+  // slots written more than once (see promote_frame_vars_to_slots) keep a register for the whole function
+  int *slot_writes = count_slot_writes(uf);
+  bool *slot_pinned = calloc(sizeof(bool), uf->slots);
+  int fixed_slots = special_slots;
+  for (int i = special_slots; i < uf->slots; ++i) if (slot_writes[i] > 1) {
+    slot_pinned[i] = true;
+    slot_inuse[fixed_slots] = true;
+    slot_map[i] = fixed_slots++;
+  }
+  free(slot_writes);
+
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    new_block(&builder);
+
+    memset(slot_inuse + fixed_slots, 0, sizeof(bool) * (uf->slots - fixed_slots));
+    for (int k = special_slots; k < uf->slots; k++) {
+      if (bitset_test(liveness.in_ptr[i], k)) slot_inuse[slot_map[k]] = true;
+    }
+    /*
+    fprintf(stderr, "updating block %i:\n", i);
+    for (int k = special_slots; k < uf->slots; k++) {
+      if (slot_inuse[k]) fprintf(stderr, "| %i in use.\n", k);
+    }
+    */
+    // precomp first/last access per instr inside the block, for slots that don't escape the block
+    {
+      Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+      while (instr_cur != instr_end) {
+        switch (instr_cur->type) {
+#define CASE(KEY, TY) } break; case KEY: { TY *instr = (TY*) instr_cur; (void) instr;
+#define CHKSLOT_READ(S) blk_last_access[slot_index_rt(uf, S)] = instr_cur;
+#define CHKSLOT_WRITE(S) blk_last_access[slot_index_rt(uf, S)] = instr_cur;
+          case INSTR_INVALID: { abort(); Instr *instr = NULL; (void) instr;
+#include "vm/slots.txt"
+            CASE(INSTR_LAST, Instr) abort();
+          } break;
+          default: assert("Unhandled Instruction Type!" && false);
+#undef CHKSLOT_READ
+#undef CHKSLOT_WRITE
+#undef CASE
+        }
+        instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+      }
+    }
+
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+      switch (instr_cur->type) {
+#define CASE(KEY, TY) \
+          use_range_start(&builder, instr_belongs_to(&uf->body, instr_cur));\
+          addinstr(&builder, sz, (Instr*) instr);\
+          use_range_end(&builder, instr_belongs_to(&uf->body, instr_cur));\
+          instr_cur = (Instr*) ((char*) instr_cur + sz);\
+          continue;\
+        }\
+        case KEY: {\
+          int sz = instr_size(instr_cur);\
+          TY *instr = (TY*) alloca(sz);\
+          memcpy(instr, instr_cur, sz);
+
+#define CHKSLOT_READ_RW(S) reassign_slot(uf, &S, true, special_slots, slot_pinned[slot_index_rt(uf, S)],\
+                                      instr_cur == blk_last_access[slot_index_rt(uf, S)], slot_inuse, slot_map, liveness.out_ptr[i])
+#define CHKSLOT_WRITE_RW(S) reassign_slot(uf, &S, false, special_slots, slot_pinned[slot_index_rt(uf, S)],\
+                                       instr_cur == blk_last_access[slot_index_rt(uf, S)], slot_inuse, slot_map, liveness.out_ptr[i])
+
+        case INSTR_INVALID: { abort(); Instr *instr = NULL; int sz = 0;
+#include "vm/slots.txt"
+          CASE(INSTR_LAST, Instr) abort();
+        } break;
+        default: assert("Unhandled Instruction Type!" && false);
+
+#undef CHKSLOT_READ_RW
+#undef CHKSLOT_WRITE_RW
+#undef CASE
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instr_size(instr_cur));
+    }
+  }
+
+  int maxslot = 0;
+  for (int i = 0; i < uf->slots; ++i) if (slot_map[i] > maxslot) maxslot = slot_map[i];
+  free(blk_last_access);
+  free(slot_inuse);
+  free(slot_map);
+  free(slot_pinned);
+  dataflow_destroy(&liveness);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  int old_slots = uf->slots;
+  fn->slots = maxslot + 1;
+  fn->non_ssa = true;
+
+  fixup_refslots(fn, (fn->slots - old_slots) * sizeof(Value));
+  // dump_fn(NULL, fn);
+  return fn;
+}
+
+UserFunction *remove_pointless_blocks(PassManager *pm, UserFunction *uf) {
+  CFG *cfg = analysis_cfg(uf);
+
+  bool *blk_live = calloc(sizeof(bool), uf->body.blocks_len);
+  blk_live[0] = true;
+
+  bool changed;
+  do {
+    changed = false;
+    // yes yes, you can construct a pathological graph of blocks, who cares
+    // the language doesn't have goto anyways
+    for (int i = 0; i < uf->body.blocks_len; ++i) {
+      if (blk_live[i]) {
+        for (int k = 0; k < cfg->nodes_ptr[i].succ_len; ++k) {
+          bool *liveflag = &blk_live[cfg->nodes_ptr[i].succ_ptr[k]];
+          if (!*liveflag) {
+            *liveflag = true;
+            changed = true;
+          }
+        }
+      }
+    }
+  } while (changed);
+
+  int *blk_map = calloc(sizeof(int), uf->body.blocks_len);
+
+  int k = 0;
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    if (blk_live[i]) blk_map[i] = k++;
+    else blk_map[i] = -1;
+  }
+
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    if (!blk_live[i]) continue;
+
+    new_block(&builder);
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+      if (instr_cur->type == INSTR_BR) {
+        BranchInstr *instr = (BranchInstr*) instr_cur;
+        BranchInstr bri = *instr;
+        bri.blk = blk_map[bri.blk];
+        addinstr_like(&builder, &uf->body, instr_cur, sizeof(bri), (Instr*) &bri);
+        instr_cur = (Instr*) (instr + 1);
         continue;
       }
       if (instr_cur->type == INSTR_TESTBR) {
@@ -2403,73 +3495,494 @@ UserFunction *remove_pointless_blocks(UserFunction *uf) {
     }
   }
 
-  cfg_destroy(&cfg);
   free(blk_live);
   free(blk_map);
 
   UserFunction *fn = build_function(&builder);
   copy_fn_stats(uf, fn);
-  free_function(uf);
   return fn;
 }
 
-UserFunction *optimize_runtime(VMState *state, UserFunction *uf, Object *context) {
-  if (uf->num_optimized > 5) {
-    return uf;
+// the phis at the start of a block, if that's the only place it has any
+static int leading_phis(UserFunction *uf, int blk) {
+  Instr *instr = BLOCK_START(uf, blk), *instr_end = BLOCK_END(uf, blk);
+  int phis = 0;
+  while (instr != instr_end && instr->type == INSTR_PHI) {
+    phis ++;
+    instr = (Instr*) ((PhiInstr*) instr + 1);
   }
-  if (uf->num_optimized == 5) {
-    // vm_print_backtrace(state);
-    fprintf(stderr, "function optimized too many times.\n");
-    // __asm__("int $3");
+  for (; instr != instr_end; instr = (Instr*) ((char*) instr + instr_size(instr))) {
+    if (instr->type == INSTR_PHI) return -1;
   }
-  uf->num_optimized ++;
+  return phis;
+}
 
-  if (uf->non_ssa != false) {
-    fprintf(stderr, "called optimizer on function that is non-ssa!\n");
-    abort();
+// what the phis of blk would do when arriving from pred, as moves
+static void add_phi_moves(FunctionBuilder *builder, UserFunction *uf, int blk, int pred) {
+  PhiInstr *phi = (PhiInstr*) BLOCK_START(uf, blk), *phi_end = (PhiInstr*) BLOCK_END(uf, blk);
+  for (; phi != phi_end && phi->base.type == INSTR_PHI; phi++) {
+    Arg source = (phi->block1 == pred) ? phi->arg1 : phi->arg2;
+    if (source.kind == ARG_SLOT && phi->target.kind == ARG_SLOT
+      && slot_index_rt(uf, source.slot) == slot_index_rt(uf, phi->target.slot)) continue;
+    MoveInstr mi = {
+      .base = { .type = INSTR_MOVE },
+      .source = source,
+      .target = phi->target,
+      .opt_info = my_asprintf("phi from <%i>", pred)
+    };
+    addinstr_like(builder, &uf->body, (Instr*) phi, sizeof(mi), (Instr*) &mi);
   }
+}
 
-  assert(uf->resolved);
+// WARNING
+// the phi targets get one write per incoming edge, so this must come after compactify_registers.
+// replaces the phis with moves at the end of each predecessor. the phis run one after another
+// on block entry, so doing the same moves in the same order right before the jump is equivalent.
+// a predecessor ending in a testbr has another successor that must not see the moves,
+// so that edge gets a new block of its own (appended at the end, to keep the block ids).
+// without phis, branches don't need to keep frame->block and prev_block current; see phi_free.
+UserFunction *lower_phis_to_moves(PassManager *pm, UserFunction *uf) {
+  CFG *cfg = analysis_cfg(uf);
+  int blocks_len = uf->body.blocks_len;
+  bool *lower = calloc(sizeof(bool), blocks_len);
+  bool phi_free = true;
+  for (int i = 0; i < blocks_len; ++i) {
+    int phis = leading_phis(uf, i);
+    if (phis == 0) continue;
+    lower[i] = phis > 0;
+    // every way in must be one the phis know about
+    for (int k = 0; lower[i] && k < cfg->nodes_ptr[i].pred_len; ++k) {
+      int pred = cfg->nodes_ptr[i].pred_ptr[k];
+      PhiInstr *phi = (PhiInstr*) BLOCK_START(uf, i);
+      for (int l = 0; l < phis; l++) if (phi[l].block1 != pred && phi[l].block2 != pred) lower[i] = false;
+    }
+    if (!lower[i]) phi_free = false;
+  }
 
-  /*
-  printf("runtime optimize %s with %p\n", uf->name, (void*) context);
-  if (uf->name && strcmp(uf->name, "gear") == 0) print_recursive(state, context, false);
-  printf("\n-----\n");
-  */
+  // edges that get a block of their own: split_from[n] -> split_to[n] is block blocks_len + n
+  int *split_from = NULL, *split_to = NULL, splits_len = 0;
+
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int i = 0; i < blocks_len; ++i) {
+    new_block(&builder);
+
+    Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    for (; instr != instr_end; instr = (Instr*) ((char*) instr + instr_size(instr))) {
+      if (instr->type == INSTR_PHI && lower[i]) continue;
+      if (instr->type == INSTR_BR) {
+        BranchInstr *bri = (BranchInstr*) instr;
+        if (lower[bri->blk]) add_phi_moves(&builder, uf, bri->blk, i);
+      }
+      if (instr->type == INSTR_TESTBR) {
+        TestBranchInstr tbri = *(TestBranchInstr*) instr;
+        int *blk_ptrs[] = { &tbri.true_blk, &tbri.false_blk };
+        for (int k = 0; k < 2; k++) {
+          int target = *blk_ptrs[k];
+          if (!lower[target]) continue;
+          if (k == 1 && tbri.true_blk >= blocks_len && split_to[tbri.true_blk - blocks_len] == target) {
+            *blk_ptrs[k] = tbri.true_blk; // both ways go to the same block
+            continue;
+          }
+          split_from = realloc(split_from, sizeof(int) * (splits_len + 1));
+          split_to = realloc(split_to, sizeof(int) * (splits_len + 1));
+          split_from[splits_len] = i;
+          split_to[splits_len] = target;
+          *blk_ptrs[k] = blocks_len + splits_len++;
+        }
+        addinstr_like(&builder, &uf->body, instr, sizeof(tbri), (Instr*) &tbri);
+        continue;
+      }
+      addinstr_like(&builder, &uf->body, instr, instr_size(instr), instr);
+    }
+  }
+
+  for (int n = 0; n < splits_len; ++n) {
+    new_block(&builder);
+    add_phi_moves(&builder, uf, split_to[n], split_from[n]);
+    BranchInstr bri = {
+      .base = { .type = INSTR_BR },
+      .blk = split_to[n]
+    };
+    addinstr_like(&builder, &uf->body, block_last_instr(uf, split_from[n]), sizeof(bri), (Instr*) &bri);
+  }
+
+  free(lower);
+  free(split_from);
+  free(split_to);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  fn->non_ssa = true;
+  fn->phi_free = phi_free;
+  return fn;
+}
+
+// the successors of blk in the order we'd like to fall through to them, most taken first.
+// an edge that was never taken while the function warmed up, when the other one was, is cold (-1).
+static void profiled_successors(UserFunction *uf, int blk, int *first_p, int *second_p) {
+  *first_p = *second_p = -1;
+  Instr *last = block_last_instr(uf, blk);
+  if (last->type == INSTR_BR) {
+    *first_p = ((BranchInstr*) last)->blk;
+  } else if (last->type == INSTR_TESTBR) {
+    TestBranchInstr *tbr = (TestBranchInstr*) last;
+    bool seen = tbr->true_count || tbr->false_count;
+    bool true_first = tbr->true_count >= tbr->false_count;
+    int first = true_first ? tbr->true_blk : tbr->false_blk;
+    int second = true_first ? tbr->false_blk : tbr->true_blk;
+    unsigned int second_count = true_first ? tbr->false_count : tbr->true_count;
+    *first_p = first;
+    if (!seen || second_count) *second_p = second;
+  }
+}
+
+// blocks come out of the compiler in parse order, so rarely taken branches sit in the middle of loops.
+// lay them out again following the branch counts from the unoptimized function:
+// chain every block to its most taken successor, so the hot path falls through,
+// and move blocks only reachable over cold edges to the end.
+// block ids change, so this must come after everything that keeps block ids around (compactify_registers
+// also expects definitions to come before uses in block order).
+UserFunction *layout_blocks_by_profile(PassManager *pm, UserFunction *uf) {
+  int blocks_len = uf->body.blocks_len;
+  bool *hot = calloc(sizeof(bool), blocks_len);
+  bool *placed = calloc(sizeof(bool), blocks_len);
+  int *order = malloc(sizeof(int) * blocks_len), order_len = 0;
+  int *blk_map = malloc(sizeof(int) * blocks_len);
+
+  int *worklist = malloc(sizeof(int) * blocks_len), worklist_len = 0;
+  hot[0] = true;
+  worklist[worklist_len++] = 0;
+  while (worklist_len) {
+    int succ[2];
+    profiled_successors(uf, worklist[--worklist_len], &succ[0], &succ[1]);
+    for (int k = 0; k < 2; k++) if (succ[k] != -1 && !hot[succ[k]]) {
+      hot[succ[k]] = true;
+      worklist[worklist_len++] = succ[k];
+    }
+  }
+  free(worklist);
+
+  int next_unplaced = 0;
+  for (int blk = 0; blk != -1; ) {
+    placed[blk] = true;
+    order[order_len++] = blk;
+    int first, second;
+    profiled_successors(uf, blk, &first, &second);
+    if (first != -1 && !placed[first]) blk = first;
+    else if (second != -1 && !placed[second]) blk = second;
+    else {
+      // start a new chain at the first hot block left over
+      while (next_unplaced < blocks_len && (placed[next_unplaced] || !hot[next_unplaced])) next_unplaced++;
+      blk = (next_unplaced < blocks_len) ? next_unplaced : -1;
+    }
+  }
+  for (int blk = 0; blk < blocks_len; ++blk) if (!placed[blk]) order[order_len++] = blk;
+  assert(order_len == blocks_len);
+  for (int i = 0; i < blocks_len; ++i) blk_map[order[i]] = i;
+
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int i = 0; i < blocks_len; ++i) {
+    new_block(&builder);
+
+    Instr *instr_cur = BLOCK_START(uf, order[i]), *instr_end = BLOCK_END(uf, order[i]);
+    while (instr_cur != instr_end) {
+      int instrsz = instr_size(instr_cur);
+      if (instr_cur->type == INSTR_BR) {
+        BranchInstr bri = *(BranchInstr*) instr_cur;
+        bri.blk = blk_map[bri.blk];
+        addinstr_like(&builder, &uf->body, instr_cur, sizeof(bri), (Instr*) &bri);
+      } else if (instr_cur->type == INSTR_TESTBR) {
+        TestBranchInstr tbri = *(TestBranchInstr*) instr_cur;
+        tbri.true_blk = blk_map[tbri.true_blk];
+        tbri.false_blk = blk_map[tbri.false_blk];
+        addinstr_like(&builder, &uf->body, instr_cur, sizeof(tbri), (Instr*) &tbri);
+      } else if (instr_cur->type == INSTR_PHI) {
+        PhiInstr phi = *(PhiInstr*) instr_cur;
+        phi.block1 = blk_map[phi.block1];
+        phi.block2 = blk_map[phi.block2];
+        addinstr_like(&builder, &uf->body, instr_cur, sizeof(phi), (Instr*) &phi);
+      } else {
+        addinstr_like(&builder, &uf->body, instr_cur, instrsz, instr_cur);
+      }
+      instr_cur = (Instr*) ((char*) instr_cur + instrsz);
+    }
+  }
+
+  free(hot);
+  free(placed);
+  free(order);
+  free(blk_map);
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  fn->non_ssa = uf->non_ssa;
+  return fn;
+}
+
+// does the value in slot go straight to a return from instr on, with nothing else happening?
+// frees are fine, since the tail call frees our stack objects anyway.
+static bool returned_right_away(UserFunction *uf, Instr *instr, int slot) {
+  for (int hops = 0; hops < 4; ) {
+    switch (instr->type) {
+      case INSTR_FREE_OBJECT: break;
+      case INSTR_MOVE: {
+        MoveInstr *mi = (MoveInstr*) instr;
+        if (mi->source.kind != ARG_SLOT || slot_index_rt(uf, mi->source.slot) != slot) return false;
+        if (mi->target.kind != ARG_SLOT) return false;
+        slot = slot_index_rt(uf, mi->target.slot);
+        break;
+      }
+      case INSTR_BR:
+        instr = BLOCK_START(uf, ((BranchInstr*) instr)->blk);
+        hops++;
+        continue;
+      case INSTR_RETURN: {
+        ReturnInstr *ri = (ReturnInstr*) instr;
+        return ri->ret.kind == ARG_SLOT && slot_index_rt(uf, ri->ret.slot) == slot;
+      }
+      default: return false;
+    }
+    instr = (Instr*) ((char*) instr + instr_size(instr));
+  }
+  return false;
+}
+
+// a call whose result we return right away doesn't need our frame anymore: mark it as a tail call,
+// so the callee replaces our frame instead of stacking on top of it (see vm_instr_call_tail).
+// that way, recursion in tail position runs in constant stack space. we lose the frame from backtraces.
+UserFunction *mark_tail_calls(PassManager *pm, UserFunction *uf) {
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    new_block(&builder);
+
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+      int instrsz = instr_size(instr_cur);
+      Instr *instr_next = (Instr*) ((char*) instr_cur + instrsz);
+      if (instr_cur->type == INSTR_CALL) {
+        CallInstr *ci = (CallInstr*) instr_cur;
+        if (ci->info.target.kind == ARG_SLOT && instr_next != instr_end
+          && returned_right_away(uf, instr_next, slot_index_rt(uf, ci->info.target.slot)))
+        {
+          CallInstr *ci_new = alloca(instrsz);
+          memcpy(ci_new, ci, instrsz);
+          ci_new->tail = true;
+          addinstr_like(&builder, &uf->body, instr_cur, instrsz, (Instr*) ci_new);
+          instr_cur = instr_next;
+          continue;
+        }
+      }
+      addinstr_like(&builder, &uf->body, instr_cur, instrsz, instr_cur);
+      instr_cur = instr_next;
+    }
+  }
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  fn->non_ssa = uf->non_ssa;
+  return fn;
+}
+
+// which pairs we have combined handlers for; picked from jerboa -ps on typical loops
+static bool instrs_fuse(Instr *first, Instr *second, FusedKind *kind) {
+  if (first->type == INSTR_TEST && second->type == INSTR_TESTBR) {
+    TestInstr *test = (TestInstr*) first;
+    TestBranchInstr *testbr = (TestBranchInstr*) second;
+    if (test->target.kind == ARG_SLOT && testbr->test.kind == ARG_SLOT
+      && test->target.slot.index == testbr->test.slot.index)
+    {
+      *kind = FUSED_TEST_TESTBR;
+      return true;
+    }
+    return false;
+  }
+  // the fused handler runs the call itself, so it would skip the tail call
+  if (first->type == INSTR_ACCESS_STRING_KEY && second->type == INSTR_CALL && !((CallInstr*) second)->tail) {
+    *kind = FUSED_ACCESS_STRING_KEY_CALL;
+    return true;
+  }
+  if (first->type == INSTR_ACCESS_STRING_KEY && second->type == INSTR_ACCESS_STRING_KEY) {
+    *kind = FUSED_ACCESS_STRING_KEY_2;
+    return true;
+  }
+  if (first->type == INSTR_MOVE && second->type == INSTR_MOVE) {
+    *kind = FUSED_MOVE_2;
+    return true;
+  }
+  return false;
+}
+
+// pack common pairs of instrs into INSTR_FUSED, so they're run by one handler
+// passes don't look inside fused instrs, so this has to come after all of them
+UserFunction *fuse_instructions(PassManager *pm, UserFunction *uf) {
+  FunctionBuilder builder = {0};
+  builder.block_terminated = true;
+
+  for (int i = 0; i < uf->body.blocks_len; ++i) {
+    new_block(&builder);
+
+    Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
+    while (instr_cur != instr_end) {
+      int instrsz = instr_size(instr_cur);
+      Instr *instr_next = (Instr*) ((char*) instr_cur + instrsz);
+      FusedKind kind;
+      if (instr_next != instr_end && instrs_fuse(instr_cur, instr_next, &kind)) {
+        int nextsz = instr_size(instr_next);
+        int size = sizeof(FusedInstr) + instrsz + nextsz;
+        FusedInstr *instr_new = alloca(size);
+        instr_new->base.type = INSTR_FUSED;
+        instr_new->size = size;
+        instr_new->kind = kind;
+        memcpy(FUSED_PARTS(instr_new), instr_cur, instrsz);
+        memcpy((char*) FUSED_PARTS(instr_new) + instrsz, instr_next, nextsz);
+        addinstr_like(&builder, &uf->body, instr_cur, size, (Instr*) instr_new);
+
+        // the parts keep their own ranges, for errors raised while running them
+        Instr *part_new = (Instr*) ((char*) builder.body.instrs_ptr_end - instrsz - nextsz);
+        set_range_from(&builder, part_new, instr_belongs_to(&uf->body, instr_cur));
+        part_new = (Instr*) ((char*) part_new + instrsz);
+        set_range_from(&builder, part_new, instr_belongs_to(&uf->body, instr_next));
+
+        if (instr_next->type == INSTR_TESTBR) builder.block_terminated = true;
+        instr_cur = (Instr*) ((char*) instr_next + nextsz);
+      } else {
+        addinstr_like(&builder, &uf->body, instr_cur, instrsz, instr_cur);
+        instr_cur = instr_next;
+      }
+    }
+  }
+
+  UserFunction *fn = build_function(&builder);
+  copy_fn_stats(uf, fn);
+  fn->non_ssa = uf->non_ssa;
+  return fn;
+}
+
+typedef struct {
+  const char *name;
+  // either builds a new function from the old one ...
+  UserFunction *(*rebuild_fn)(PassManager *pm, UserFunction *uf);
+  // ... or patches instrs where they are, without changing their size or the blocks
+  void (*in_place_fn)(PassManager *pm, UserFunction *uf);
+} OptimizePass;
+
+#define REBUILD(FN) { #FN, FN, NULL }
+#define IN_PLACE(FN) { #FN, NULL, FN }
 
+static const OptimizePass runtime_passes[] = {
   // moved here because it can be kind of expensive due to lazy coding, and I'm too lazy to fix it
-  uf = inline_static_lookups_to_constants(state, uf, context, false);
+  REBUILD(inline_static_lookups_to_constants),
   // run a second time, to pick up accesses on objects that just now became statically known
-  uf = inline_static_lookups_to_constants(state, uf, context, true);
+  REBUILD(inline_static_lookups_to_constants),
 
-  uf = access_vars_via_refslots(uf);
+  REBUILD(access_vars_via_refslots),
 
-  uf = inline_constant_slots(state, uf);
+  IN_PLACE(inline_constant_slots),
 
   // run a third time, to pick up on instanceof patterns
-  uf = inline_static_lookups_to_constants(state, uf, context, true);
-  uf = inline_constant_slots(state, uf);
+  REBUILD(inline_static_lookups_to_constants),
+  IN_PLACE(inline_constant_slots),
+  REBUILD(fold_constant_calls),
+  IN_PLACE(inline_constant_slots),
 
-  uf = slot_refslot_fuse(state, uf);
+  REBUILD(slot_refslot_fuse),
 
   // must be late!
-  uf = fuse_static_object_alloc(state, uf);
-  uf = remove_dead_slot_writes(uf);
-
-  uf = remove_pointless_blocks(uf);
-
-  uf = null_this_in_thisless_calls(state, uf);
-  uf = stackify_nonescaping_heap_allocs(uf);
-  uf = deconstruct_immutable_stack_objects(uf);
-  uf = free_stack_objects_early(uf);
+  REBUILD(fuse_static_object_alloc),
+  REBUILD(remove_dead_slot_writes),
+
+  REBUILD(remove_pointless_blocks),
+
+  IN_PLACE(null_this_in_thisless_calls),
+  REBUILD(stackify_nonescaping_heap_allocs),
+  REBUILD(deconstruct_immutable_stack_objects),
+  REBUILD(remove_redundant_computations),
+  REBUILD(eliminate_array_bounds_checks),
+  REBUILD(hoist_loop_invariant_lookups),
+  REBUILD(hoist_loop_invariant_closures),
+  // makes the IR non-ssa!
+  REBUILD(promote_frame_vars_to_slots),
+  REBUILD(free_stack_objects_early),
 
   // should be last-ish, micro-opt that introduces a new op
-  uf = call_functions_directly(state, uf);
+  REBUILD(call_functions_directly),
 
   // must be very very *very* last!
-  uf = compactify_registers(uf);
+  REBUILD(compactify_registers),
+  REBUILD(lower_phis_to_moves),
+  REBUILD(layout_blocks_by_profile),
+  REBUILD(mark_tail_calls),
+
+  // ... except for this, which changes nothing but how the instrs are dispatched
+  REBUILD(fuse_instructions),
+};
+
+#undef REBUILD
+#undef IN_PLACE
+
+static UserFunction *run_pass(PassManager *pm, const OptimizePass *pass, UserFunction *uf) {
+  bool verbose = pm->state->shared->verbose;
+  struct timespec pass_start;
+  int size_before = (char*) uf->body.instrs_ptr_end - (char*) uf->body.instrs_ptr;
+  if (verbose) clock_gettime(CLOCK_MONOTONIC, &pass_start);
+
+  if (pass->in_place_fn) {
+    // the first pass is always a rebuild, so we never patch the shared original
+    assert(pm->owned);
+    pass->in_place_fn(pm, uf);
+    analysis_invalidate(uf);
+  } else {
+    UserFunction *fn = pass->rebuild_fn(pm, uf);
+    if (pm->owned) free_function(uf);
+    else analysis_invalidate(uf); // don't keep the analysis alive on the shared original
+    pm->owned = true;
+    uf = fn;
+  }
+
+  if (verbose) {
+    long long ns_taken = get_clock_and_difference(NULL, &pass_start);
+    int size_after = (char*) uf->body.instrs_ptr_end - (char*) uf->body.instrs_ptr;
+    fprintf(stderr, "  %-36s %8.3fms  %6i -> %6i bytes%s\n", pass->name, ns_taken / 1000000.0,
+            size_before, size_after, pass->in_place_fn ? " (in place)" : "");
+  }
+  return uf;
+}
+
+UserFunction *optimize_runtime(VMState *state, UserFunction *uf, Object *context) {
+  uf->num_optimized ++;
+  // specialize_for_closure optimizes once per cached context, and once more for the generic version
+  assert(uf->num_optimized <= SPECIALIZATIONS_MAX + 1);
+
+  if (uf->non_ssa != false) {
+    fprintf(stderr, "called optimizer on function that is non-ssa!\n");
+    abort();
+  }
+
+  assert(uf->resolved);
+
+  /*
+  printf("runtime optimize %s with %p\n", uf->name, (void*) context);
+  if (uf->name && strcmp(uf->name, "gear") == 0) print_recursive(state, context, false);
+  printf("\n-----\n");
+  */
+
+  if (state->shared->verbose) {
+    fprintf(stderr, "runtime optimizing %s\n", uf->name);
+  }
+
+  PassManager pm = { .state = state, .context = context, .owned = false };
+  for (int i = 0; i < sizeof(runtime_passes) / sizeof(*runtime_passes); i++) {
+    uf = run_pass(&pm, &runtime_passes[i], uf);
+  }
 
   uf->optimized = true; // will be optimized no further
+  analysis_invalidate(uf);
 
   if (state->shared->verbose) {
     CFG cfg;
@@ -2512,30 +4025,45 @@ UserFunction *optimize_runtime(VMState *state, UserFunction *uf, Object *context
   return uf;
 }
 
-Slot find_refslot_slot(UserFunction *uf, Refslot refslot) {
-  for (int i = 0; i < uf->body.blocks_len; ++i) {
-    Instr *instr = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
-    while (instr != instr_end) {
-      if (instr->type == INSTR_DEFINE_REFSLOT) {
-        DefineRefslotInstr *dri = (DefineRefslotInstr*) instr;
-        instr = (Instr*) (dri + 1);
-        if (refslot_index_rt(uf, dri->target_refslot) == refslot_index_rt(uf, refslot)) {
-          return dri->obj_slot;
-        }
-        continue;
-      }
-      if (instr->type == INSTR_ALLOC_STATIC_OBJECT) {
-        AllocStaticObjectInstr *asoi = (AllocStaticObjectInstr*) instr;
-        for (int i = 0; i < asoi->tbl.entries_stored; ++i) {
-          StaticFieldInfo *info = &ASOI_INFO(asoi)[i];
-          if (refslot_index_rt(uf, info->refslot) == refslot_index_rt(uf, refslot)) {
-            return asoi->target_slot;
-          }
-        }
-      }
-      instr = (Instr*)((char*) instr + instr_size(instr));
+static SpecializationCache *specialization_cache(VMState *state, UserFunction *uf) {
+  if (!uf->specializations) {
+    SpecializationCache *cache = uf->specializations = calloc(1, sizeof(SpecializationCache));
+    SpecializationCache **list_p = &state->shared->gcstate.specializations;
+    cache->next = *list_p;
+    cache->prev_p = list_p;
+    if (*list_p) (*list_p)->prev_p = &cache->next;
+    *list_p = cache;
+  }
+  return uf->specializations;
+}
+
+UserFunction *find_specialization(VMState *state, UserFunction *uf, Object *closure_context) {
+  SpecializationCache *cache = specialization_cache(state, uf);
+  // a context that was freed is NULL here, and its slot stays used up
+  for (int i = 0; i < cache->len; i++) {
+    if (cache->context_ptr[i] && cache->context_ptr[i] == closure_context) return cache->fn_ptr[i];
+  }
+  if (cache->len == SPECIALIZATIONS_MAX) return cache->generic;
+  return NULL;
+}
+
+UserFunction *specialize_for_closure(VMState *state, UserFunction *uf, Object *closure_context, Object *context) {
+  SpecializationCache *cache = specialization_cache(state, uf);
+  assert(!find_specialization(state, uf, closure_context));
+  if (cache->len == SPECIALIZATIONS_MAX) {
+    if (state->shared->verbose) {
+      fprintf(stderr, "%s: too many contexts to specialize for, falling back to a generic version\n", uf->name);
     }
+    cache->generic = optimize_runtime(state, uf, NULL);
+    return cache->generic;
   }
-  dump_fn(NULL, uf);
-  assert("Refslot not found" && false);
+  UserFunction *opt = optimize_runtime(state, uf, context);
+  cache->context_ptr[cache->len] = closure_context;
+  cache->fn_ptr[cache->len] = opt;
+  cache->len++;
+  return opt;
+}
+
+Slot find_refslot_slot(UserFunction *uf, Refslot refslot) {
+  return analysis_refslot_slot(uf, refslot);
 }
@@ -7,4 +7,12 @@ UserFunction *optimize(UserFunction *uf);
 
 UserFunction *optimize_runtime(VMState *state, UserFunction *uf, Object *context);
 
+// runtime specializations of uf are shared by all closures over the same context.
+// past SPECIALIZATIONS_MAX contexts, every further one gets the same context-free version.
+// the version for closure_context, or NULL if it still has to be made
+UserFunction *find_specialization(VMState *state, UserFunction *uf, Object *closure_context);
+
+// context is what the call passes as slot 1 (closure_context, or an object on top of it)
+UserFunction *specialize_for_closure(VMState *state, UserFunction *uf, Object *closure_context, Object *context);
+
 #endif
@@ -0,0 +1,204 @@
+#include "vm/prefetch.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "vm/bytecode_cache.h"
+#include "vm/constants.h"
+#include "vm/runtime.h"
+#include "language.h"
+#include "hash.h"
+#include "util.h"
+
+#ifndef _WIN32
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define PREFETCH_THREADS_MAX 8
+
+typedef struct {
+  char *filename;
+  TextRange source;
+  UserFunction *module; // NULL if parsing failed
+  RegisteredFunction *registered_ptr; int registered_len; // queued by the worker, replayed after the wave
+} PrefetchedModule;
+
+// not taken yet
+static PrefetchedModule *prefetched_ptr = NULL;
+static int prefetched_len = 0;
+
+typedef struct {
+  PrefetchedModule *modules_ptr; int modules_len;
+  int next; // first module no worker has picked up yet
+  pthread_mutex_t lock;
+} PrefetchWave;
+
+static void *prefetch_worker(void *arg) {
+  PrefetchWave *wave = arg;
+  parse_queue_registrations(true);
+  while (true) {
+    pthread_mutex_lock(&wave->lock);
+    int i = wave->next++;
+    pthread_mutex_unlock(&wave->lock);
+    if (i >= wave->modules_len) break;
+
+    PrefetchedModule *mod = &wave->modules_ptr[i];
+    if (parse_module_cached(mod->source, &mod->module) != PARSE_OK) mod->module = NULL;
+    mod->registered_ptr = parse_take_queued_registrations(&mod->registered_len);
+  }
+  parse_queue_registrations(false);
+  return NULL;
+}
+
+static void run_wave(PrefetchedModule *modules_ptr, int modules_len) {
+  PrefetchWave wave = { .modules_ptr = modules_ptr, .modules_len = modules_len };
+  pthread_mutex_init(&wave.lock, NULL);
+
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int threads_len = modules_len;
+  if (cpus > 0 && threads_len > cpus) threads_len = cpus;
+  if (threads_len > PREFETCH_THREADS_MAX) threads_len = PREFETCH_THREADS_MAX;
+
+  if (threads_len <= 1) {
+    prefetch_worker(&wave);
+  } else {
+    intern_set_threaded(true);
+    constant_pool_set_threaded(true);
+    pthread_t *threads_ptr = malloc(sizeof(pthread_t) * threads_len);
+    int started = 0;
+    while (started < threads_len && pthread_create(&threads_ptr[started], NULL, prefetch_worker, &wave) == 0) {
+      started++;
+    }
+    if (started == 0) prefetch_worker(&wave); // no threads to be had; still get it done
+    for (int i = 0; i < started; i++) pthread_join(threads_ptr[i], NULL);
+    free(threads_ptr);
+    constant_pool_set_threaded(false);
+    intern_set_threaded(false);
+  }
+  pthread_mutex_destroy(&wave.lock);
+
+  for (int i = 0; i < modules_len; i++) {
+    PrefetchedModule *mod = &modules_ptr[i];
+    for (int k = 0; k < mod->registered_len; k++) {
+      register_function(mod->registered_ptr[k].range, mod->registered_ptr[k].name);
+    }
+    free(mod->registered_ptr);
+    mod->registered_ptr = NULL;
+    mod->registered_len = 0;
+  }
+}
+
+// the literal arguments of require("...") calls, found without parsing the source
+static void scan_requires(TextRange source, char ***names_ptr_p, int *names_len_p) {
+  char *text = source.start;
+  while (true) {
+    eat_filler(&text);
+    if (!*text) break;
+    // the language only has double-quoted strings
+    if (*text == '"') {
+      char *str;
+      if (parse_string(&text, &str) == PARSE_OK) free(str);
+      else text++; // the module won't parse, but keep looking for requires past it
+      continue;
+    }
+    if (isalpha((unsigned char) *text) || *text == '_') {
+      char *ident = text;
+      while (isalnum((unsigned char) *text) || *text == '_') text++;
+      int ident_len = text - ident;
+      if (ident_len != 7 || strncmp(ident, "require", 7) != 0) continue;
+      char *text2 = text, *name;
+      if (!eat_string(&text2, "(") || parse_string(&text2, &name) != PARSE_OK) continue;
+      if (eat_string(&text2, ")")) {
+        *names_ptr_p = realloc(*names_ptr_p, sizeof(char*) * ++*names_len_p);
+        (*names_ptr_p)[*names_len_p - 1] = name;
+      } else free(name);
+      text = text2;
+      continue;
+    }
+    text++;
+  }
+}
+
+// required, prefetched or about to be
+static bool module_known(const char *filename) {
+  for (int i = 0; i < prefetched_len; i++) {
+    if (strcmp(prefetched_ptr[i].filename, filename) == 0) return true;
+  }
+  int required_len;
+  RequiredModule *required_ptr = required_modules(&required_len);
+  bool found = false;
+  for (int i = 0; i < required_len && !found; i++) {
+    if (strcmp(required_ptr[i].filename, filename) == 0) found = true;
+  }
+  free(required_ptr);
+  return found;
+}
+
+void prefetch_requires(VMState *state, TextRange source) {
+  TextRange *scan_ptr = malloc(sizeof(TextRange));
+  scan_ptr[0] = source;
+  int scan_len = 1;
+  while (scan_len) {
+    int wave_start = prefetched_len;
+    for (int i = 0; i < scan_len; i++) {
+      char **names_ptr = NULL; int names_len = 0;
+      scan_requires(scan_ptr[i], &names_ptr, &names_len);
+      for (int k = 0; k < names_len; k++) {
+        char *filename = find_required_file(state, names_ptr[k]);
+        free(names_ptr[k]);
+        if (!filename) continue; // require() will say so
+        int filename_len = strlen(filename);
+        bool compiled = filename_len > 3 && strcmp(filename + filename_len - 3, ".so") == 0;
+        if (compiled || module_known(filename)) {
+          free(filename);
+          continue;
+        }
+        // the registry is only touched here, between waves
+        TextRange module_source = readfile(filename);
+        register_file(module_source, my_asprintf("%s", filename), 0, 0);
+        prefetched_ptr = realloc(prefetched_ptr, sizeof(PrefetchedModule) * ++prefetched_len);
+        prefetched_ptr[prefetched_len - 1] = (PrefetchedModule) { .filename = filename, .source = module_source };
+      }
+      free(names_ptr);
+    }
+    int wave_len = prefetched_len - wave_start;
+    if (!wave_len) break;
+    run_wave(prefetched_ptr + wave_start, wave_len);
+
+    // the next wave is whatever this one requires
+    scan_ptr = realloc(scan_ptr, sizeof(TextRange) * wave_len);
+    scan_len = 0;
+    for (int i = wave_start; i < prefetched_len; i++) {
+      if (prefetched_ptr[i].module) scan_ptr[scan_len++] = prefetched_ptr[i].source;
+    }
+  }
+  free(scan_ptr);
+}
+
+bool prefetch_take(const char *filename, UserFunction **module_p, TextRange *source_p) {
+  for (int i = 0; i < prefetched_len; i++) {
+    PrefetchedModule *mod = &prefetched_ptr[i];
+    if (strcmp(mod->filename, filename) != 0) continue;
+    *module_p = mod->module;
+    *source_p = mod->source;
+    free(mod->filename);
+    *mod = prefetched_ptr[--prefetched_len];
+    return true;
+  }
+  return false;
+}
+
+#else
+
+void prefetch_requires(VMState *state, TextRange source) {
+  (void) state; (void) source;
+}
+
+bool prefetch_take(const char *filename, UserFunction **module_p, TextRange *source_p) {
+  (void) filename; (void) module_p; (void) source_p;
+  return false;
+}
+
+#endif
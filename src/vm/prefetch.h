@@ -0,0 +1,21 @@
+#ifndef JERBOA_VM_PREFETCH_H
+#define JERBOA_VM_PREFETCH_H
+
+// parsing required modules ahead of time (jerboa --prefetch). literal require("...") calls are found
+// in a module's text, and those files, then the files they require in turn, are parsed and statically
+// optimized on worker threads, a wave at a time. require() then runs the finished module in place of
+// parsing it, so modules still run in the order the script requires them.
+// the vm thread waits out each wave, so the vm never runs alongside the workers.
+// a parse error in a prefetched module is printed when it's prefetched.
+
+#include "core.h"
+#include <rdparse/util.h>
+
+// prefetch what source requires; filenames are looked up in the search path as it is now
+void prefetch_requires(VMState *state, TextRange source);
+
+// if filename (as found in the search path) was prefetched, hands over its module and registered
+// source. *module_p is NULL if it failed to parse.
+bool prefetch_take(const char *filename, UserFunction **module_p, TextRange *source_p);
+
+#endif
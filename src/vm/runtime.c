@@ -10,6 +10,9 @@
 
 #include "vm/call.h"
 #include "vm/ffi.h"
+#include "vm/aot.h"
+#include "vm/bytecode_cache.h"
+#include "vm/prefetch.h"
 #include "gc.h"
 #include "trie.h"
 #include "print.h"
@@ -53,8 +56,8 @@ static void fn_apply_fn(VMState *state, CallInfo *info) {
 
   CallInfo *info2 = alloca(sizeof(CallInfo) + sizeof(Arg) * len);
   info2->args_len = len;
-  info2->this_arg = (Arg) { .kind = ARG_VALUE, .value = this_value };
-  info2->fn = (Arg) { .kind = ARG_VALUE, .value = fn_value };
+  info2->this_arg = (Arg) { .kind = ARG_VALUE, .value = &this_value };
+  info2->fn = (Arg) { .kind = ARG_VALUE, .value = &fn_value };
 #ifndef NDEBUG
   info2->target = (WriteArg) { .kind = ARG_SLOT, .slot = { .offset = sizeof(Callframe), .is_resolved = true } }; // equivalent to index 0, the return slot
 #else
@@ -1018,13 +1021,13 @@ static void array_compare_fn(VMState *state, CallInfo *info) {
         if (!cmp_fn) {
           res = val1.obj == val2.obj;
         } else {
-          Value equal;
+          Value equal, cmp_fn_val = OBJ2VAL(cmp_fn);
           CallInfo *info = alloca(sizeof(CallInfo) + sizeof(Arg) * 1);
-          info->fn = (Arg) { .kind = ARG_VALUE, .value = OBJ2VAL(cmp_fn) };
+          info->fn = (Arg) { .kind = ARG_VALUE, .value = &cmp_fn_val };
           info->target = (WriteArg) { .kind = ARG_POINTER, .pointer = &equal };
-          info->this_arg = (Arg) { .kind = ARG_VALUE, .value = val1 };
+          info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &val1 };
           info->args_len = 1;
-          INFO_ARGS_PTR(info)[0] = (Arg) { .kind = ARG_VALUE, .value = val2 };
+          INFO_ARGS_PTR(info)[0] = (Arg) { .kind = ARG_VALUE, .value = &val2 };
 
           if (setup_call(&substate, info, NULL)) {
             vm_update_frame(&substate);
@@ -1355,14 +1358,14 @@ static bool xml_node_check_pred(VMState *state, Value node, Value pred)
   substate.root = state->root;
   substate.shared = state->shared;
 
-  Value res;
+  Value res, this_value = VNULL;
 
   CallInfo *info = alloca(sizeof(CallInfo) + sizeof(Arg));
   info->args_len = 1;
-  info->fn = (Arg) { .kind = ARG_VALUE, .value = pred };
-  info->this_arg = (Arg) { .kind = ARG_VALUE, .value = VNULL };
+  info->fn = (Arg) { .kind = ARG_VALUE, .value = &pred };
+  info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &this_value };
   info->target = (WriteArg) { .kind = ARG_POINTER, .pointer = &res };
-  INFO_ARGS_PTR(info)[0] = (Arg) { .kind = ARG_VALUE, .value = node };
+  INFO_ARGS_PTR(info)[0] = (Arg) { .kind = ARG_VALUE, .value = &node };
 
   if (!setup_call(&substate, info, NULL)) {
     VM_ASSERT(false, "pred check failure: %s\n", substate.error) false;
@@ -1521,65 +1524,107 @@ typedef struct _ModuleCache ModuleCache;
 struct _ModuleCache {
   ModuleCache *next;
   char *filename;
-  Value importval;
+  TextRange source;
+  Value importval; // the proxy, while lazy
+  bool lazy;
+  bool loading; // lazy, and running right now
   GCRootSet my_set;
 };
 
 static ModuleCache *mod_cache = 0;
 
-static char *find_file_in_searchpath(VMState *state, char *filename, bool *found) {
+RequiredModule *required_modules(int *len_p) {
+  int len = 0;
+  for (ModuleCache *cur_cache = mod_cache; cur_cache; cur_cache = cur_cache->next) len++;
+  RequiredModule *modules_ptr = malloc(sizeof(RequiredModule) * len);
+  int i = 0;
+  for (ModuleCache *cur_cache = mod_cache; cur_cache; cur_cache = cur_cache->next) {
+    modules_ptr[i++] = (RequiredModule) { cur_cache->filename, cur_cache->source, cur_cache->importval, cur_cache->lazy };
+  }
+  *len_p = len;
+  return modules_ptr;
+}
+
+void add_required_module(VMState *state, RequiredModule module) {
+  ModuleCache *new_mod_cache = malloc(sizeof(ModuleCache));
+  *new_mod_cache = (ModuleCache) {
+    .next = mod_cache,
+    .filename = my_asprintf("%s", module.filename), // avoid gc on the string object
+    .source = module.source,
+    .importval = module.importval,
+    .lazy = module.lazy
+  };
+  mod_cache = new_mod_cache;
+  // don't accidentally free the module in gc
+  // TODO single root set for all cache?
+  gc_add_roots(state, &mod_cache->importval, 1, &mod_cache->my_set);
+}
+
+// *error_p is set if the search path itself is broken
+static char *search_file(VMState *state, const char *filename, char **error_p) {
   Object *searchpath = OBJ_OR_NULL(OBJECT_LOOKUP(state->root, searchpath));
-  VM_ASSERT(searchpath, "search path must exist, internal error") NULL;
+  if (!searchpath) {
+    *error_p = "search path must exist, internal error";
+    return NULL;
+  }
   Object *array_base = state->shared->vcache.array_base;
   Object *string_base = state->shared->vcache.string_base;
 
   ArrayObject *searchpath_array = (ArrayObject*) obj_instance_of(searchpath, array_base);
-  VM_ASSERT(searchpath_array, "search path must be array object, internal error") NULL;
+  if (!searchpath_array) {
+    *error_p = "search path must be array object, internal error";
+    return NULL;
+  }
   for (int i = 0; i < searchpath_array->length; i++) {
     Object *entry_obj = OBJ_OR_NULL(searchpath_array->ptr[i]);
     StringObject *entry_str = (StringObject*) obj_instance_of(entry_obj, string_base);
-    VM_ASSERT(entry_str, "search path entry %i must be string", i) NULL;
+    if (!entry_str) {
+      *error_p = my_asprintf("search path entry %i must be string", i);
+      return NULL;
+    }
     char *path = my_asprintf("%s/%s", entry_str->value, filename);
     if (file_exists(path)) {
       return path;
     }
     free(path);
   }
-  *found = false;
   return NULL;
 }
 
-static void require_fn(VMState *state, CallInfo *info) {
-  VM_ASSERT(info->args_len == 1, "wrong arity: expected 1, got %i", info->args_len);
-  Object *root = state->root;
-  Object *string_base = state->shared->vcache.string_base;
-
-  StringObject *file_obj = (StringObject*) obj_instance_of(OBJ_OR_NULL(load_arg(state->frame, INFO_ARGS_PTR(info)[0])), string_base);
-  VM_ASSERT(file_obj, "parameter to require() must be string!");
-
-  char *filename = file_obj->value;
-	bool found_or_errored = true;
-  filename = find_file_in_searchpath(state, filename, &found_or_errored);
-	VM_ASSERT(found_or_errored, "required file not found"); // only error here if we didn't error otherwise
-  if (!filename) return; // one of the errors we already asserted
-
-  ModuleCache *cur_cache = mod_cache;
-  while (cur_cache) {
-    if (strcmp(cur_cache->filename, filename) == 0) {
-      vm_return(state, info, cur_cache->importval);
-      return;
-    }
-    cur_cache = cur_cache->next;
-  }
+char *find_required_file(VMState *state, const char *filename) {
+  char *error = NULL;
+  return search_file(state, filename, &error);
+}
 
-  TextRange source = readfile(filename);
-  register_file(source, my_asprintf("%s", filename) /* dup */, 0, 0);
+static char *find_file_in_searchpath(VMState *state, char *filename, bool *found) {
+  char *error = NULL;
+  char *path = search_file(state, filename, &error);
+  VM_ASSERT(!error, "%s", error) NULL;
+  if (!path) *found = false;
+  return path;
+}
 
+// parses (or picks up) and runs the module in filename; false if it errored
+static bool run_module(VMState *state, char *filename, Value *resval_p, TextRange *source_p) {
   UserFunction *module;
-  char *text = source.start;
-  ParseResult res = parse_module(&text, &module);
-  VM_ASSERT(res == PARSE_OK, "require() parsing failed!");
-  // dump_fn(module);
+  TextRange source = { NULL, NULL };
+  int filename_len = strlen(filename);
+  if (filename_len > 3 && strcmp(filename + filename_len - 3, ".so") == 0) {
+    // compiled with jerboa --emit-c
+    module = aot_load_module(state, filename);
+    if (!module) return false;
+  } else {
+    if (!prefetch_take(filename, &module, &source)) {
+      source = readfile(filename);
+      register_file(source, my_asprintf("%s", filename) /* dup */, 0, 0);
+
+      ParseResult res = parse_module_cached(source, &module);
+      VM_ASSERT(res == PARSE_OK, "require() parsing failed!") false;
+    }
+    VM_ASSERT(module, "require() parsing failed!") false; // prefetched, the error was printed then
+    // dump_fn(module);
+    if (state->shared->settings.prefetch_enabled) prefetch_requires(state, source);
+  }
 
   VMState substate = {0};
   substate.runstate = VM_TERMINATED;
@@ -1587,11 +1632,9 @@ static void require_fn(VMState *state, CallInfo *info) {
   substate.root = state->root;
   substate.shared = state->shared;
 
-  Value resval;
-
   CallInfo info2 = {{0}};
-  info2.target = (WriteArg) { .kind = ARG_POINTER, .pointer = &resval };
-  call_function(&substate, root, module, &info2);
+  info2.target = (WriteArg) { .kind = ARG_POINTER, .pointer = resval_p };
+  call_function(&substate, state->root, module, &info2);
   vm_update_frame(&substate);
   vm_run(&substate);
 
@@ -1600,25 +1643,114 @@ static void require_fn(VMState *state, CallInfo *info) {
     state->error = my_asprintf("Error during require('%s')\n%s", filename, substate.error);
     state->backtrace = vm_record_backtrace(&substate, &state->backtrace_depth);
     free(substate.backtrace);
-    return;
+    return false;
   }
 
   free_function(module);
+  *source_p = source;
+  return true;
+}
 
-  ModuleCache *new_mod_cache = malloc(sizeof(ModuleCache));
-  *new_mod_cache = (ModuleCache) {
-    .next = mod_cache,
-    .filename = my_asprintf("%s", filename), // avoid gc on the string object
-    .importval = resval
-  };
-  mod_cache = new_mod_cache;
-  // don't accidentally free the module in gc
-  // TODO single root set for all cache?
-  gc_add_roots(state, &mod_cache->importval, 1, &mod_cache->my_set);
+// require() and require_lazy() of the same name find the same file
+static char *require_arg_file(VMState *state, CallInfo *info, const char *fn_name) {
+  VM_ASSERT(info->args_len == 1, "wrong arity: expected 1, got %i", info->args_len) NULL;
+  Object *string_base = state->shared->vcache.string_base;
+
+  StringObject *file_obj = (StringObject*) obj_instance_of(OBJ_OR_NULL(load_arg(state->frame, INFO_ARGS_PTR(info)[0])), string_base);
+  VM_ASSERT(file_obj, "parameter to %s() must be string!", fn_name) NULL;
+
+  bool found_or_errored = true;
+  char *filename = find_file_in_searchpath(state, file_obj->value, &found_or_errored);
+  VM_ASSERT(found_or_errored, "required file not found") NULL; // only error here if we didn't error otherwise
+  return filename; // NULL for one of the errors we already asserted
+}
+
+static ModuleCache *find_cached_module(const char *filename) {
+  for (ModuleCache *cur_cache = mod_cache; cur_cache; cur_cache = cur_cache->next) {
+    if (strcmp(cur_cache->filename, filename) == 0) return cur_cache;
+  }
+  return NULL;
+}
+
+// runs a module that require_lazy() put off, and has its proxy forward to the real exports from now on
+static bool load_lazy_module(VMState *state, ModuleCache *cached) {
+  VM_ASSERT(!cached->loading, "module '%s' used its own require_lazy() proxy while loading", cached->filename) false;
+  Value resval;
+  TextRange source;
+  cached->loading = true;
+  bool ran = run_module(state, cached->filename, &resval, &source);
+  cached->loading = false;
+  if (!ran) return false;
+  VM_ASSERT(IS_OBJ(resval), "module '%s' loaded by require_lazy() must return an object", cached->filename) false;
+  Object *proxy = AS_OBJ(cached->importval);
+  gc_disable(state); // once the cache holds the exports, nothing may be holding on to the proxy
+  cached->lazy = false;
+  cached->source = source;
+  cached->importval = resval;
+  proxy->parent = AS_OBJ(resval); // the proxy has no keys of its own, so it now reads just like the exports
+  gc_enable(state);
+  return true;
+}
+
+static void require_fn(VMState *state, CallInfo *info) {
+  char *filename = require_arg_file(state, info, "require");
+  if (!filename) return;
+
+  ModuleCache *cached = find_cached_module(filename);
+  if (cached) {
+    if (cached->lazy && !load_lazy_module(state, cached)) return;
+    vm_return(state, info, cached->importval);
+    return;
+  }
+
+  Value resval;
+  TextRange source;
+  if (!run_module(state, filename, &resval, &source)) return;
+
+  add_required_module(state, (RequiredModule) { filename, source, resval, false });
 
   vm_return(state, info, resval);
 }
 
+// the [] fallback of a proxy returned by require_lazy(): the first property read runs the module.
+static void lazy_module_access_fn(VMState *state, CallInfo *info) {
+  VM_ASSERT(info->args_len == 1, "wrong arity: expected 1, got %i", info->args_len);
+  Object *proxy = OBJ_OR_NULL(load_arg(state->frame, info->this_arg));
+  Object *string_base = state->shared->vcache.string_base;
+  StringObject *key_obj = (StringObject*) obj_instance_of(OBJ_OR_NULL(load_arg(state->frame, INFO_ARGS_PTR(info)[0])), string_base);
+  VM_ASSERT(key_obj, "module proxy can only be indexed with strings");
+
+  ModuleCache *cached = mod_cache;
+  while (cached && !(cached->lazy && AS_OBJ(cached->importval) == proxy)) cached = cached->next;
+  // otherwise, this is an object that inherits from a proxy, or require() beat us to the module
+  if (cached && !load_lazy_module(state, cached)) return;
+
+  FastKey key = prepare_key(key_obj->value, strlen(key_obj->value));
+  bool key_found;
+  Value value = object_lookup_p(proxy, &key, &key_found);
+  VM_ASSERT(key_found, "property not found: '%s'", key_obj->value);
+  vm_return(state, info, value);
+}
+
+static void require_lazy_fn(VMState *state, CallInfo *info) {
+  char *filename = require_arg_file(state, info, "require_lazy");
+  if (!filename) return;
+
+  ModuleCache *cached = find_cached_module(filename);
+  if (cached) {
+    vm_return(state, info, cached->importval);
+    return;
+  }
+
+  // the [] fallback sits on the proxy's parent, which load_lazy_module swaps for the exports
+  Object *loader = AS_OBJ(make_object(state, NULL, false));
+  OBJECT_SET(state, loader, __slice, make_fn(state, lazy_module_access_fn));
+  Object *proxy = AS_OBJ(make_object(state, loader, false));
+  add_required_module(state, (RequiredModule) { filename, (TextRange) { NULL, NULL }, OBJ2VAL(proxy), true });
+
+  vm_return(state, info, OBJ2VAL(proxy));
+}
+
 static void freeze_fn(VMState *state, CallInfo *info) {
   VM_ASSERT(info->args_len == 1, "wrong arity: expected 1, got %i", info->args_len);
   Value arg = load_arg(state->frame, INFO_ARGS_PTR(info)[0]);
@@ -1960,18 +2092,18 @@ Object *create_root(VMState *state) {
   Object *int_obj = AS_OBJ(make_object(state, NULL, false));
   int_obj->flags |= OBJ_NOINHERIT;
   OBJECT_SET(state, root, int, OBJ2VAL(int_obj));
-  OBJECT_SET(state, int_obj, __add, make_fn(state, int_add_fn));
-  OBJECT_SET(state, int_obj, __sub, make_fn(state, int_sub_fn));
-  OBJECT_SET(state, int_obj, __mul, make_fn(state, int_mul_fn));
-  OBJECT_SET(state, int_obj, __div, make_fn(state, int_div_fn));
-  OBJECT_SET(state, int_obj, __mod, make_fn(state, int_mod_fn));
-  OBJECT_SET(state, int_obj, __or , make_fn(state, int_bit_or_fn));
-  OBJECT_SET(state, int_obj, __and, make_fn(state, int_bit_and_fn));
+  OBJECT_SET(state, int_obj, __add, make_fn_pure(state, int_add_fn));
+  OBJECT_SET(state, int_obj, __sub, make_fn_pure(state, int_sub_fn));
+  OBJECT_SET(state, int_obj, __mul, make_fn_pure(state, int_mul_fn));
+  OBJECT_SET(state, int_obj, __div, make_fn_pure(state, int_div_fn));
+  OBJECT_SET(state, int_obj, __mod, make_fn_pure(state, int_mod_fn));
+  OBJECT_SET(state, int_obj, __or , make_fn_pure(state, int_bit_or_fn));
+  OBJECT_SET(state, int_obj, __and, make_fn_pure(state, int_bit_and_fn));
   OBJECT_SET(state, int_obj, __equals , make_fn_fast(state, int_eq_fn, int_eq_fn_dispatch));
-  OBJECT_SET(state, int_obj, __smaller, make_fn(state, int_lt_fn));
-  OBJECT_SET(state, int_obj, __greater , make_fn(state, int_gt_fn));
-  OBJECT_SET(state, int_obj, __smaller_equals, make_fn(state, int_le_fn));
-  OBJECT_SET(state, int_obj, __greater_equals, make_fn(state, int_ge_fn));
+  OBJECT_SET(state, int_obj, __smaller, make_fn_pure(state, int_lt_fn));
+  OBJECT_SET(state, int_obj, __greater , make_fn_pure(state, int_gt_fn));
+  OBJECT_SET(state, int_obj, __smaller_equals, make_fn_pure(state, int_le_fn));
+  OBJECT_SET(state, int_obj, __greater_equals, make_fn_pure(state, int_ge_fn));
   OBJECT_SET(state, int_obj, parse, make_fn(state, int_parse_fn));
   state->shared->vcache.int_base = int_obj;
   int_obj->flags |= OBJ_FROZEN;
@@ -1983,13 +2115,13 @@ Object *create_root(VMState *state) {
   OBJECT_SET(state, float_obj, __sub, make_fn_fast(state, float_sub_fn, float_sub_fn_dispatch));
   OBJECT_SET(state, float_obj, __mul, make_fn_fast(state, float_mul_fn, float_mul_fn_dispatch));
   OBJECT_SET(state, float_obj, __div, make_fn_fast(state, float_div_fn, float_div_fn_dispatch));
-  OBJECT_SET(state, float_obj, __mod, make_fn(state, float_mod_fn));
-  OBJECT_SET(state, float_obj, __equals , make_fn(state, float_eq_fn));
-  OBJECT_SET(state, float_obj, __smaller, make_fn(state, float_lt_fn));
-  OBJECT_SET(state, float_obj, __greater, make_fn(state, float_gt_fn));
-  OBJECT_SET(state, float_obj, __smaller_equals, make_fn(state, float_le_fn));
-  OBJECT_SET(state, float_obj, __greater_equals, make_fn(state, float_ge_fn));
-  OBJECT_SET(state, float_obj, toInt , make_fn(state, float_toint_fn));
+  OBJECT_SET(state, float_obj, __mod, make_fn_pure(state, float_mod_fn));
+  OBJECT_SET(state, float_obj, __equals , make_fn_pure(state, float_eq_fn));
+  OBJECT_SET(state, float_obj, __smaller, make_fn_pure(state, float_lt_fn));
+  OBJECT_SET(state, float_obj, __greater, make_fn_pure(state, float_gt_fn));
+  OBJECT_SET(state, float_obj, __smaller_equals, make_fn_pure(state, float_le_fn));
+  OBJECT_SET(state, float_obj, __greater_equals, make_fn_pure(state, float_ge_fn));
+  OBJECT_SET(state, float_obj, toInt , make_fn_pure(state, float_toint_fn));
   state->shared->vcache.float_base = float_obj;
   float_obj->flags |= OBJ_FROZEN;
 
@@ -2015,16 +2147,17 @@ Object *create_root(VMState *state) {
   Object *string_obj = AS_OBJ(make_object(state, NULL, false));
   string_obj->flags |= OBJ_NOINHERIT;
   OBJECT_SET(state, root, string, OBJ2VAL(string_obj));
-  OBJECT_SET(state, string_obj, __add, make_fn(state, string_add_fn));
-  OBJECT_SET(state, string_obj, __equals, make_fn(state, string_eq_fn));
-  OBJECT_SET(state, string_obj, startsWith, make_fn(state, string_startswith_fn));
-  OBJECT_SET(state, string_obj, endsWith, make_fn(state, string_endswith_fn));
-  OBJECT_SET(state, string_obj, slice, make_fn(state, string_slice_fn));
-  OBJECT_SET(state, string_obj, find, make_fn(state, string_find_fn));
+  OBJECT_SET(state, string_obj, __add, make_fn_pure_alloc(state, string_add_fn));
+  OBJECT_SET(state, string_obj, __equals, make_fn_pure(state, string_eq_fn));
+  OBJECT_SET(state, string_obj, startsWith, make_fn_pure(state, string_startswith_fn));
+  OBJECT_SET(state, string_obj, endsWith, make_fn_pure(state, string_endswith_fn));
+  OBJECT_SET(state, string_obj, slice, make_fn_pure_alloc(state, string_slice_fn));
+  OBJECT_SET(state, string_obj, find, make_fn_pure(state, string_find_fn));
   OBJECT_SET(state, string_obj, split, make_fn(state, string_split_fn));
-  OBJECT_SET(state, string_obj, replace, make_fn(state, string_replace_fn));
-  OBJECT_SET(state, string_obj, byte_len, make_fn(state, string_byte_len_fn));
+  OBJECT_SET(state, string_obj, replace, make_fn_pure_alloc(state, string_replace_fn));
+  OBJECT_SET(state, string_obj, byte_len, make_fn_pure(state, string_byte_len_fn));
   state->shared->vcache.string_base = string_obj;
+  string_obj->flags |= OBJ_FROZEN;
 
   Object *array_obj = AS_OBJ(make_object(state, NULL, false));
   array_obj->flags |= OBJ_NOINHERIT;
@@ -2100,18 +2233,19 @@ Object *create_root(VMState *state) {
   setup_default_searchpath(state, root);
 
   OBJECT_SET(state, root, require, make_fn_global(state, require_fn));
+  OBJECT_SET(state, root, require_lazy, make_fn_global(state, require_lazy_fn));
   OBJECT_SET(state, root, _mark_const, make_fn_global(state, mark_const_fn));
   OBJECT_SET(state, root, assert, make_fn_global(state, assert_fn));
 
   Object *math_obj = AS_OBJ(make_object(state, NULL, false));
-  OBJECT_SET(state, math_obj, sin, make_fn_global(state, sin_fn));
-  OBJECT_SET(state, math_obj, cos, make_fn_global(state, cos_fn));
-  OBJECT_SET(state, math_obj, tan, make_fn_global(state, tan_fn));
-  OBJECT_SET(state, math_obj, log, make_fn_global(state, log_fn));
-  OBJECT_SET(state, math_obj, sqrt, make_fn_global(state, sqrt_fn));
-  OBJECT_SET(state, math_obj, pow, make_fn_global(state, pow_fn));
-  OBJECT_SET(state, math_obj, max, make_fn_global(state, max_fn));
-  OBJECT_SET(state, math_obj, min, make_fn_global(state, min_fn));
+  OBJECT_SET(state, math_obj, sin, make_fn_global_pure(state, sin_fn));
+  OBJECT_SET(state, math_obj, cos, make_fn_global_pure(state, cos_fn));
+  OBJECT_SET(state, math_obj, tan, make_fn_global_pure(state, tan_fn));
+  OBJECT_SET(state, math_obj, log, make_fn_global_pure(state, log_fn));
+  OBJECT_SET(state, math_obj, sqrt, make_fn_global_pure(state, sqrt_fn));
+  OBJECT_SET(state, math_obj, pow, make_fn_global_pure(state, pow_fn));
+  OBJECT_SET(state, math_obj, max, make_fn_global_pure(state, max_fn));
+  OBJECT_SET(state, math_obj, min, make_fn_global_pure(state, min_fn));
   OBJECT_SET(state, math_obj, rand, make_fn_global(state, rand_fn));
   OBJECT_SET(state, math_obj, randf, make_fn_global(state, randf_fn));
   math_obj->flags |= OBJ_FROZEN;
@@ -5,6 +5,23 @@
 
 Object *create_root(VMState *state);
 
+// a module loaded by require(), or put off by require_lazy()
+typedef struct {
+  char *filename;
+  TextRange source; // empty for modules compiled with --emit-c, and lazy ones
+  Value importval; // for a lazy module, the proxy that loads it
+  bool lazy; // not run yet
+} RequiredModule;
+
+// newest first; the array is the caller's to free
+RequiredModule *required_modules(int *len_p);
+
+// from now on, require() of module.filename returns module.importval
+void add_required_module(VMState *state, RequiredModule module);
+
+// where require(filename) would look first; NULL if it isn't found or the search path is broken
+char *find_required_file(VMState *state, const char *filename);
+
 typedef enum {
   CMP_EQ,
   CMP_LT,
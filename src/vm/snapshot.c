@@ -0,0 +1,551 @@
+#include "vm/snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "vm/bytecode_cache.h"
+#include "vm/runtime.h"
+#include "vm/call.h"
+#include "vm/ffi.h"
+#include "object.h"
+#include "trie.h"
+#include "hash.h"
+#include "util.h"
+
+#ifndef _WIN32
+
+#define SNAPSHOT_MAGIC 0x53484a4a // "JJHS"
+#define SNAPSHOT_FORMAT 3
+
+typedef struct {
+  uint32_t magic, format;
+  VMStamp vm;
+} SnapshotHeader;
+
+// what an object was allocated as; decides what else gets stored past the table
+typedef enum {
+  KIND_OBJECT,
+  KIND_STRING,
+  KIND_ARRAY,
+  KIND_FUNCTION, // native
+  KIND_CLOSURE,
+  KIND_POINTER, // only the ones create_root makes, see pointer_id
+  KIND_FFI, // the ffi object, with its type fields
+  KIND_LAST
+} ObjectKind;
+
+// references between objects are stored as indices into objs_ptr
+typedef struct {
+  CacheStream cs;
+  VMState *state;
+  Object **objs_ptr; int objs_len; // writing: sorted by address
+  ObjectKind *kinds_ptr;
+} HeapStream;
+
+static char *object_kind(VMState *state, Object *obj, ObjectKind *kind_p) {
+  ValueCache *vcache = &state->shared->vcache;
+  if (obj == vcache->ffi_obj) *kind_p = KIND_FFI;
+  else if (obj->parent == vcache->string_base && obj->size >= (int) sizeof(StringObject)) *kind_p = KIND_STRING;
+  else if (obj->parent == vcache->array_base && obj->size == sizeof(ArrayObject)) *kind_p = KIND_ARRAY;
+  else if (obj->parent == vcache->function_base && obj->size == sizeof(FunctionObject)) *kind_p = KIND_FUNCTION;
+  else if (obj->parent == vcache->closure_base && obj->size == sizeof(ClosureObject)) *kind_p = KIND_CLOSURE;
+  else if (obj->parent == vcache->pointer_base && obj->size == sizeof(PointerObject)) *kind_p = KIND_POINTER;
+  else if (obj->size == sizeof(Object) && !obj->mark_fn && !obj->free_fn) *kind_p = KIND_OBJECT;
+  else if (obj->parent == vcache->function_base) return my_asprintf("cannot store ffi functions");
+  else return my_asprintf("cannot store native object of size %i", obj->size);
+  return NULL;
+}
+
+// stdout and stderr are the only pointers the runtime hands out before a script opens anything
+static int pointer_id(void *ptr) {
+  if (ptr == NULL) return 0;
+  if (ptr == stdout) return 1;
+  if (ptr == stderr) return 2;
+  return -1;
+}
+
+static void *pointer_by_id(int id) {
+  void *ptrs[] = { NULL, stdout, stderr };
+  return ptrs[id];
+}
+
+// natives are stored as their distance from create_root:
+// the snapshot is pinned to the executable, so only the load address can have moved
+static void sync_code_ptr(CacheStream *cs, intptr_t *addr_p) {
+  int64_t offset = 0;
+  if (cs->writing && *addr_p) offset = *addr_p - (intptr_t) &create_root;
+  cache_sync_bytes(cs, &offset, sizeof(offset));
+  if (!cs->writing) *addr_p = offset ? (intptr_t) &create_root + offset : 0;
+}
+
+static int compare_ptrs(const void *a, const void *b) {
+  uintptr_t pa = (uintptr_t) *(Object* const*) a, pb = (uintptr_t) *(Object* const*) b;
+  return (pa > pb) - (pa < pb);
+}
+
+static void sync_object_ref(HeapStream *hs, Object **obj_p) {
+  int index = -1;
+  if (hs->cs.writing && *obj_p) {
+    Object **found = bsearch(obj_p, hs->objs_ptr, hs->objs_len, sizeof(Object*), compare_ptrs);
+    assert(found); // collect_objects saw everything we store
+    index = found - hs->objs_ptr;
+  }
+  cache_sync_int(&hs->cs, &index);
+  if (hs->cs.writing) return;
+  *obj_p = NULL;
+  if (index < -1 || index >= hs->objs_len) hs->cs.failed = true;
+  if (index == -1 || hs->cs.failed) return;
+  *obj_p = hs->objs_ptr[index];
+}
+
+static void sync_value(HeapStream *hs, Value *value_p) {
+  int type = hs->cs.writing ? (int) value_p->type : 0;
+  cache_sync_int(&hs->cs, &type);
+  if (!hs->cs.writing) {
+    if (type < TYPE_NULL || type > TYPE_OBJECT) hs->cs.failed = true;
+    *value_p = VNULL;
+    if (hs->cs.failed) return;
+    value_p->type = type;
+  }
+  switch (type) {
+    case TYPE_INT: cache_sync_int(&hs->cs, &value_p->i); break;
+    case TYPE_FLOAT: cache_sync_bytes(&hs->cs, &value_p->f, sizeof(float)); break;
+    case TYPE_BOOL: cache_sync_bool(&hs->cs, &value_p->b); break;
+    case TYPE_OBJECT:
+      sync_object_ref(hs, &value_p->obj);
+      if (!hs->cs.writing && !value_p->obj) hs->cs.failed = true;
+      break;
+    default: break;
+  }
+}
+
+// the root's arguments belong to the run that wrote the snapshot; the next run sets its own
+static bool skip_entry(HeapStream *hs, Object *obj, TableEntry *entry) {
+  return entry->hash == 0 || (obj == hs->state->root && entry->hash == _skey_arguments.hash);
+}
+
+static void sync_table(HeapStream *hs, Object *obj) {
+  HashTable *tbl = &obj->tbl;
+  int len = 0;
+  if (hs->cs.writing) {
+    for (int i = 0; i < tbl->entries_num; i++) if (!skip_entry(hs, obj, &tbl->entries_ptr[i])) len++;
+  }
+  cache_sync_int(&hs->cs, &len);
+  if (hs->cs.writing) {
+    for (int i = 0; i < tbl->entries_num; i++) {
+      TableEntry *entry = &tbl->entries_ptr[i];
+      if (skip_entry(hs, obj, entry)) continue;
+      FastKey key = { .hash = entry->hash, .key = trie_reverse_lookup(entry->hash) };
+      cache_sync_key(&hs->cs, &key);
+      sync_object_ref(hs, &entry->constraint);
+      sync_value(hs, &entry->value);
+    }
+    return;
+  }
+  if (len < 0 || len > hs->cs.end - hs->cs.cur) hs->cs.failed = true;
+  for (int i = 0; i < len && !hs->cs.failed; i++) {
+    FastKey key;
+    Object *constraint;
+    Value value;
+    cache_sync_key(&hs->cs, &key);
+    sync_object_ref(hs, &constraint);
+    sync_value(hs, &value);
+    if (hs->cs.failed) return;
+    // straight into the table, since the flags may already say frozen
+    TableEntry *free_entry;
+    TableEntry *entry = table_lookup_alloc_prepared(tbl, &key, &free_entry);
+    if (!entry) entry = free_entry;
+    entry->constraint = constraint;
+    entry->value = value;
+  }
+}
+
+// kind and whatever the object has to be allocated with
+static void sync_shape(HeapStream *hs, int i) {
+  CacheStream *cs = &hs->cs;
+  VMState *state = hs->state;
+  Object *obj = cs->writing ? hs->objs_ptr[i] : NULL;
+  int kind = cs->writing ? (int) hs->kinds_ptr[i] : 0;
+  cache_sync_int(cs, &kind);
+  if (!cs->writing && (kind < 0 || kind >= KIND_LAST)) cs->failed = true;
+  if (cs->failed) return;
+  switch ((ObjectKind) kind) {
+    case KIND_OBJECT:
+      if (!cs->writing) obj = AS_OBJ(make_object(state, NULL, false));
+      break;
+    case KIND_STRING: {
+      char *value = cs->writing ? ((StringObject*) obj)->value : NULL;
+      cache_sync_string(cs, &value);
+      if (cs->writing) break;
+      if (!value) {
+        cs->failed = true;
+        return;
+      }
+      obj = AS_OBJ(make_string(state, value, strlen(value)));
+      free(value);
+      break;
+    }
+    case KIND_ARRAY:
+      if (!cs->writing) obj = AS_OBJ(make_array(state, NULL, 0, true));
+      break;
+    case KIND_FUNCTION: {
+      FunctionObject *fn_obj = (FunctionObject*) obj;
+      intptr_t fn = 0, dispatch_fn = 0;
+      bool method = false, pure = false, allocates = false;
+      if (cs->writing) {
+        fn = (intptr_t) fn_obj->fn_ptr;
+        dispatch_fn = (intptr_t) fn_obj->dispatch_fn_ptr;
+        method = fn_obj->method;
+        pure = fn_obj->pure;
+        allocates = fn_obj->allocates;
+      }
+      sync_code_ptr(cs, &fn);
+      sync_code_ptr(cs, &dispatch_fn);
+      cache_sync_bool(cs, &method);
+      cache_sync_bool(cs, &pure);
+      cache_sync_bool(cs, &allocates);
+      if (cs->writing) break;
+      if (!fn) cs->failed = true;
+      if (cs->failed) return;
+      obj = AS_OBJ(make_fn_custom(state, (VMFunctionPointer) fn, (InstrDispatchFn) dispatch_fn, sizeof(FunctionObject), method));
+      ((FunctionObject*) obj)->pure = pure;
+      ((FunctionObject*) obj)->allocates = allocates;
+      break;
+    }
+    case KIND_CLOSURE:
+      if (!cs->writing) obj = AS_OBJ(make_closure_fn(state, NULL, NULL));
+      break;
+    case KIND_POINTER: {
+      int id = cs->writing ? pointer_id(((PointerObject*) obj)->ptr) : 0;
+      cache_sync_int(cs, &id);
+      if (cs->writing) break;
+      if (id < 0 || id > 2) cs->failed = true;
+      if (cs->failed) return;
+      obj = AS_OBJ(make_ptr(state, pointer_by_id(id)));
+      break;
+    }
+    case KIND_FFI:
+      if (!cs->writing) {
+        obj = alloc_object_internal(state, sizeof(FFIObject), false);
+        bzero((char*) obj + sizeof(Object), sizeof(FFIObject) - sizeof(Object));
+      }
+      break;
+    default: abort();
+  }
+  if (!cs->writing) {
+    hs->objs_ptr[i] = obj;
+    hs->kinds_ptr[i] = kind;
+  }
+}
+
+static void sync_object(HeapStream *hs, int i) {
+  CacheStream *cs = &hs->cs;
+  Object *obj = hs->objs_ptr[i];
+  sync_object_ref(hs, &obj->parent);
+  sync_table(hs, obj);
+  switch (hs->kinds_ptr[i]) {
+    case KIND_ARRAY: {
+      ArrayObject *arr_obj = (ArrayObject*) obj;
+      cache_sync_int(cs, &arr_obj->length);
+      if (!cs->writing) {
+        if (arr_obj->length < 0 || arr_obj->length > cs->end - cs->cur) cs->failed = true;
+        if (cs->failed) {
+          arr_obj->length = 0;
+          return;
+        }
+        arr_obj->ptr = malloc(sizeof(Value) * arr_obj->length);
+        arr_obj->capacity = arr_obj->length;
+        for (int k = 0; k < arr_obj->length; k++) arr_obj->ptr[k] = VNULL;
+      }
+      for (int k = 0; k < arr_obj->length; k++) sync_value(hs, &arr_obj->ptr[k]);
+      break;
+    }
+    case KIND_CLOSURE: {
+      ClosureObject *cl_obj = (ClosureObject*) obj;
+      sync_object_ref(hs, &cl_obj->context);
+      cache_sync_function_ref(cs, &cl_obj->vmfun);
+      break;
+    }
+    case KIND_FFI: {
+      // past the Object header, FFIObject is nothing but type objects
+      Object **types_ptr = (Object**) ((char*) obj + sizeof(Object));
+      int types_len = (sizeof(FFIObject) - sizeof(Object)) / sizeof(Object*);
+      for (int k = 0; k < types_len; k++) sync_object_ref(hs, &types_ptr[k]);
+      break;
+    }
+    default: break;
+  }
+  int flags = obj->flags & (OBJ_CLOSED | OBJ_FROZEN | OBJ_NOINHERIT | OBJ_IMMORTAL);
+  cache_sync_int(cs, &flags);
+  if (!cs->writing) obj->flags = (obj->flags & OBJ_INLINE_TABLE) | (flags & (OBJ_CLOSED | OBJ_FROZEN | OBJ_NOINHERIT | OBJ_IMMORTAL));
+}
+
+// ValueCache members that point at objects, other than thiskey
+static Object **vcache_object(ValueCache *vcache, int i) {
+  Object **members[] = {
+    &vcache->int_base, &vcache->float_base, &vcache->bool_base,
+    &vcache->closure_base, &vcache->function_base,
+    &vcache->array_base, &vcache->string_base, &vcache->pointer_base,
+    &vcache->ffi_obj
+  };
+  return members[i];
+}
+#define VCACHE_OBJECTS 9
+
+static void collect_push(HeapStream *hs, Object ***stack_p, int *stack_len_p, Object *obj) {
+  if (!obj || (obj->flags & OBJ_GC_MARK)) return;
+  // gc only runs in the main loop, so between runs the mark is ours to use
+  obj->flags |= OBJ_GC_MARK;
+  hs->objs_ptr = realloc(hs->objs_ptr, sizeof(Object*) * ++hs->objs_len);
+  hs->objs_ptr[hs->objs_len - 1] = obj;
+  *stack_p = realloc(*stack_p, sizeof(Object*) * ++*stack_len_p);
+  (*stack_p)[*stack_len_p - 1] = obj;
+}
+
+// every object reachable from roots_ptr into objs_ptr, and the functions of their closures into cs.fns_ptr
+static char *collect_objects(HeapStream *hs, Object **roots_ptr, int roots_len) {
+  Object **stack_ptr = NULL; int stack_len = 0;
+  for (int i = 0; i < roots_len; i++) collect_push(hs, &stack_ptr, &stack_len, roots_ptr[i]);
+  char *error = NULL;
+  while (stack_len && !error) {
+    Object *obj = stack_ptr[--stack_len];
+    ObjectKind kind;
+    error = object_kind(hs->state, obj, &kind);
+    if (error) break;
+    collect_push(hs, &stack_ptr, &stack_len, obj->parent);
+    for (int i = 0; i < obj->tbl.entries_num; i++) {
+      TableEntry *entry = &obj->tbl.entries_ptr[i];
+      if (skip_entry(hs, obj, entry)) continue;
+      collect_push(hs, &stack_ptr, &stack_len, entry->constraint);
+      collect_push(hs, &stack_ptr, &stack_len, OBJ_OR_NULL(entry->value));
+    }
+    if (kind == KIND_ARRAY) {
+      ArrayObject *arr_obj = (ArrayObject*) obj;
+      for (int i = 0; i < arr_obj->length; i++) collect_push(hs, &stack_ptr, &stack_len, OBJ_OR_NULL(arr_obj->ptr[i]));
+    } else if (kind == KIND_CLOSURE) {
+      ClosureObject *cl_obj = (ClosureObject*) obj;
+      if (cl_obj->vmfun->optimized) {
+        error = my_asprintf("cannot store '%s', it was optimized at runtime", cl_obj->vmfun->name);
+        break;
+      }
+      collect_push(hs, &stack_ptr, &stack_len, cl_obj->context);
+      cache_collect_functions(&hs->cs, cl_obj->vmfun);
+    } else if (kind == KIND_FFI) {
+      FFIObject *ffi = (FFIObject*) obj;
+      Object **types_ptr = (Object**) ((char*) ffi + sizeof(Object));
+      int types_len = (sizeof(FFIObject) - sizeof(Object)) / sizeof(Object*);
+      for (int i = 0; i < types_len; i++) collect_push(hs, &stack_ptr, &stack_len, types_ptr[i]);
+    } else if (kind == KIND_POINTER && pointer_id(((PointerObject*) obj)->ptr) == -1) {
+      error = my_asprintf("cannot store pointers other than stdout and stderr");
+    }
+  }
+  free(stack_ptr);
+  for (int i = 0; i < hs->objs_len; i++) hs->objs_ptr[i]->flags &= ~OBJ_GC_MARK;
+  if (error) return error;
+
+  qsort(hs->objs_ptr, hs->objs_len, sizeof(Object*), compare_ptrs);
+  hs->kinds_ptr = malloc(sizeof(ObjectKind) * hs->objs_len);
+  for (int i = 0; i < hs->objs_len; i++) {
+    error = object_kind(hs->state, hs->objs_ptr[i], &hs->kinds_ptr[i]);
+    assert(!error);
+  }
+  return NULL;
+}
+
+static void sync_sources(HeapStream *hs, char ***names_p) {
+  CacheStream *cs = &hs->cs;
+  cache_sync_int(cs, &cs->sources_len);
+  if (!cs->writing) {
+    if (cs->sources_len < 0 || cs->sources_len > cs->end - cs->cur) cs->failed = true;
+    if (cs->failed) {
+      cs->sources_len = 0;
+      return;
+    }
+    cs->sources_ptr = calloc(cs->sources_len, sizeof(TextRange));
+    *names_p = calloc(cs->sources_len, sizeof(char*));
+  }
+  for (int i = 0; i < cs->sources_len && !cs->failed; i++) {
+    TextRange *source = &cs->sources_ptr[i];
+    int len = source->end - source->start;
+    cache_sync_string(cs, &(*names_p)[i]);
+    cache_sync_int(cs, &len);
+    if (!cs->writing) {
+      if (!(*names_p)[i] || len < 0 || len > cs->end - cs->cur) cs->failed = true;
+      if (cs->failed) return;
+      // ranges of the stored functions point in here, so it's kept for good
+      char *text = malloc(len + 1);
+      text[len] = 0;
+      *source = (TextRange) { text, text + len };
+    }
+    cache_sync_bytes(cs, source->start, len);
+  }
+}
+
+static void sync_modules(HeapStream *hs, RequiredModule **modules_p, int *len_p) {
+  CacheStream *cs = &hs->cs;
+  cache_sync_int(cs, len_p);
+  if (!cs->writing) {
+    if (*len_p < 0 || *len_p > cs->end - cs->cur) cs->failed = true;
+    if (cs->failed) {
+      *len_p = 0;
+      return;
+    }
+    *modules_p = calloc(*len_p, sizeof(RequiredModule));
+  }
+  for (int i = 0; i < *len_p && !cs->failed; i++) {
+    RequiredModule *module = &(*modules_p)[i];
+    int source = -1;
+    for (int k = 0; k < cs->sources_len; k++) if (cs->sources_ptr[k].start == module->source.start) source = k;
+    cache_sync_string(cs, &module->filename);
+    cache_sync_int(cs, &source);
+    cache_sync_bool(cs, &module->lazy);
+    sync_value(hs, &module->importval);
+    if (cs->writing) continue;
+    if (!module->filename || source < -1 || source >= cs->sources_len) cs->failed = true;
+    if (cs->failed) return;
+    if (source != -1) module->source = cs->sources_ptr[source];
+  }
+}
+
+char *snapshot_save(VMState *state, const char *path, char *main_file, TextRange main_source) {
+  HeapStream hs = { .cs = { .writing = true }, .state = state };
+  CacheStream *cs = &hs.cs;
+  int modules_len;
+  RequiredModule *modules_ptr = required_modules(&modules_len);
+
+  char **names_ptr = malloc(sizeof(char*) * (modules_len + 1));
+  cs->sources_ptr = malloc(sizeof(TextRange) * (modules_len + 1));
+  names_ptr[cs->sources_len] = main_file;
+  cs->sources_ptr[cs->sources_len++] = main_source;
+  for (int i = 0; i < modules_len; i++) {
+    if (!modules_ptr[i].source.start) continue;
+    names_ptr[cs->sources_len] = modules_ptr[i].filename;
+    cs->sources_ptr[cs->sources_len++] = modules_ptr[i].source;
+  }
+
+  int roots_len = 1 + VCACHE_OBJECTS + modules_len;
+  Object **roots_ptr = malloc(sizeof(Object*) * roots_len);
+  roots_ptr[0] = state->root;
+  for (int i = 0; i < VCACHE_OBJECTS; i++) roots_ptr[1 + i] = *vcache_object(&state->shared->vcache, i);
+  for (int i = 0; i < modules_len; i++) roots_ptr[1 + VCACHE_OBJECTS + i] = OBJ_OR_NULL(modules_ptr[i].importval);
+  char *error = collect_objects(&hs, roots_ptr, roots_len);
+  free(roots_ptr);
+
+  FILE *out = NULL;
+  if (!error) {
+    out = fopen(path, "wb");
+    if (!out) error = my_asprintf("cannot open '%s' for writing", path);
+  }
+  if (!error) {
+    cs->out = out;
+    SnapshotHeader header = { .magic = SNAPSHOT_MAGIC, .format = SNAPSHOT_FORMAT };
+    if (!make_vm_stamp(&header.vm)) cs->failed = true;
+    cache_sync_bytes(cs, &header, sizeof(header));
+    sync_sources(&hs, &names_ptr);
+    cache_sync_functions(cs);
+    if (cs->failed) error = my_asprintf("cannot store the functions of the heap");
+    cache_sync_int(cs, &hs.objs_len);
+    for (int i = 0; i < hs.objs_len; i++) sync_shape(&hs, i);
+    for (int i = 0; i < hs.objs_len; i++) sync_object(&hs, i);
+    sync_object_ref(&hs, &state->root);
+    for (int i = 0; i < VCACHE_OBJECTS; i++) sync_object_ref(&hs, vcache_object(&state->shared->vcache, i));
+    sync_modules(&hs, &modules_ptr, &modules_len);
+    if (fclose(out) != 0) cs->failed = true;
+    if (cs->failed && !error) error = my_asprintf("cannot write '%s'", path);
+    if (error) unlink(path);
+  }
+  free(hs.objs_ptr);
+  free(hs.kinds_ptr);
+  free(cs->fns_ptr);
+  free(cs->sources_ptr);
+  free(names_ptr);
+  free(modules_ptr);
+  return error;
+}
+
+char *snapshot_load(VMState *state, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) return my_asprintf("cannot open '%s'", path);
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1 || file_stat.st_size < (off_t) sizeof(SnapshotHeader)) {
+    close(fd);
+    return my_asprintf("'%s' is not a snapshot", path);
+  }
+  char *map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return my_asprintf("cannot map '%s'", path);
+
+  HeapStream hs = {
+    .cs = { .writing = false, .cur = map, .end = map + file_stat.st_size },
+    .state = state
+  };
+  CacheStream *cs = &hs.cs;
+  SnapshotHeader header, expected = { .magic = SNAPSHOT_MAGIC, .format = SNAPSHOT_FORMAT };
+  cache_sync_bytes(cs, &header, sizeof(header));
+  if (!make_vm_stamp(&expected.vm) || memcmp(&header, &expected, sizeof(header)) != 0) {
+    munmap(map, file_stat.st_size);
+    return my_asprintf("'%s' was not written by this jerboa executable", path);
+  }
+
+  char **names_ptr = NULL;
+  sync_sources(&hs, &names_ptr);
+  cache_sync_functions(cs);
+  cache_sync_int(cs, &hs.objs_len);
+  if (hs.objs_len < 0 || hs.objs_len > cs->end - cs->cur) cs->failed = true;
+  if (!cs->failed) {
+    hs.objs_ptr = calloc(hs.objs_len, sizeof(Object*));
+    hs.kinds_ptr = calloc(hs.objs_len, sizeof(ObjectKind));
+    for (int i = 0; i < hs.objs_len && !cs->failed; i++) sync_shape(&hs, i);
+    for (int i = 0; i < hs.objs_len && !cs->failed; i++) sync_object(&hs, i);
+  }
+  Object *root = NULL;
+  ValueCache vcache = {0};
+  sync_object_ref(&hs, &root);
+  for (int i = 0; i < VCACHE_OBJECTS; i++) sync_object_ref(&hs, vcache_object(&vcache, i));
+  RequiredModule *modules_ptr = NULL; int modules_len = 0;
+  sync_modules(&hs, &modules_ptr, &modules_len);
+  if (!root || cs->cur != cs->end) cs->failed = true;
+  munmap(map, file_stat.st_size);
+  free(hs.objs_ptr);
+  free(hs.kinds_ptr);
+
+  if (cs->failed) {
+    // what was allocated is unreachable, and goes with the next gc run
+    free(cs->fns_ptr);
+    free(modules_ptr);
+    return my_asprintf("'%s' is truncated or corrupt", path);
+  }
+
+  for (int i = 0; i < cs->sources_len; i++) register_file(cs->sources_ptr[i], names_ptr[i], 0, 0);
+  for (int i = 0; i < cs->fns_len; i++) {
+    UserFunction *uf = cs->fns_ptr[i];
+    FileRange *range = uf->body.function_range;
+    if (range && uf->name) register_function((TextRange) { range->text_from, range->text_from + range->text_len }, uf->name);
+  }
+  state->root = root;
+  for (int i = 0; i < VCACHE_OBJECTS; i++) *vcache_object(&state->shared->vcache, i) = *vcache_object(&vcache, i);
+  for (int i = modules_len - 1; i >= 0; i--) add_required_module(state, modules_ptr[i]);
+  free(cs->fns_ptr);
+  free(cs->sources_ptr);
+  free(names_ptr);
+  free(modules_ptr);
+  return NULL;
+}
+
+#else
+
+char *snapshot_save(VMState *state, const char *path, char *main_file, TextRange main_source) {
+  return my_asprintf("heap snapshots are not supported on this platform");
+}
+
+char *snapshot_load(VMState *state, const char *path) {
+  return my_asprintf("heap snapshots are not supported on this platform");
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef JERBOA_VM_SNAPSHOT_H
+#define JERBOA_VM_SNAPSHOT_H
+
+// heap snapshot: everything reachable from the root and from the modules require() has loaded,
+// saved after a run (jerboa --snapshot-out FILE script) and loaded in place of create_root
+// (jerboa --snapshot FILE script), so startup skips building the root and running those requires.
+// like the bytecode cache, a snapshot is only good for the jerboa executable that wrote it.
+
+#include "core.h"
+#include <rdparse/util.h>
+
+// the main script's text is stored too, in case its functions ended up in a module's objects.
+// returns NULL on success, error string otherwise
+char *snapshot_save(VMState *state, const char *path, char *main_file, TextRange main_source);
+
+// sets up state->root, the value cache and the require() cache.
+// returns NULL on success, error string otherwise
+char *snapshot_load(VMState *state, const char *path);
+
+#endif
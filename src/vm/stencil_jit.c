@@ -0,0 +1,217 @@
+#include "vm/stencil_jit.h"
+#include "vm/jitdump.h"
+#include "vm/instr.h"
+#include "vm/vm.h"
+#include "object.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// generated by stencilgen at build time
+#include "vm/stencils.h"
+
+static uintptr_t arg_operand(Arg *arg) {
+  if (arg->kind == ARG_SLOT) return arg->slot.offset;
+  if (arg->kind == ARG_REFSLOT) return arg->refslot.offset;
+  return (uintptr_t) arg->value;
+}
+
+// blocks are laid out in order (see layout_blocks_by_profile), so a branch to the next one falls through
+static const Stencil *branch_stencil(UserFunction *vmfun, int from_blk, int to_blk) {
+  if (to_blk == from_blk + 1) return vmfun->phi_free ? &stencil_br_next_untracked : &stencil_br_next;
+  if (vmfun->phi_free) return (to_blk <= from_blk) ? &stencil_br_backwards_untracked : &stencil_br_untracked;
+  return (to_blk <= from_blk) ? &stencil_br_backwards : &stencil_br;
+}
+
+static const Stencil *choose_stencil(UserFunction *vmfun, Instr *instr, int blk, bool last_in_block) {
+  switch (instr->type) {
+    case INSTR_MOVE: {
+      MoveInstr *mi = (MoveInstr*) instr;
+      if (last_in_block || mi->target.kind != ARG_SLOT) break;
+      if (mi->source.kind == ARG_SLOT) return &stencil_move_ss;
+      if (mi->source.kind == ARG_REFSLOT) return &stencil_move_rs;
+      return &stencil_move_vs;
+    }
+    case INSTR_TEST: {
+      TestInstr *ti = (TestInstr*) instr;
+      if (last_in_block || ti->target.kind != ARG_SLOT) break;
+      if (ti->value.kind == ARG_SLOT) return &stencil_test_vs_ts;
+      if (ti->value.kind == ARG_REFSLOT) return &stencil_test_vr_ts;
+      break;
+    }
+    case INSTR_ACCESS_STRING_KEY: {
+      AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr;
+      if (last_in_block || aski->target.kind != ARG_SLOT) break;
+      if (aski->obj.kind == ARG_SLOT) return &stencil_access_string_key_os_ts;
+      if (aski->obj.kind == ARG_REFSLOT) return &stencil_access_string_key_or_ts;
+      return &stencil_access_string_key_ov_ts;
+    }
+    case INSTR_CALL_FUNCTION_DIRECT: {
+      CallFunctionDirectInstr *cfdi = (CallFunctionDirectInstr*) instr;
+      if (last_in_block || cfdi->fast) break;
+      return &stencil_call_function_direct;
+    }
+    case INSTR_BR: {
+      BranchInstr *br = (BranchInstr*) instr;
+      return branch_stencil(vmfun, blk, br->blk);
+    }
+    case INSTR_TESTBR: {
+      TestBranchInstr *tbr = (TestBranchInstr*) instr;
+      if (tbr->test.kind == ARG_SLOT) return vmfun->phi_free ? &stencil_testbr_s_untracked : &stencil_testbr_s;
+      // constant test: always goes the same way
+      int target_blk = tbr->test.value->b ? tbr->true_blk : tbr->false_blk;
+      return branch_stencil(vmfun, blk, target_blk);
+    }
+    case INSTR_RETURN:
+      return &stencil_exit;
+    default:
+      break;
+  }
+  // the fallback continues to the next instr, so it cannot end a block
+  if (last_in_block) return &stencil_exit;
+  return &stencil_fallback;
+}
+
+// we only ever continue to the instr directly after, so the trailing jump can always go
+static int stencil_len(const Stencil *stencil) {
+  if (stencil->tail_continue != -1) return stencil->tail_continue;
+  return stencil->code_len;
+}
+
+static void branch_holes(UserFunction *vmfun, unsigned char *code, int *block_offsets, int blk,
+                         uintptr_t *holes, StencilHole block_hole, StencilHole instr_hole, StencilHole code_hole)
+{
+  holes[block_hole] = blk;
+  holes[instr_hole] = (uintptr_t) BLOCK_START(vmfun, blk);
+  holes[code_hole] = (uintptr_t) (code + block_offsets[blk]);
+}
+
+static void fill_holes(UserFunction *vmfun, Instr *instr, unsigned char *code, int *block_offsets,
+                       uintptr_t next_code, uintptr_t *holes)
+{
+  holes[HOLE_INSTR] = (uintptr_t) instr;
+  holes[HOLE_NEXT_INSTR] = (uintptr_t) ((char*) instr + instr_size(instr));
+  holes[HOLE_HANDLER] = (uintptr_t) instr->fn;
+  holes[HOLE_CONTINUE] = next_code;
+  switch (instr->type) {
+    case INSTR_MOVE: {
+      MoveInstr *mi = (MoveInstr*) instr;
+      holes[HOLE_OPERAND0] = arg_operand(&mi->source);
+      holes[HOLE_TARGET] = mi->target.slot.offset;
+      break;
+    }
+    case INSTR_TEST: {
+      TestInstr *ti = (TestInstr*) instr;
+      holes[HOLE_OPERAND0] = arg_operand(&ti->value);
+      holes[HOLE_TARGET] = ti->target.slot.offset;
+      break;
+    }
+    case INSTR_ACCESS_STRING_KEY: {
+      AccessStringKeyInstr *aski = (AccessStringKeyInstr*) instr;
+      holes[HOLE_OPERAND0] = arg_operand(&aski->obj);
+      holes[HOLE_KEY] = (uintptr_t) &aski->key;
+      holes[HOLE_TARGET] = aski->target.slot.offset;
+      break;
+    }
+    case INSTR_CALL_FUNCTION_DIRECT: {
+      CallFunctionDirectInstr *cfdi = (CallFunctionDirectInstr*) instr;
+      holes[HOLE_FN] = (uintptr_t) cfdi->fn;
+      holes[HOLE_INFO] = (uintptr_t) &cfdi->info;
+      break;
+    }
+    case INSTR_BR: {
+      BranchInstr *br = (BranchInstr*) instr;
+      branch_holes(vmfun, code, block_offsets, br->blk, holes, HOLE_TRUE_BLOCK, HOLE_TRUE_INSTR, HOLE_TRUE_CODE);
+      break;
+    }
+    case INSTR_TESTBR: {
+      TestBranchInstr *tbr = (TestBranchInstr*) instr;
+      if (tbr->test.kind == ARG_SLOT) {
+        holes[HOLE_OPERAND0] = arg_operand(&tbr->test);
+        branch_holes(vmfun, code, block_offsets, tbr->true_blk, holes, HOLE_TRUE_BLOCK, HOLE_TRUE_INSTR, HOLE_TRUE_CODE);
+        branch_holes(vmfun, code, block_offsets, tbr->false_blk, holes, HOLE_FALSE_BLOCK, HOLE_FALSE_INSTR, HOLE_FALSE_CODE);
+      } else {
+        int target_blk = tbr->test.value->b ? tbr->true_blk : tbr->false_blk;
+        branch_holes(vmfun, code, block_offsets, target_blk, holes, HOLE_TRUE_BLOCK, HOLE_TRUE_INSTR, HOLE_TRUE_CODE);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+static void emit_stencil(unsigned char *dest, const Stencil *stencil, uintptr_t *holes) {
+  int len = stencil_len(stencil);
+  memcpy(dest, stencil->code, len);
+  for (int i = 0; i < stencil->relocs_len; i++) {
+    const StencilReloc *reloc = &stencil->relocs[i];
+    if (reloc->offset >= len) continue; // in the elided tail
+    uintptr_t value;
+    if (reloc->hole == HOLE_NONE) value = (uintptr_t) reloc->sym;
+    else value = holes[reloc->hole];
+    value += reloc->addend;
+    memcpy(dest + reloc->offset, &value, sizeof(value));
+  }
+}
+
+void stencil_jit_compile(UserFunction *vmfun) {
+  assert(vmfun->opt_jit_fn == NULL);
+  if (UNLIKELY(!vmfun->resolved)) vm_resolve(vmfun);
+
+  int blocks_len = vmfun->body.blocks_len;
+  int *block_offsets = malloc(sizeof(int) * blocks_len);
+
+  // pass 1: lay out the code
+  int code_len = 0;
+  for (int i = 0; i < blocks_len; i++) {
+    block_offsets[i] = code_len;
+    Instr *instr = BLOCK_START(vmfun, i), *instr_end = BLOCK_END(vmfun, i);
+    while (instr != instr_end) {
+      // fusion only saves dispatches, which native code doesn't have; compile the parts
+      if (instr->type == INSTR_FUSED) instr = FUSED_PARTS(instr);
+      Instr *next_instr = (Instr*) ((char*) instr + instr_size(instr));
+      code_len += stencil_len(choose_stencil(vmfun, instr, i, next_instr == instr_end));
+      instr = next_instr;
+    }
+  }
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  size_t map_len = (code_len + page_size - 1) & ~(page_size - 1);
+  unsigned char *code = mmap(NULL, map_len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (code == MAP_FAILED) {
+    fprintf(stderr, "stencil jit: cannot map code for '%s': %s\n", vmfun->name, strerror(errno));
+    free(block_offsets);
+    return;
+  }
+
+  // pass 2: copy and patch
+  int offset = 0;
+  for (int i = 0; i < blocks_len; i++) {
+    assert(offset == block_offsets[i]);
+    Instr *instr = BLOCK_START(vmfun, i), *instr_end = BLOCK_END(vmfun, i);
+    while (instr != instr_end) {
+      if (instr->type == INSTR_FUSED) instr = FUSED_PARTS(instr);
+      Instr *next_instr = (Instr*) ((char*) instr + instr_size(instr));
+      const Stencil *stencil = choose_stencil(vmfun, instr, i, next_instr == instr_end);
+      int len = stencil_len(stencil);
+      uintptr_t holes[HOLE_LAST] = {0};
+      fill_holes(vmfun, instr, code, block_offsets, (uintptr_t) (code + offset + len), holes);
+      emit_stencil(code + offset, stencil, holes);
+      offset += len;
+      instr = next_instr;
+    }
+  }
+  free(block_offsets);
+
+  if (mprotect(code, map_len, PROT_READ|PROT_EXEC) != 0) {
+    fprintf(stderr, "stencil jit: cannot protect code for '%s': %s\n", vmfun->name, strerror(errno));
+    abort();
+  }
+
+  jitdump_code_load(vmfun->name, code, code_len);
+
+  *(void**) &vmfun->opt_jit_fn = code;
+}
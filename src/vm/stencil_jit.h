@@ -0,0 +1,38 @@
+#ifndef JERBOA_VM_STENCIL_JIT_H
+#define JERBOA_VM_STENCIL_JIT_H
+
+// copy-and-patch baseline jit: glues together precompiled machine code "stencils"
+// (see vm/stencils/stencils.c) and fills in their holes with slot offsets and constants.
+// x86-64 only; needs no jit library.
+
+#include "core.h"
+
+typedef enum {
+  HOLE_NONE = -1, // relocation against a runtime function
+#define HOLE(X) HOLE_##X,
+#include "vm/stencils/holes.txt"
+#undef HOLE
+  HOLE_LAST
+} StencilHole;
+
+typedef void (*StencilSym)(void);
+
+typedef struct {
+  int offset; // of the 64-bit immediate in the code
+  StencilHole hole;
+  StencilSym sym; // if hole is HOLE_NONE
+  long addend;
+} StencilReloc;
+
+typedef struct {
+  const char *name;
+  const unsigned char *code; int code_len;
+  const StencilReloc *relocs; int relocs_len;
+  // offset of the trailing jump to CONTINUE, or -1
+  // if the next stencil directly follows, the code is cut off here.
+  int tail_continue;
+} Stencil;
+
+void stencil_jit_compile(UserFunction *vmfun);
+
+#endif
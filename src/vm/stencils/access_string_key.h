@@ -0,0 +1,23 @@
+#ifndef FN_NAME
+#error "FN_NAME must be defined"
+#endif
+
+#ifndef OBJ_KIND
+#error "OBJ_KIND must be defined"
+#endif
+
+// lookup misses (index fallback, errors) are left to the interpreter function, which redoes the lookup.
+// this walks the parents itself instead of calling object_lookup_p: with the address of a local
+// flag taken, the compiler won't turn CONTINUE into a tail jump, and every loop iteration would grow the stack.
+FnWrap FN_NAME(VMState * __restrict__ state) {
+  Callframe * __restrict__ frame = state->frame;
+  Object *obj = closest_obj(state, stencil_load_arg(frame, HOLE_VALUE(OPERAND0), OBJ_KIND));
+  TableEntry *entry = NULL;
+  do {
+    entry = table_lookup_prepared(&obj->tbl, (FastKey*) HOLE_VALUE(KEY));
+    obj = obj->parent;
+  } while (!entry && obj);
+  if (UNLIKELY(!entry)) FALLBACK;
+  *stencil_slot(frame, HOLE_VALUE(TARGET)) = entry->value;
+  CONTINUE;
+}
@@ -0,0 +1,14 @@
+#ifndef FN_NAME
+#error "FN_NAME must be defined"
+#endif
+
+#ifndef SOURCE_KIND
+#error "SOURCE_KIND must be defined"
+#endif
+
+// MOVE into a slot; refslot targets have to check constraints, so they take the fallback stencil
+FnWrap FN_NAME(VMState * __restrict__ state) {
+  Callframe * __restrict__ frame = state->frame;
+  *stencil_slot(frame, HOLE_VALUE(TARGET)) = stencil_load_arg(frame, HOLE_VALUE(OPERAND0), SOURCE_KIND);
+  CONTINUE;
+}
@@ -0,0 +1,52 @@
+#ifndef JERBOA_VM_STENCILS_STENCIL_H
+#define JERBOA_VM_STENCILS_STENCIL_H
+
+// shared header for the copy-and-patch stencils in stencils.c
+// stencils are compiled with -mcmodel=large, so that every reference to a hole
+// becomes a 64-bit absolute relocation that stencil_jit.c can patch in place.
+
+#include "core.h"
+#include "vm/vm.h"
+#include "vm/instr.h"
+
+#define HOLE(X) extern char _JIT_##X[];
+#include "vm/stencils/holes.txt"
+#undef HOLE
+
+#define HOLE_VALUE(X) ((uintptr_t) &_JIT_##X)
+
+// the next stencil; if it's laid out directly after us, the jump is elided by the stitcher
+#define CONTINUE return ((VMInstrFn) HOLE_VALUE(CONTINUE))(state)
+
+#define JUMP(X) return ((VMInstrFn) HOLE_VALUE(X))(state)
+
+// leave native code; the interpreter picks up at state->instr
+#define BAIL(INSTR) do { state->instr = (Instr*) (INSTR); return (FnWrap) { state->instr->fn }; } while (false)
+
+// run the interpreter function for this instr; stay native only if it went on to the next instr
+#define FALLBACK do { \
+    state->instr = (Instr*) HOLE_VALUE(INSTR); \
+    FnWrap next = ((VMInstrFn) HOLE_VALUE(HANDLER))(state); \
+    if (UNLIKELY(state->instr != (Instr*) HOLE_VALUE(NEXT_INSTR) || state->runstate != VM_RUNNING)) return next; \
+    CONTINUE; \
+  } while (false)
+
+// no asserts in here! they'd reference .rodata, which the stitcher cannot relocate.
+static inline Value *stencil_slot(Callframe *frame, uintptr_t offset) __attribute__ ((always_inline));
+static inline Value *stencil_slot(Callframe *frame, uintptr_t offset) {
+  return (Value*) ((unsigned char*) frame + offset);
+}
+
+static inline Value stencil_load_arg(Callframe *frame, uintptr_t operand, int kind) __attribute__ ((always_inline));
+static inline Value stencil_load_arg(Callframe *frame, uintptr_t operand, int kind) {
+  if (kind == ARG_SLOT) {
+    return *stencil_slot(frame, operand);
+  } else if (kind == ARG_REFSLOT) {
+    return (*(TableEntry**) ((unsigned char*) frame + operand))->value;
+  } else {
+    // ARG_VALUE: the operand points at the constant in the constant pool
+    return *(Value*) operand;
+  }
+}
+
+#endif
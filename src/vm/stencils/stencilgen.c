@@ -0,0 +1,167 @@
+// stencilgen: turns the compiled stencils.c object file into a C header for stencil_jit.c.
+// usage: stencilgen stencils.o stencils.h
+// For every function named stencil_*, we emit its machine code and a relocation list.
+// Relocations against _JIT_* symbols are holes that the jit fills in per instruction;
+// relocations against anything else are runtime functions, resolved when jerboa is linked.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <elf.h>
+
+static const char *hole_names[] = {
+#define HOLE(X) #X,
+#include "vm/stencils/holes.txt"
+#undef HOLE
+};
+
+static int hole_names_len = sizeof(hole_names) / sizeof(hole_names[0]);
+
+static void fail(const char *fmt, const char *arg) {
+  fprintf(stderr, "stencilgen: ");
+  fprintf(stderr, fmt, arg);
+  fprintf(stderr, "\n");
+  exit(1);
+}
+
+static char *read_file(const char *name, size_t *len_p) {
+  FILE *file = fopen(name, "rb");
+  if (!file) fail("cannot open '%s'", name);
+  fseek(file, 0, SEEK_END);
+  long len = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *data = malloc(len);
+  if (fread(data, 1, len, file) != (size_t) len) fail("cannot read '%s'", name);
+  fclose(file);
+  *len_p = len;
+  return data;
+}
+
+static const char *hole_for(const char *symbol) {
+  if (strncmp(symbol, "_JIT_", 5) != 0) return NULL;
+  for (int i = 0; i < hole_names_len; i++) {
+    if (strcmp(symbol + 5, hole_names[i]) == 0) return hole_names[i];
+  }
+  fail("unknown hole '%s' (not in holes.txt)", symbol);
+  return NULL;
+}
+
+// does the code end in "movabs $_JIT_CONTINUE, %reg; jmp *%reg"? then the stitcher
+// can drop the jump when the next stencil is laid out right after this one.
+static int find_tail_continue(unsigned char *code, size_t len, Elf64_Rela *relocs, int relocs_len,
+                              Elf64_Sym *symtab, char *strtab) {
+  int continue_offs = -1;
+  for (int i = 0; i < relocs_len; i++) {
+    Elf64_Sym *sym = &symtab[ELF64_R_SYM(relocs[i].r_info)];
+    if (strcmp(strtab + sym->st_name, "_JIT_CONTINUE") == 0 && relocs[i].r_addend == 0) {
+      if ((int) relocs[i].r_offset > continue_offs) continue_offs = relocs[i].r_offset;
+    }
+  }
+  if (continue_offs < 2) return -1;
+  size_t tail = continue_offs + 8;
+  unsigned char rex = code[continue_offs - 2], op = code[continue_offs - 1];
+  if (rex == 0x48 && op >= 0xb8 && op < 0xc0) {
+    if (tail + 2 == len && code[tail] == 0xff && code[tail + 1] == 0xe0 + (op - 0xb8)) {
+      return continue_offs - 2;
+    }
+  } else if (rex == 0x49 && op >= 0xb8 && op < 0xc0) {
+    if (tail + 3 == len && code[tail] == 0x41 && code[tail + 1] == 0xff && code[tail + 2] == 0xe0 + (op - 0xb8)) {
+      return continue_offs - 2;
+    }
+  }
+  return -1;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: stencilgen stencils.o stencils.h\n");
+    return 1;
+  }
+  size_t data_len;
+  char *data = read_file(argv[1], &data_len);
+  Elf64_Ehdr *ehdr = (Elf64_Ehdr*) data;
+  if (data_len < sizeof(Elf64_Ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0
+    || ehdr->e_ident[EI_CLASS] != ELFCLASS64 || ehdr->e_machine != EM_X86_64 || ehdr->e_type != ET_REL)
+  {
+    fail("'%s' is not an x86-64 relocatable object", argv[1]);
+  }
+  Elf64_Shdr *shdrs = (Elf64_Shdr*) (data + ehdr->e_shoff);
+  char *shstrtab = data + shdrs[ehdr->e_shstrndx].sh_offset;
+
+  Elf64_Sym *symtab = NULL; int symtab_len = 0; char *strtab = NULL;
+  for (int i = 0; i < ehdr->e_shnum; i++) {
+    if (shdrs[i].sh_type == SHT_SYMTAB) {
+      symtab = (Elf64_Sym*) (data + shdrs[i].sh_offset);
+      symtab_len = shdrs[i].sh_size / sizeof(Elf64_Sym);
+      strtab = data + shdrs[shdrs[i].sh_link].sh_offset;
+    }
+  }
+  if (!symtab) fail("'%s' has no symbol table", argv[1]);
+
+  FILE *out = fopen(argv[2], "w");
+  if (!out) fail("cannot open '%s' for writing", argv[2]);
+  fprintf(out, "// generated by stencilgen from %s, do not edit\n\n", argv[1]);
+
+  int stencils_len = 0;
+  for (int i = 0; i < symtab_len; i++) {
+    Elf64_Sym *sym = &symtab[i];
+    const char *name = strtab + sym->st_name;
+    if (ELF64_ST_TYPE(sym->st_info) != STT_FUNC || strncmp(name, "stencil_", 8) != 0) continue;
+
+    int section = sym->st_shndx;
+    if (strcmp(shstrtab + shdrs[section].sh_name + strlen(".text."), name) != 0) {
+      fail("stencil '%s' must be in its own section (-ffunction-sections)", name);
+    }
+    unsigned char *code = (unsigned char*) data + shdrs[section].sh_offset + sym->st_value;
+    size_t code_len = sym->st_size;
+
+    Elf64_Rela *relocs = NULL; int relocs_len = 0;
+    for (int k = 0; k < ehdr->e_shnum; k++) {
+      if (shdrs[k].sh_type == SHT_REL) fail("'%s': REL relocations are not supported", argv[1]);
+      if (shdrs[k].sh_type == SHT_RELA && (int) shdrs[k].sh_info == section) {
+        relocs = (Elf64_Rela*) (data + shdrs[k].sh_offset);
+        relocs_len = shdrs[k].sh_size / sizeof(Elf64_Rela);
+      }
+    }
+
+    fprintf(out, "static const unsigned char %s_code[] = {", name);
+    for (size_t k = 0; k < code_len; k++) {
+      if (k % 16 == 0) fprintf(out, "\n ");
+      fprintf(out, " 0x%02x,", code[k]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    if (relocs_len) {
+      fprintf(out, "static const StencilReloc %s_relocs[] = {\n", name);
+      for (int k = 0; k < relocs_len; k++) {
+        Elf64_Rela *rel = &relocs[k];
+        Elf64_Sym *target = &symtab[ELF64_R_SYM(rel->r_info)];
+        const char *target_name = strtab + target->st_name;
+        if (ELF64_R_TYPE(rel->r_info) != R_X86_64_64) {
+          fail("stencil '%s' has a non-absolute relocation; was it compiled with -mcmodel=large?", name);
+        }
+        if (ELF64_ST_TYPE(target->st_info) == STT_SECTION || target->st_shndx != SHN_UNDEF) {
+          fail("stencil '%s' references local data or code (assert, string literal, static function?)", name);
+        }
+        const char *hole = hole_for(target_name);
+        if (hole) {
+          fprintf(out, "  { %i, HOLE_%s, NULL, %li },\n", (int) rel->r_offset, hole, (long) rel->r_addend);
+        } else {
+          fprintf(out, "  { %i, HOLE_NONE, (StencilSym) &%s, %li },\n", (int) rel->r_offset, target_name, (long) rel->r_addend);
+        }
+      }
+      fprintf(out, "};\n\n");
+    }
+
+    int tail = find_tail_continue(code, code_len, relocs, relocs_len, symtab, strtab);
+    fprintf(out, "static const Stencil %s = { \"%s\", %s_code, sizeof(%s_code), ", name, name + 8, name, name);
+    if (relocs_len) fprintf(out, "%s_relocs, %i, %i };\n\n", name, relocs_len, tail);
+    else fprintf(out, "NULL, 0, %i };\n\n", tail);
+    stencils_len ++;
+  }
+  if (!stencils_len) fail("no stencils found in '%s'", argv[1]);
+
+  fclose(out);
+  return 0;
+}
@@ -0,0 +1,141 @@
+// Stencils for the copy-and-patch jit (see vm/stencil_jit.c).
+// This file is not part of the vm proper: it is compiled on its own, and stencilgen
+// turns the resulting object file into vm/stencils.h (code bytes plus hole relocations).
+// Every stencil has the signature of a vm instr function, and tail-calls the next one.
+#include "vm/stencils/stencil.h"
+#include "object.h"
+
+// any instruction: call the interpreter function, leave if it went anywhere but the next instr
+FnWrap stencil_fallback(VMState * __restrict__ state) {
+  FALLBACK;
+}
+
+// block-ending instructions that always leave native code, like return
+FnWrap stencil_exit(VMState * __restrict__ state) {
+  state->instr = (Instr*) HOLE_VALUE(INSTR);
+  JUMP(HANDLER);
+}
+
+// gc only runs in the main loop, so loops must drop back into the interpreter when it's due
+#define SAFEPOINT(INSTR) \
+  if (UNLIKELY(state->shared->gcstate.bytes_allocated > state->shared->gcstate.next_gc_run)) BAIL(INSTR)
+
+FnWrap stencil_br(VMState * __restrict__ state) {
+  Callframe * __restrict__ frame = state->frame;
+  frame->prev_block = frame->block;
+  frame->block = (int) HOLE_VALUE(TRUE_BLOCK);
+  JUMP(TRUE_CODE);
+}
+
+FnWrap stencil_br_backwards(VMState * __restrict__ state) {
+  Callframe * __restrict__ frame = state->frame;
+  frame->prev_block = frame->block;
+  frame->block = (int) HOLE_VALUE(TRUE_BLOCK);
+  SAFEPOINT(HOLE_VALUE(TRUE_INSTR));
+  JUMP(TRUE_CODE);
+}
+
+// br to the block laid out right after this one: only the bookkeeping, the jump is elided
+FnWrap stencil_br_next(VMState * __restrict__ state) {
+  Callframe * __restrict__ frame = state->frame;
+  frame->prev_block = frame->block;
+  frame->block = (int) HOLE_VALUE(TRUE_BLOCK);
+  CONTINUE;
+}
+
+// testbr on a slot; on a constant, the stitcher emits a br
+FnWrap stencil_testbr_s(VMState * __restrict__ state) {
+  Callframe * __restrict__ frame = state->frame;
+  frame->prev_block = frame->block;
+  if (stencil_slot(frame, HOLE_VALUE(OPERAND0))->b) {
+    frame->block = (int) HOLE_VALUE(TRUE_BLOCK);
+    SAFEPOINT(HOLE_VALUE(TRUE_INSTR));
+    JUMP(TRUE_CODE);
+  } else {
+    frame->block = (int) HOLE_VALUE(FALSE_BLOCK);
+    SAFEPOINT(HOLE_VALUE(FALSE_INSTR));
+    JUMP(FALSE_CODE);
+  }
+}
+
+// the same, for phi_free functions: no block bookkeeping
+FnWrap stencil_br_untracked(VMState * __restrict__ state) {
+  JUMP(TRUE_CODE);
+}
+
+// nothing left to do: emits no code at all
+FnWrap stencil_br_next_untracked(VMState * __restrict__ state) {
+  CONTINUE;
+}
+
+FnWrap stencil_br_backwards_untracked(VMState * __restrict__ state) {
+  SAFEPOINT(HOLE_VALUE(TRUE_INSTR));
+  JUMP(TRUE_CODE);
+}
+
+FnWrap stencil_testbr_s_untracked(VMState * __restrict__ state) {
+  Callframe * __restrict__ frame = state->frame;
+  if (stencil_slot(frame, HOLE_VALUE(OPERAND0))->b) {
+    SAFEPOINT(HOLE_VALUE(TRUE_INSTR));
+    JUMP(TRUE_CODE);
+  } else {
+    SAFEPOINT(HOLE_VALUE(FALSE_INSTR));
+    JUMP(FALSE_CODE);
+  }
+}
+
+// CALL_FUNCTION_DIRECT of a regular (non-fast) native function
+FnWrap stencil_call_function_direct(VMState * __restrict__ state) {
+  state->instr = (Instr*) HOLE_VALUE(INSTR);
+  ((VMFunctionPointer) HOLE_VALUE(FN))(state, (CallInfo*) HOLE_VALUE(INFO));
+  if (UNLIKELY(state->runstate != VM_RUNNING)) return (FnWrap) { vm_halt };
+  CONTINUE;
+}
+
+#define SOURCE_KIND ARG_SLOT
+#define FN_NAME stencil_move_ss
+#include "vm/stencils/move.h"
+#undef SOURCE_KIND
+#undef FN_NAME
+
+#define SOURCE_KIND ARG_REFSLOT
+#define FN_NAME stencil_move_rs
+#include "vm/stencils/move.h"
+#undef SOURCE_KIND
+#undef FN_NAME
+
+#define SOURCE_KIND ARG_VALUE
+#define FN_NAME stencil_move_vs
+#include "vm/stencils/move.h"
+#undef SOURCE_KIND
+#undef FN_NAME
+
+#define VALUE_KIND ARG_SLOT
+#define FN_NAME stencil_test_vs_ts
+#include "vm/stencils/test.h"
+#undef VALUE_KIND
+#undef FN_NAME
+
+#define VALUE_KIND ARG_REFSLOT
+#define FN_NAME stencil_test_vr_ts
+#include "vm/stencils/test.h"
+#undef VALUE_KIND
+#undef FN_NAME
+
+#define OBJ_KIND ARG_SLOT
+#define FN_NAME stencil_access_string_key_os_ts
+#include "vm/stencils/access_string_key.h"
+#undef OBJ_KIND
+#undef FN_NAME
+
+#define OBJ_KIND ARG_REFSLOT
+#define FN_NAME stencil_access_string_key_or_ts
+#include "vm/stencils/access_string_key.h"
+#undef OBJ_KIND
+#undef FN_NAME
+
+#define OBJ_KIND ARG_VALUE
+#define FN_NAME stencil_access_string_key_ov_ts
+#include "vm/stencils/access_string_key.h"
+#undef OBJ_KIND
+#undef FN_NAME
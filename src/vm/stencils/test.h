@@ -0,0 +1,14 @@
+#ifndef FN_NAME
+#error "FN_NAME must be defined"
+#endif
+
+#ifndef VALUE_KIND
+#error "VALUE_KIND must be defined"
+#endif
+
+FnWrap FN_NAME(VMState * __restrict__ state) {
+  Callframe * __restrict__ frame = state->frame;
+  Value val = stencil_load_arg(frame, HOLE_VALUE(OPERAND0), VALUE_KIND);
+  *stencil_slot(frame, HOLE_VALUE(TARGET)) = BOOL2VAL(value_is_truthy(val));
+  CONTINUE;
+}
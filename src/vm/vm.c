@@ -112,7 +112,7 @@ void vm_print_backtrace(VMState *state) {
     for (Callframe *curf = state->frame; curf; k++, curf = curf->above) {
       Instr *instr = curf->instr_ptr;
       if (!curf->uf) continue; // stub frame
-      FileRange *belongs_to = *instr_belongs_to_p(&curf->uf->body, instr);
+      FileRange *belongs_to = instr_belongs_to(&curf->uf->body, instr);
       assert(belongs_to);
 
       const char *file, *fn;
@@ -150,7 +150,7 @@ char *vm_record_backtrace(VMState *state, int *depth) {
   } else res_ptr = malloc(1);
   for (Callframe *curf = state->frame; curf; k++, curf = curf->above) {
     Instr *instr = curf->instr_ptr;
-    FileRange *belongs_to = *instr_belongs_to_p(&curf->uf->body, instr);
+    FileRange *belongs_to = instr_belongs_to(&curf->uf->body, instr);
 
     const char *file, *fn;
     TextRange line;
@@ -184,12 +184,11 @@ void vm_record_profile(VMState *state) {
       Instr *instr = curf->instr_ptr;
       if (!curf->uf) continue; // stub frame
 
-      FileRange **belongs_to_p = instr_belongs_to_p(&curf->uf->body, instr);
-      assert(belongs_to_p && *belongs_to_p);
+      RangeRun *run = instr_range_run(&curf->uf->body, instr);
+      assert(run->range);
 
-      // ranges are unique (and instrs must live as long as the vm state lives anyways)
-      // so we can just use the pointer stored in the instr as the key
-      size_t range_id = (char*) belongs_to_p - (char*) curf->uf->body.ranges_ptr + curf->uf->body.ranges_base;
+      // run ids are unique (see finalize), so they can be the key
+      size_t range_id = run - curf->uf->body.ranges_ptr + curf->uf->body.ranges_base;
       FastKey key = { .hash = range_id };
 
       if (!prev_frame) { // top frame
@@ -198,14 +197,14 @@ void vm_record_profile(VMState *state) {
         if (entry_p) entry_p->value.i ++;
         else {
           freeptr->value = INT2VAL(1);
-          freeptr->constraint = (Object*) *belongs_to_p;
+          freeptr->constraint = (Object*) run->range;
         }
       } else {
         TableEntry *freeptr;
         TableEntry *entry_p = table_lookup_alloc_prepared(incl_table, &key, &freeptr);
         if (freeptr) {
           freeptr->value.obj = calloc(sizeof(HashTable), 1);
-          freeptr->constraint = (Object*) *belongs_to_p;
+          freeptr->constraint = (Object*) run->range;
           entry_p = freeptr;
         }
         HashTable *sub_table = (HashTable*) entry_p->value.obj;
@@ -382,16 +381,15 @@ FnWrap call_internal(VMState *state, CallInfo *info, Instr *instr_after_call) {
   return (FnWrap) { state->instr->fn }; // not safe to recurse here!
 }
 
-static FnWrap vm_instr_access(VMState *state) FAST_FN;
-static FnWrap vm_instr_access(VMState *state) {
-  AccessInstr * __restrict__ access_instr = (AccessInstr*) state->instr;
-
-  Value val = load_arg(state->frame, access_instr->obj);
+// obj[key], by string key or through the '[]' overload
+static inline FnWrap vm_access_generic(VMState *state, Arg obj_arg, Arg key_arg, WriteArg target, Instr *instr_after) __attribute__ ((always_inline));
+static inline FnWrap vm_access_generic(VMState *state, Arg obj_arg, Arg key_arg, WriteArg target, Instr *instr_after) {
+  Value val = load_arg(state->frame, obj_arg);
   Object *obj = closest_obj(state, val);
 
   char *key;
 
-  Value key_val = load_arg(state->frame, access_instr->key);
+  Value key_val = load_arg(state->frame, key_arg);
   VM_ASSERT2(NOT_NULL(key_val), "key is null");
   Object *string_base = state->shared->vcache.string_base;
   Object *key_obj = OBJ_OR_NULL(key_val);
@@ -402,19 +400,19 @@ static FnWrap vm_instr_access(VMState *state) {
     // otherwise, skey->value is independent of skey
     // TODO length in StringObject
     FastKey fkey = prepare_key(key, strlen(key));
-    set_arg(state, access_instr->target, object_lookup_p(obj, &fkey, &object_found));
+    set_arg(state, target, object_lookup_p(obj, &fkey, &object_found));
   }
   if (!object_found) {
     Value index_op = OBJECT_LOOKUP(obj, __slice);
     if (NOT_NULL(index_op)) {
       CallInfo *info = alloca(sizeof(CallInfo) + sizeof(Arg));
       info->args_len = 1;
-      info->this_arg = (Arg) { .kind = ARG_VALUE, .value = val };
-      info->fn = (Arg) { .kind = ARG_VALUE, .value = index_op };
-      info->target = access_instr->target;
-      INFO_ARGS_PTR(info)[0] = access_instr->key;
+      info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &val };
+      info->fn = (Arg) { .kind = ARG_VALUE, .value = &index_op };
+      info->target = target;
+      INFO_ARGS_PTR(info)[0] = key_arg;
 
-      return call_internal(state, info, (Instr*)(access_instr + 1));
+      return call_internal(state, info, instr_after);
     }
   }
   if (!object_found) {
@@ -424,10 +422,36 @@ static FnWrap vm_instr_access(VMState *state) {
       VM_ASSERT2(false, "[2] property not found!");
     }
   }
-  state->instr = (Instr*)(access_instr + 1);
+  state->instr = instr_after;
   STEP_VM;
 }
 
+static FnWrap vm_instr_access(VMState *state) FAST_FN;
+static FnWrap vm_instr_access(VMState *state) {
+  AccessInstr * __restrict__ access_instr = (AccessInstr*) state->instr;
+  return vm_access_generic(state, access_instr->obj, access_instr->key, access_instr->target,
+                           (Instr*)(access_instr + 1));
+}
+
+// the key is an int, so for an array we can skip the '[]' call entirely.
+// the compare is against the real length, never the length key, which scripts can assign.
+// anything else, or an index out of range, takes the generic path (and its error messages).
+static FnWrap vm_instr_access_array_index(VMState *state) FAST_FN;
+static FnWrap vm_instr_access_array_index(VMState *state) {
+  AccessArrayIndexInstr * __restrict__ aaii = (AccessArrayIndexInstr*) state->instr;
+  Object *obj = OBJ_OR_NULL(load_arg(state->frame, aaii->obj));
+  if (LIKELY(obj && obj->parent == state->shared->vcache.array_base)) {
+    ArrayObject *arr_obj = (ArrayObject*) obj;
+    int index = AS_INT(load_arg(state->frame, aaii->key));
+    if (LIKELY((unsigned) index < (unsigned) arr_obj->length)) {
+      set_arg(state, aaii->target, arr_obj->ptr[index]);
+      state->instr = (Instr*)(aaii + 1);
+      STEP_VM;
+    }
+  }
+  return vm_access_generic(state, aaii->obj, aaii->key, aaii->target, (Instr*)(aaii + 1));
+}
+
 #include "print.h"
 static FnWrap vm_instr_access_string_key_index_fallback(VMState *state, AccessStringKeyInstr *aski, Instr *instr_after) {
   Value val = load_arg(state->frame, aski->obj);
@@ -439,8 +463,8 @@ static FnWrap vm_instr_access_string_key_index_fallback(VMState *state, AccessSt
 
     CallInfo *info = alloca(sizeof(CallInfo) + sizeof(Arg));
     info->args_len = 1;
-    info->this_arg = (Arg) { .kind = ARG_VALUE, .value = val };
-    info->fn = (Arg) { .kind = ARG_VALUE, .value = index_op };
+    info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &val };
+    info->fn = (Arg) { .kind = ARG_VALUE, .value = &index_op };
     info->target = aski->target;
     INFO_ARGS_PTR(info)[0] = (Arg) { .kind = ARG_SLOT, .slot = aski->key_slot };
 
@@ -454,24 +478,41 @@ static FnWrap vm_instr_access_string_key_index_fallback(VMState *state, AccessSt
   }
 }
 
-static FnWrap vm_instr_access_string_key(VMState *state) FAST_FN;
-static FnWrap vm_instr_access_string_key(VMState *state) {
-  AccessStringKeyInstr * __restrict__ aski = (AccessStringKeyInstr*) state->instr;
-
+// the common case: the key is found on the object. returns false if we need the fallback.
+static inline bool vm_access_string_key_direct(VMState *state, AccessStringKeyInstr *aski) __attribute__ ((always_inline));
+static inline bool vm_access_string_key_direct(VMState *state, AccessStringKeyInstr *aski) {
   Object *obj = closest_obj(state, load_arg(state->frame, aski->obj));
 
   bool object_found = false;
   Value result = object_lookup_p(obj, &aski->key, &object_found);
+  if (UNLIKELY(!object_found)) return false;
 
-  if (UNLIKELY(!object_found)) {
-    return vm_instr_access_string_key_index_fallback(state, aski, (Instr*)(aski + 1));
-  } else {
-    set_arg(state, aski->target, result);
-    state->instr = (Instr*)(aski + 1);
-    STEP_VM;
-  }
+  set_arg(state, aski->target, result);
+  return true;
 }
 
+#include "vm/instrs/access_string_key.h"
+
+#define OBJ_KIND SPEC_KIND0
+#define TARGET_KIND SPEC_KIND1
+#define SPEC_TEMPLATE "vm/instrs/access_string_key.h"
+#define SPEC_NAME vm_instr_access_string_key
+#define SPEC_PREFIX0 o
+#define SPEC_PREFIX1 t
+#define SPEC_WRITE1 1
+#define SPEC_OPERANDS 2
+#define SPEC_TABLE access_string_key_fns
+#include "vm/instrs/specialize.h"
+#undef OBJ_KIND
+#undef TARGET_KIND
+#undef SPEC_TEMPLATE
+#undef SPEC_NAME
+#undef SPEC_PREFIX0
+#undef SPEC_PREFIX1
+#undef SPEC_WRITE1
+#undef SPEC_OPERANDS
+#undef SPEC_TABLE
+
 static FnWrap vm_instr_assign(VMState *state) FAST_FN;
 static FnWrap vm_instr_assign(VMState *state) {
   AssignInstr * __restrict__ assign_instr = (AssignInstr*) state->instr;
@@ -489,8 +530,8 @@ static FnWrap vm_instr_assign(VMState *state) {
     if (NOT_NULL(index_assign_op)) {
       CallInfo *info = alloca(sizeof(CallInfo) + sizeof(Arg) * 2);
       info->args_len = 2;
-      info->this_arg = (Arg) { .kind = ARG_VALUE, .value = obj_val };
-      info->fn = (Arg) { .kind = ARG_VALUE, .value = index_assign_op };
+      info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &obj_val };
+      info->fn = (Arg) { .kind = ARG_VALUE, .value = &index_assign_op };
       info->target = (WriteArg) { .kind = ARG_SLOT, .slot = target_slot };
       INFO_ARGS_PTR(info)[0] = assign_instr->key;
       INFO_ARGS_PTR(info)[1] = assign_instr->value;
@@ -556,8 +597,8 @@ static FnWrap vm_instr_key_in_obj(VMState *state) {
     if (NOT_NULL(in_overload_op)) {
       CallInfo *info = alloca(sizeof(CallInfo) + sizeof(Arg) * 1);
       info->args_len = 1;
-      info->this_arg = (Arg) { .kind = ARG_VALUE, .value = val };
-      info->fn = (Arg) { .kind = ARG_VALUE, .value = in_overload_op };
+      info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &val };
+      info->fn = (Arg) { .kind = ARG_VALUE, .value = &in_overload_op };
       info->target = key_in_obj_instr->target;
       INFO_ARGS_PTR(info)[0] = key_in_obj_instr->key;
 
@@ -650,11 +691,8 @@ static FnWrap vm_instr_check_constraint(VMState *state) {
   STEP_VM;
 }
 
-static FnWrap vm_instr_assign_string_key(VMState *state) FAST_FN;
-static FnWrap vm_instr_assign_string_key(VMState *state) {
-  AssignStringKeyInstr * __restrict__ aski = (AssignStringKeyInstr*) state->instr;
-  Value obj_val = load_arg(state->frame, aski->obj);
-  Value value = load_arg(state->frame, aski->value);
+// the part of assign_string_key that doesn't depend on the arg kinds
+static FnWrap vm_assign_string_key(VMState *state, AssignStringKeyInstr *aski, Value obj_val, Value value) {
   AssignType assign_type = aski->type;
   VM_ASSERT2(NOT_NULL(obj_val), "assignment to null");
   switch (assign_type) {
@@ -684,11 +722,11 @@ static FnWrap vm_instr_assign_string_key(VMState *state) {
           Value key = make_string(state, aski->key.key, strlen(aski->key.key));
           CallInfo *info = alloca(sizeof(CallInfo) + sizeof(Arg) * 2);
           info->args_len = 2;
-          info->this_arg = (Arg) { .kind = ARG_VALUE, .value = obj_val };
-          info->fn = (Arg) { .kind = ARG_VALUE, .value = index_assign_op };
+          info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &obj_val };
+          info->fn = (Arg) { .kind = ARG_VALUE, .value = &index_assign_op };
           info->target = (WriteArg) { .kind = ARG_SLOT, .slot = aski->target_slot };
-          INFO_ARGS_PTR(info)[0] = (Arg) { .kind = ARG_VALUE, .value = key };
-          INFO_ARGS_PTR(info)[1] = (Arg) { .kind = ARG_VALUE, .value = value };
+          INFO_ARGS_PTR(info)[0] = (Arg) { .kind = ARG_VALUE, .value = &key };
+          INFO_ARGS_PTR(info)[1] = (Arg) { .kind = ARG_VALUE, .value = &value };
 
           return call_internal(state, info, (Instr*)(aski + 1));
         }
@@ -701,6 +739,26 @@ static FnWrap vm_instr_assign_string_key(VMState *state) {
   STEP_VM;
 }
 
+#include "vm/instrs/assign_string_key.h"
+
+#define OBJ_KIND SPEC_KIND0
+#define VALUE_KIND SPEC_KIND1
+#define SPEC_TEMPLATE "vm/instrs/assign_string_key.h"
+#define SPEC_NAME vm_instr_assign_string_key
+#define SPEC_PREFIX0 o
+#define SPEC_PREFIX1 v
+#define SPEC_OPERANDS 2
+#define SPEC_TABLE assign_string_key_fns
+#include "vm/instrs/specialize.h"
+#undef OBJ_KIND
+#undef VALUE_KIND
+#undef SPEC_TEMPLATE
+#undef SPEC_NAME
+#undef SPEC_PREFIX0
+#undef SPEC_PREFIX1
+#undef SPEC_OPERANDS
+#undef SPEC_TABLE
+
 static FnWrap vm_instr_set_constraint_string_key(VMState *state) FAST_FN;
 static FnWrap vm_instr_set_constraint_string_key(VMState *state) {
   SetConstraintStringKeyInstr * __restrict__ scski = (SetConstraintStringKeyInstr*) state->instr;
@@ -729,6 +787,46 @@ static FnWrap vm_instr_call(VMState *state) {
   return call_internal(state, info, (Instr*) ((char*) call_instr + call_instr->size));
 }
 
+// call in tail position: drop our frame before the callee pushes its own, so recursion runs in constant stack.
+// the callee returns straight to our caller, into the slot we would have returned to.
+static FnWrap vm_instr_call_tail(VMState *state) FAST_FN;
+static FnWrap vm_instr_call_tail(VMState *state) {
+  CallInstr * __restrict__ call_instr = (CallInstr*) state->instr;
+  CallInfo *info = &call_instr->info;
+  Callframe *frame = state->frame, *caller = frame->above;
+  Value fn = load_arg(frame, info->fn);
+  // natives don't take up a frame anyways; stub frames expect their callee to come back to them
+  if (!caller || !caller->uf || !IS_OBJ(fn) || AS_OBJ(fn)->parent != state->shared->vcache.closure_base) {
+    return vm_instr_call(state);
+  }
+
+  // the args live in our frame, so take them along
+  int args_len = info->args_len;
+  Value *values = alloca(sizeof(Value) * (args_len + 2));
+  CallInfo *tail_info = alloca(sizeof(CallInfo) + sizeof(Arg) * args_len);
+  values[0] = fn;
+  values[1] = load_arg(frame, info->this_arg);
+  tail_info->fn = (Arg) { .kind = ARG_VALUE, .value = &values[0] };
+  tail_info->this_arg = (Arg) { .kind = ARG_VALUE, .value = &values[1] };
+  tail_info->target = frame->target;
+  tail_info->args_len = args_len;
+  for (int i = 0; i < args_len; ++i) {
+    values[i + 2] = load_arg(frame, INFO_ARGS_PTR(info)[i]);
+    INFO_ARGS_PTR(tail_info)[i] = (Arg) { .kind = ARG_VALUE, .value = &values[i + 2] };
+  }
+
+  // gc only runs in the main loop, so the values are safe off the roots until the callee frame has them
+  gc_remove_roots(state, &frame->frameroot_slots);
+  vm_remove_frame(state);
+  state->instr = caller->instr_ptr;
+  if (!setup_tail_call(state, tail_info, caller->return_next_instr)) {
+    return (FnWrap) { vm_halt };
+  }
+  UserFunction *callee = state->frame->uf;
+  if (callee->opt_jit_fn) return (FnWrap) { callee->opt_jit_fn };
+  return (FnWrap) { state->instr->fn };
+}
+
 static FnWrap vm_instr_call_function_direct(VMState *state) FAST_FN;
 static FnWrap vm_instr_call_function_direct(VMState *state) {
   CallFunctionDirectInstr * __restrict__ instr = (CallFunctionDirectInstr*) state->instr;
@@ -785,6 +883,17 @@ static FnWrap vm_instr_br(VMState *state) {
   STEP_VM;
 }
 
+// for phi_free functions
+static FnWrap vm_instr_br_untracked(VMState *state) FAST_FN;
+static FnWrap vm_instr_br_untracked(VMState *state) {
+  BranchInstr * __restrict__ br_instr = (BranchInstr*) state->instr;
+  Callframe * __restrict__ frame = state->frame;
+  int blk = br_instr->blk;
+  VM_ASSERT2_SLOT(blk < frame->uf->body.blocks_len, "slot numbering error");
+  state->instr = (Instr*) ((char*) frame->uf->body.instrs_ptr + frame->uf->body.blocks_ptr[blk].offset);
+  STEP_VM;
+}
+
 #include "vm/instrs/test.h"
 
 #define VALUE_KIND ARG_SLOT
@@ -828,6 +937,34 @@ static FnWrap vm_instr_br(VMState *state) {
 #undef TEST_KIND
 #undef FN_NAME
 
+#define PROFILE_BRANCH 1
+#define TEST_KIND ARG_SLOT
+#define FN_NAME vm_instr_testbr_s_profiled
+#include "vm/instrs/testbr.h"
+#undef TEST_KIND
+#undef FN_NAME
+
+#define TEST_KIND ARG_VALUE
+#define FN_NAME vm_instr_testbr_v_profiled
+#include "vm/instrs/testbr.h"
+#undef TEST_KIND
+#undef FN_NAME
+#undef PROFILE_BRANCH
+
+#define TRACK_BLOCK 0
+  #define TEST_KIND ARG_SLOT
+  #define FN_NAME vm_instr_testbr_s_untracked
+    #include "vm/instrs/testbr.h"
+  #undef TEST_KIND
+  #undef FN_NAME
+
+  #define TEST_KIND ARG_VALUE
+  #define FN_NAME vm_instr_testbr_v_untracked
+    #include "vm/instrs/testbr.h"
+  #undef TEST_KIND
+  #undef FN_NAME
+#undef TRACK_BLOCK
+
 #define FN_NAME vm_instr_alloc_static_object
 #include "vm/instrs/alloc_static_object.h"
 #undef FN_NAME
@@ -912,19 +1049,31 @@ static FnWrap vm_instr_br(VMState *state) {
 #undef ENTRIES_NUM
 #undef STACK
 
-static FnWrap vm_instr_phi(VMState *state) FAST_FN;
-static FnWrap vm_instr_phi(VMState *state) {
-  PhiInstr * __restrict__ phi = (PhiInstr*) state->instr;
-  if (state->frame->prev_block == phi->block1) {
-    set_arg(state, phi->target, load_arg(state->frame, phi->arg1));
-  } else if (state->frame->prev_block == phi->block2) {
-    set_arg(state, phi->target, load_arg(state->frame, phi->arg2));
-  } else VM_ASSERT2(false, "phi block error: arrived here from block not in list: [%i, %i], but came from %i",
-                    phi->block1, phi->block2, state->frame->prev_block);
-
-  state->instr = (Instr*)(phi + 1);
-  STEP_VM;
-}
+#include "vm/instrs/phi.h"
+
+#define ARG1_KIND SPEC_KIND0
+#define ARG2_KIND SPEC_KIND1
+#define TARGET_KIND SPEC_KIND2
+#define SPEC_TEMPLATE "vm/instrs/phi.h"
+#define SPEC_NAME vm_instr_phi
+#define SPEC_PREFIX0 1
+#define SPEC_PREFIX1 2
+#define SPEC_PREFIX2 t
+#define SPEC_WRITE2 1
+#define SPEC_OPERANDS 3
+#define SPEC_TABLE phi_fns
+#include "vm/instrs/specialize.h"
+#undef ARG1_KIND
+#undef ARG2_KIND
+#undef TARGET_KIND
+#undef SPEC_TEMPLATE
+#undef SPEC_NAME
+#undef SPEC_PREFIX0
+#undef SPEC_PREFIX1
+#undef SPEC_PREFIX2
+#undef SPEC_WRITE2
+#undef SPEC_OPERANDS
+#undef SPEC_TABLE
 
 static FnWrap vm_instr_define_refslot(VMState *state) FAST_FN;
 static FnWrap vm_instr_define_refslot(VMState *state) {
@@ -944,13 +1093,85 @@ static FnWrap vm_instr_define_refslot(VMState *state) {
   STEP_VM;
 }
 
-static FnWrap vm_instr_move(VMState *state) FAST_FN;
-static FnWrap vm_instr_move(VMState *state) {
-  MoveInstr * __restrict__ mi = (MoveInstr*) state->instr;
+#include "vm/instrs/move.h"
+
+#define SOURCE_KIND SPEC_KIND0
+#define TARGET_KIND SPEC_KIND1
+#define SPEC_TEMPLATE "vm/instrs/move.h"
+#define SPEC_NAME vm_instr_move
+#define SPEC_PREFIX0 s
+#define SPEC_PREFIX1 t
+#define SPEC_WRITE1 1
+#define SPEC_OPERANDS 2
+#define SPEC_TABLE move_fns
+#include "vm/instrs/specialize.h"
+#undef SOURCE_KIND
+#undef TARGET_KIND
+#undef SPEC_TEMPLATE
+#undef SPEC_NAME
+#undef SPEC_PREFIX0
+#undef SPEC_PREFIX1
+#undef SPEC_WRITE1
+#undef SPEC_OPERANDS
+#undef SPEC_TABLE
+
+// fused instrs: the parts run back to back without going through dispatch.
+// state->instr is kept on the current part, so errors and fallbacks see the instr they expect.
+// the last part is entered as a tail call, so this works with tailcall STEP_VM too.
+
+static FnWrap vm_instr_fused_test_testbr(VMState *state) FAST_FN;
+static FnWrap vm_instr_fused_test_testbr(VMState *state) {
+  TestInstr * __restrict__ test = (TestInstr*) FUSED_PARTS(state->instr);
+  Value val = load_arg(state->frame, test->value);
+  write_slot(state->frame, test->target.slot, BOOL2VAL(value_is_truthy(val)));
+  state->instr = (Instr*)(test + 1);
+  return vm_instr_testbr_s(state);
+}
 
-  set_arg(state, mi->target, load_arg(state->frame, mi->source));
+static FnWrap vm_instr_fused_test_testbr_untracked(VMState *state) FAST_FN;
+static FnWrap vm_instr_fused_test_testbr_untracked(VMState *state) {
+  TestInstr * __restrict__ test = (TestInstr*) FUSED_PARTS(state->instr);
+  Value val = load_arg(state->frame, test->value);
+  write_slot(state->frame, test->target.slot, BOOL2VAL(value_is_truthy(val)));
+  state->instr = (Instr*)(test + 1);
+  return vm_instr_testbr_s_untracked(state);
+}
 
-  state->instr = (Instr*)(mi + 1);
+static FnWrap vm_instr_fused_access_string_key_call(VMState *state) FAST_FN;
+static FnWrap vm_instr_fused_access_string_key_call(VMState *state) {
+  AccessStringKeyInstr * __restrict__ aski = (AccessStringKeyInstr*) FUSED_PARTS(state->instr);
+  state->instr = (Instr*) aski;
+  if (UNLIKELY(!vm_access_string_key_direct(state, aski))) {
+    // continues with the call by itself
+    return vm_instr_access_string_key_index_fallback(state, aski, (Instr*)(aski + 1));
+  }
+  state->instr = (Instr*)(aski + 1);
+  return vm_instr_call(state);
+}
+
+static FnWrap vm_instr_fused_access_string_key_2(VMState *state) FAST_FN;
+static FnWrap vm_instr_fused_access_string_key_2(VMState *state) {
+  AccessStringKeyInstr * __restrict__ aski1 = (AccessStringKeyInstr*) FUSED_PARTS(state->instr);
+  AccessStringKeyInstr * __restrict__ aski2 = aski1 + 1;
+  state->instr = (Instr*) aski1;
+  if (UNLIKELY(!vm_access_string_key_direct(state, aski1))) {
+    return vm_instr_access_string_key_index_fallback(state, aski1, (Instr*) aski2);
+  }
+  state->instr = (Instr*) aski2;
+  if (UNLIKELY(!vm_access_string_key_direct(state, aski2))) {
+    return vm_instr_access_string_key_index_fallback(state, aski2, (Instr*)(aski2 + 1));
+  }
+  state->instr = (Instr*)(aski2 + 1);
+  STEP_VM;
+}
+
+static FnWrap vm_instr_fused_move_2(VMState *state) FAST_FN;
+static FnWrap vm_instr_fused_move_2(VMState *state) {
+  MoveInstr * __restrict__ mi1 = (MoveInstr*) FUSED_PARTS(state->instr);
+  MoveInstr * __restrict__ mi2 = mi1 + 1;
+  set_arg(state, mi1->target, load_arg(state->frame, mi1->source));
+  set_arg(state, mi2->target, load_arg(state->frame, mi2->source));
+  state->instr = (Instr*)(mi2 + 1);
   STEP_VM;
 }
 
@@ -958,10 +1179,45 @@ void vm_update_frame(VMState *state) {
   state->frame->instr_ptr = state->instr;
 }
 
+static void vm_record_opcode(VMProfileState *profstate, InstrType type) {
+  if (UNLIKELY(!profstate->pair_counts)) {
+    profstate->pair_counts = calloc(sizeof(long long), INSTR_LAST * INSTR_LAST);
+    profstate->triple_counts = calloc(sizeof(long long), INSTR_LAST * INSTR_LAST * INSTR_LAST);
+    profstate->last_instrs[0] = profstate->last_instrs[1] = INSTR_INVALID;
+  }
+  InstrType t1 = profstate->last_instrs[0], t2 = profstate->last_instrs[1];
+  if (t2 != INSTR_INVALID) {
+    profstate->pair_counts[t2 * INSTR_LAST + type] ++;
+    if (t1 != INSTR_INVALID) {
+      profstate->triple_counts[(t1 * INSTR_LAST + t2) * INSTR_LAST + type] ++;
+    }
+  }
+  profstate->last_instrs[0] = t2;
+  profstate->last_instrs[1] = type;
+}
+
+// single-stepping variant of vm_step for -ps
+static void vm_step_record_opcodes(VMState *state) {
+  VMInstrFn fn = state->instr->fn;
+  int i;
+  for (i = 0; i < 128 && fn != vm_halt; i++) {
+    vm_record_opcode(&state->shared->profstate, state->instr->type);
+    fn = fn(state).self;
+  }
+  state->shared->cyclecount += i;
+
+  if (state->frame) vm_update_frame(state);
+}
+
 static void vm_step(VMState *state) {
   state->instr = state->frame->instr_ptr;
   assert(!state->frame->uf || state->frame->uf->resolved);
 
+  if (UNLIKELY(state->shared->settings.opcode_stats_enabled)) {
+    vm_step_record_opcodes(state);
+    return;
+  }
+
   VMInstrFn fn = state->instr->fn;
 
   // fuzz to prevent profiler aliasing
@@ -1023,6 +1279,108 @@ void init_instr_fn_table() {
   instr_fns[INSTR_MOVE] = vm_instr_move;
   instr_fns[INSTR_CALL_FUNCTION_DIRECT] = vm_instr_call_function_direct;
   instr_fns[INSTR_ALLOC_STATIC_OBJECT] = vm_instr_alloc_static_object;
+  instr_fns[INSTR_ACCESS_ARRAY_INDEX] = vm_instr_access_array_index;
+}
+
+static void vm_resolve_instr_function(UserFunction *uf, Instr *instr_cur) {
+  instr_cur->fn = NULL;
+  if (instr_cur->type == INSTR_BR) {
+    if (uf->phi_free) instr_cur->fn = vm_instr_br_untracked;
+  } else if (instr_cur->type == INSTR_CALL) {
+    if (((CallInstr*) instr_cur)->tail) instr_cur->fn = vm_instr_call_tail;
+  } else if (instr_cur->type == INSTR_TEST) {
+    TestInstr *instr = (TestInstr*) instr_cur;
+    if (instr->target.kind == ARG_SLOT) {
+      if (instr->value.kind == ARG_SLOT) {
+        instr_cur->fn = vm_instr_test_vs_ts;
+      } else if (instr->value.kind == ARG_REFSLOT) {
+        instr_cur->fn = vm_instr_test_vr_ts;
+      };
+    } else if (instr->target.kind == ARG_REFSLOT) {
+      if (instr->value.kind == ARG_SLOT) {
+        instr_cur->fn = vm_instr_test_vs_tr;
+      } else if (instr->value.kind == ARG_REFSLOT) {
+        instr_cur->fn = vm_instr_test_vr_tr;
+      }
+    }
+  } else if (instr_cur->type == INSTR_TESTBR) {
+    TestBranchInstr *instr = (TestBranchInstr*) instr_cur;
+    if (instr->test.kind == ARG_SLOT) {
+      if (uf->phi_free) instr_cur->fn = vm_instr_testbr_s_untracked;
+      else if (!uf->optimized) instr_cur->fn = vm_instr_testbr_s_profiled;
+      else instr_cur->fn = vm_instr_testbr_s;
+    } else if (instr->test.kind == ARG_VALUE) {
+      if (uf->phi_free) instr_cur->fn = vm_instr_testbr_v_untracked;
+      else if (!uf->optimized) instr_cur->fn = vm_instr_testbr_v_profiled;
+      else instr_cur->fn = vm_instr_testbr_v;
+    }
+  } else if (instr_cur->type == INSTR_RETURN) {
+    ReturnInstr *instr = (ReturnInstr*) instr_cur;
+    if (instr->ret.kind == ARG_SLOT) {
+      instr_cur->fn = vm_instr_return_s;
+    } else if (instr->ret.kind == ARG_REFSLOT) {
+      instr_cur->fn = vm_instr_return_r;
+    } else if (instr->ret.kind == ARG_VALUE) {
+      instr_cur->fn = vm_instr_return_v;
+    }
+  } else if (instr_cur->type == INSTR_ACCESS_STRING_KEY) {
+    AccessStringKeyInstr *instr = (AccessStringKeyInstr*) instr_cur;
+    instr_cur->fn = access_string_key_fns[instr->obj.kind][instr->target.kind];
+  } else if (instr_cur->type == INSTR_ASSIGN_STRING_KEY) {
+    AssignStringKeyInstr *instr = (AssignStringKeyInstr*) instr_cur;
+    instr_cur->fn = assign_string_key_fns[instr->obj.kind][instr->value.kind];
+  } else if (instr_cur->type == INSTR_MOVE) {
+    MoveInstr *instr = (MoveInstr*) instr_cur;
+    instr_cur->fn = move_fns[instr->source.kind][instr->target.kind];
+  } else if (instr_cur->type == INSTR_PHI) {
+    PhiInstr *instr = (PhiInstr*) instr_cur;
+    instr_cur->fn = phi_fns[instr->arg1.kind][instr->arg2.kind][instr->target.kind];
+  } else if (instr_cur->type == INSTR_CALL_FUNCTION_DIRECT) {
+    CallFunctionDirectInstr *instr = (CallFunctionDirectInstr*) instr_cur;
+    if (instr->fast) {
+      instr_cur->fn = instr->dispatch_fn(instr_cur).self;
+    }
+  } else if (instr_cur->type == INSTR_ALLOC_STATIC_OBJECT) {
+    AllocStaticObjectInstr *instr = (AllocStaticObjectInstr*) instr_cur;
+    if (instr->alloc_stack) {
+      if (instr->tbl.entries_stored == 0) {
+        instr_cur->fn = vm_instr_alloc_static_object_e0_stack;
+      } else if (instr->tbl.entries_stored == 1) {
+        instr_cur->fn = vm_instr_alloc_static_object_e1_stack;
+      } else if (instr->tbl.entries_stored == 2) {
+        instr_cur->fn = vm_instr_alloc_static_object_e2_stack;
+      } else if (instr->tbl.entries_stored == 3) {
+        instr_cur->fn = vm_instr_alloc_static_object_e3_stack;
+      }
+    } else {
+      if (instr->tbl.entries_stored == 0) {
+        instr_cur->fn = vm_instr_alloc_static_object_e0_heap;
+      } else if (instr->tbl.entries_stored == 1) {
+        instr_cur->fn = vm_instr_alloc_static_object_e1_heap;
+      } else if (instr->tbl.entries_stored == 2) {
+        instr_cur->fn = vm_instr_alloc_static_object_e2_heap;
+      } else if (instr->tbl.entries_stored == 3) {
+        instr_cur->fn = vm_instr_alloc_static_object_e3_heap;
+      }
+    }
+  } else if (instr_cur->type == INSTR_FUSED) {
+    FusedInstr *instr = (FusedInstr*) instr_cur;
+    // the parts are still run on their own by fallbacks and the jits
+    Instr *part = FUSED_PARTS(instr), *part_end = (Instr*) ((char*) instr + instr->size);
+    while (part != part_end) {
+      vm_resolve_instr_function(uf, part);
+      part = (Instr*) ((char*) part + instr_size(part));
+    }
+    switch (instr->kind) {
+      case FUSED_TEST_TESTBR:
+        instr_cur->fn = uf->phi_free ? vm_instr_fused_test_testbr_untracked : vm_instr_fused_test_testbr;
+        break;
+      case FUSED_ACCESS_STRING_KEY_CALL: instr_cur->fn = vm_instr_fused_access_string_key_call; break;
+      case FUSED_ACCESS_STRING_KEY_2: instr_cur->fn = vm_instr_fused_access_string_key_2; break;
+      case FUSED_MOVE_2: instr_cur->fn = vm_instr_fused_move_2; break;
+    }
+  }
+  if (!instr_cur->fn) instr_cur->fn = instr_fns[instr_cur->type];
 }
 
 // will be called again after runtime optimization
@@ -1030,68 +1388,7 @@ void vm_resolve_functions(UserFunction *uf) {
   for (int i = 0; i < uf->body.blocks_len; i++) {
     Instr *instr_cur = BLOCK_START(uf, i), *instr_end = BLOCK_END(uf, i);
     while (instr_cur != instr_end) {
-      instr_cur->fn = NULL;
-      if (instr_cur->type == INSTR_TEST) {
-        TestInstr *instr = (TestInstr*) instr_cur;
-        if (instr->target.kind == ARG_SLOT) {
-          if (instr->value.kind == ARG_SLOT) {
-            instr_cur->fn = vm_instr_test_vs_ts;
-          } else if (instr->value.kind == ARG_REFSLOT) {
-            instr_cur->fn = vm_instr_test_vr_ts;
-          };
-        } else if (instr->target.kind == ARG_REFSLOT) {
-          if (instr->value.kind == ARG_SLOT) {
-            instr_cur->fn = vm_instr_test_vs_tr;
-          } else if (instr->value.kind == ARG_REFSLOT) {
-            instr_cur->fn = vm_instr_test_vr_tr;
-          }
-        }
-      } else if (instr_cur->type == INSTR_TESTBR) {
-        TestBranchInstr *instr = (TestBranchInstr*) instr_cur;
-        if (instr->test.kind == ARG_SLOT) {
-          instr_cur->fn = vm_instr_testbr_s;
-        } else if (instr->test.kind == ARG_VALUE) {
-          instr_cur->fn = vm_instr_testbr_v;
-        }
-      } else if (instr_cur->type == INSTR_RETURN) {
-        ReturnInstr *instr = (ReturnInstr*) instr_cur;
-        if (instr->ret.kind == ARG_SLOT) {
-          instr_cur->fn = vm_instr_return_s;
-        } else if (instr->ret.kind == ARG_REFSLOT) {
-          instr_cur->fn = vm_instr_return_r;
-        } else if (instr->ret.kind == ARG_VALUE) {
-          instr_cur->fn = vm_instr_return_v;
-        }
-      } else if (instr_cur->type == INSTR_CALL_FUNCTION_DIRECT) {
-        CallFunctionDirectInstr *instr = (CallFunctionDirectInstr*) instr_cur;
-        if (instr->fast) {
-          instr_cur->fn = instr->dispatch_fn(instr_cur).self;
-        }
-      } else if (instr_cur->type == INSTR_ALLOC_STATIC_OBJECT) {
-        AllocStaticObjectInstr *instr = (AllocStaticObjectInstr*) instr_cur;
-        if (instr->alloc_stack) {
-          if (instr->tbl.entries_stored == 0) {
-            instr_cur->fn = vm_instr_alloc_static_object_e0_stack;
-          } else if (instr->tbl.entries_stored == 1) {
-            instr_cur->fn = vm_instr_alloc_static_object_e1_stack;
-          } else if (instr->tbl.entries_stored == 2) {
-            instr_cur->fn = vm_instr_alloc_static_object_e2_stack;
-          } else if (instr->tbl.entries_stored == 3) {
-            instr_cur->fn = vm_instr_alloc_static_object_e3_stack;
-          }
-        } else {
-          if (instr->tbl.entries_stored == 0) {
-            instr_cur->fn = vm_instr_alloc_static_object_e0_heap;
-          } else if (instr->tbl.entries_stored == 1) {
-            instr_cur->fn = vm_instr_alloc_static_object_e1_heap;
-          } else if (instr->tbl.entries_stored == 2) {
-            instr_cur->fn = vm_instr_alloc_static_object_e2_heap;
-          } else if (instr->tbl.entries_stored == 3) {
-            instr_cur->fn = vm_instr_alloc_static_object_e3_heap;
-          }
-        }
-      }
-      if (!instr_cur->fn) instr_cur->fn = instr_fns[instr_cur->type];
+      vm_resolve_instr_function(uf, instr_cur);
       int size = instr_size(instr_cur);
       instr_cur = (Instr*) ((char*) instr_cur + size);
     }